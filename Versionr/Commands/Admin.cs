@@ -53,6 +53,10 @@ namespace Versionr.Commands
         public bool Echo { get; set; }
         [Option("objectcheck", Required = false, HelpText = "Runs an object store integrity check.")]
         public bool ObjectCheck { get; set; }
+        [Option("train-dictionary", Required = false, HelpText = "Trains a shared compression dictionary from the small objects in the object store.")]
+        public bool TrainDictionary { get; set; }
+        [Option("dictionary-size", Required = false, DefaultValue = 64 * 1024, HelpText = "Maximum size in bytes of a trained dictionary.")]
+        public int DictionarySize { get; set; }
     }
     class Admin : BaseWorkspaceCommand
     {
@@ -101,6 +105,13 @@ namespace Versionr.Commands
             {
                 Workspace.RunObjectStoreCheck();
             }
+            if (localOptions.TrainDictionary)
+            {
+                if (localOptions.Replicate)
+                    Printer.PrintMessage("#w#Warning:## Dictionary training is not replicatable.");
+                if (!Workspace.TrainObjectStoreDictionary(localOptions.DictionarySize))
+                    return false;
+            }
             if (localOptions.Check)
             {
                 if (localOptions.Replicate)
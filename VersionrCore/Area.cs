@@ -86,6 +86,11 @@ namespace Versionr
             ObjectStore.RunConsistencyCheck();
         }
 
+        public bool TrainObjectStoreDictionary(int dictionarySize)
+        {
+            return ObjectStore.TrainDictionary(dictionarySize);
+        }
+
         public void RunConsistencyCheck()
         {
             Database.ConsistencyCheck();
@@ -269,6 +274,12 @@ namespace Versionr
         public enum XDiffFlags
         {
             None = 0,
+            // Diff and merge only. Patience and Histogram anchor hunks on rare lines and fall back to the default
+            // (Myers) matcher in between; the file exports always use Histogram.
+            Minimal = 0x2,
+            Patience = 0x4,
+            Histogram = 0x8,
+            // Patch only.
             IgnoreWhitespace = 0x100
         }
 
@@ -279,7 +290,181 @@ namespace Versionr
         public static extern int ApplyBinaryPatch(string file1, string file2, string output);
 
         [System.Runtime.InteropServices.DllImport("XDiffEngine", EntryPoint = "Merge3Way", CharSet = System.Runtime.InteropServices.CharSet.Ansi, CallingConvention = System.Runtime.InteropServices.CallingConvention.Cdecl)]
-        public static extern int XDiffMerge3Way(string basefile, string file1, string file2, string output);
+        private static extern int Merge3WayFile(string basefile, string file1, string file2, string output, out IntPtr conflicts, out int conflictCount);
+
+        // One conflict of a native three way merge: zero-based line ranges in the base, both files and the merged
+        // output, where OutputLine/OutputCount also cover the conflict markers.
+        [System.Runtime.InteropServices.StructLayout(System.Runtime.InteropServices.LayoutKind.Sequential)]
+        public struct XDiffConflict
+        {
+            public int BaseLine, BaseCount;
+            public int Line1, Count1;
+            public int Line2, Count2;
+            public int OutputLine, OutputCount;
+        }
+
+        [System.Runtime.InteropServices.DllImport("XDiffEngine", EntryPoint = "GeneratePatchBuffer", CallingConvention = System.Runtime.InteropServices.CallingConvention.Cdecl)]
+        private static extern int GeneratePatchBuffer(IntPtr context, byte[] data1, int length1, byte[] data2, int length2, out IntPtr output, out int outputLength, XDiffFlags flags);
+
+        [System.Runtime.InteropServices.DllImport("XDiffEngine", EntryPoint = "GenerateBinaryPatchBuffer", CallingConvention = System.Runtime.InteropServices.CallingConvention.Cdecl)]
+        private static extern int GenerateBinaryPatchBuffer(IntPtr context, byte[] data1, int length1, byte[] data2, int length2, out IntPtr output, out int outputLength);
+
+        [System.Runtime.InteropServices.DllImport("XDiffEngine", EntryPoint = "ApplyPatchBuffer", CallingConvention = System.Runtime.InteropServices.CallingConvention.Cdecl)]
+        private static extern int ApplyPatchBuffer(IntPtr context, byte[] data, int length, byte[] patch, int patchLength, out IntPtr output, out int outputLength, out IntPtr errors, out int errorsLength, int reversed, XDiffFlags flags);
+
+        [System.Runtime.InteropServices.DllImport("XDiffEngine", EntryPoint = "ApplyBinaryPatchBuffer", CallingConvention = System.Runtime.InteropServices.CallingConvention.Cdecl)]
+        private static extern int ApplyBinaryPatchBuffer(IntPtr context, byte[] data, int length, byte[] patch, int patchLength, out IntPtr output, out int outputLength);
+
+        [System.Runtime.InteropServices.DllImport("XDiffEngine", EntryPoint = "Merge3WayBuffer", CallingConvention = System.Runtime.InteropServices.CallingConvention.Cdecl)]
+        private static extern int Merge3WayBuffer(IntPtr context, byte[] baseData, int baseLength, byte[] data1, int length1, byte[] data2, int length2, out IntPtr output, out int outputLength, out IntPtr conflicts, out int conflictCount, XDiffFlags flags);
+
+        [System.Runtime.InteropServices.DllImport("XDiffEngine", EntryPoint = "FreeBuffer", CallingConvention = System.Runtime.InteropServices.CallingConvention.Cdecl)]
+        private static extern void FreeXDiffBuffer(IntPtr buffer);
+
+        [System.Runtime.InteropServices.DllImport("XDiffEngine", EntryPoint = "CreateContext", CallingConvention = System.Runtime.InteropServices.CallingConvention.Cdecl)]
+        private static extern IntPtr CreateXDiffContext();
+
+        [System.Runtime.InteropServices.DllImport("XDiffEngine", EntryPoint = "DestroyContext", CallingConvention = System.Runtime.InteropServices.CallingConvention.Cdecl)]
+        private static extern void DestroyXDiffContext(IntPtr context);
+
+        // Native engine contexts own the arena each call allocates from and serve one call at a time, so concurrent
+        // callers each take one from here and hand it back afterwards. At most one per processor is kept; contexts
+        // returned beyond that, after a burst of parallel calls, are destroyed along with their arenas.
+        private static ConcurrentBag<IntPtr> XDiffContexts = new ConcurrentBag<IntPtr>();
+        private static int XDiffContextCount = 0;
+
+        private static IntPtr RentXDiffContext()
+        {
+            IntPtr context;
+            if (XDiffContexts.TryTake(out context))
+            {
+                System.Threading.Interlocked.Decrement(ref XDiffContextCount);
+                return context;
+            }
+            return CreateXDiffContext();
+        }
+
+        private static void ReturnXDiffContext(IntPtr context)
+        {
+            if (context == IntPtr.Zero)
+                return;
+            if (System.Threading.Interlocked.Increment(ref XDiffContextCount) <= Environment.ProcessorCount)
+                XDiffContexts.Add(context);
+            else
+            {
+                System.Threading.Interlocked.Decrement(ref XDiffContextCount);
+                DestroyXDiffContext(context);
+            }
+        }
+
+        // Copies the output of one of the *Buffer exports into a managed array and frees the native one.
+        private static byte[] TakeXDiffBuffer(IntPtr buffer, int length)
+        {
+            if (buffer == IntPtr.Zero)
+                return new byte[0];
+            byte[] result = new byte[length];
+            System.Runtime.InteropServices.Marshal.Copy(buffer, result, 0, length);
+            FreeXDiffBuffer(buffer);
+            return result;
+        }
+
+        private static XDiffConflict[] TakeXDiffConflicts(IntPtr buffer, int count)
+        {
+            XDiffConflict[] result = new XDiffConflict[count];
+            int size = System.Runtime.InteropServices.Marshal.SizeOf(typeof(XDiffConflict));
+            for (int i = 0; i < count; i++)
+                result[i] = (XDiffConflict)System.Runtime.InteropServices.Marshal.PtrToStructure(new IntPtr(buffer.ToInt64() + i * size), typeof(XDiffConflict));
+            if (buffer != IntPtr.Zero)
+                FreeXDiffBuffer(buffer);
+            return result;
+        }
+
+        // Merges file1 and file2 into output. Returns 0 if they merged cleanly, 1 if output holds conflict markers
+        // for the regions listed in conflicts, 2 if the merge failed and 3 if an input couldn't be read.
+        public static int XDiffMerge3Way(string basefile, string file1, string file2, string output, out XDiffConflict[] conflicts)
+        {
+            IntPtr conflictData;
+            int conflictCount;
+            int status = Merge3WayFile(basefile, file1, file2, output, out conflictData, out conflictCount);
+            conflicts = TakeXDiffConflicts(conflictData, conflictCount);
+            return status;
+        }
+
+        // In-memory versions of the exports above; they return the same codes and never touch the file system.
+        public static int GeneratePatch(byte[] data1, byte[] data2, bool binary, out byte[] patch, XDiffFlags flags = XDiffFlags.Histogram)
+        {
+            IntPtr output;
+            int outputLength;
+            int result;
+            IntPtr context = RentXDiffContext();
+            try
+            {
+                result = binary ? GenerateBinaryPatchBuffer(context, data1, data1.Length, data2, data2.Length, out output, out outputLength)
+                    : GeneratePatchBuffer(context, data1, data1.Length, data2, data2.Length, out output, out outputLength, flags);
+            }
+            finally
+            {
+                ReturnXDiffContext(context);
+            }
+            patch = TakeXDiffBuffer(output, outputLength);
+            return result;
+        }
+
+        public static int ApplyPatch(byte[] data, byte[] patch, bool reversed, XDiffFlags flags, out byte[] result, out byte[] rejections)
+        {
+            IntPtr output, errors;
+            int outputLength, errorsLength;
+            int status;
+            IntPtr context = RentXDiffContext();
+            try
+            {
+                status = ApplyPatchBuffer(context, data, data.Length, patch, patch.Length, out output, out outputLength, out errors, out errorsLength, reversed ? 1 : 0, flags);
+            }
+            finally
+            {
+                ReturnXDiffContext(context);
+            }
+            result = TakeXDiffBuffer(output, outputLength);
+            rejections = TakeXDiffBuffer(errors, errorsLength);
+            return status;
+        }
+
+        public static int ApplyBinaryPatch(byte[] data, byte[] patch, out byte[] result)
+        {
+            IntPtr output;
+            int outputLength;
+            int status;
+            IntPtr context = RentXDiffContext();
+            try
+            {
+                status = ApplyBinaryPatchBuffer(context, data, data.Length, patch, patch.Length, out output, out outputLength);
+            }
+            finally
+            {
+                ReturnXDiffContext(context);
+            }
+            result = TakeXDiffBuffer(output, outputLength);
+            return status;
+        }
+
+        public static int XDiffMerge3Way(byte[] baseData, byte[] data1, byte[] data2, out byte[] result, out XDiffConflict[] conflicts, XDiffFlags flags = XDiffFlags.Histogram)
+        {
+            IntPtr output, conflictData;
+            int outputLength, conflictCount;
+            int status;
+            IntPtr context = RentXDiffContext();
+            try
+            {
+                status = Merge3WayBuffer(context, baseData, baseData.Length, data1, data1.Length, data2, data2.Length, out output, out outputLength, out conflictData, out conflictCount, flags);
+            }
+            finally
+            {
+                ReturnXDiffContext(context);
+            }
+            result = TakeXDiffBuffer(output, outputLength);
+            conflicts = TakeXDiffConflicts(conflictData, conflictCount);
+            return status;
+        }
 
         [ProtoBuf.ProtoContract]
         public class StashInfo
@@ -1275,53 +1460,75 @@ namespace Versionr
         private bool ApplyPatchEntry(string resultPath, string original, bool binary, long patchDataOffset, Stream baseStream, ApplyStashOptions options, StashEntry e)
         {
             var tempFolder = AdministrationFolder.CreateSubdirectory("Temp");
-            string patchFile = Path.Combine(tempFolder.FullName, Path.GetRandomFileName());
             string tempFile = Path.Combine(tempFolder.FullName, Path.GetRandomFileName());
-            string rejectionFile = Path.Combine(tempFolder.FullName, Path.GetRandomFileName());
 
             baseStream.Position = patchDataOffset;
             BinaryReader br = new BinaryReader(baseStream);
             long patchSize = br.ReadInt64();
 
             var reader = Versionr.ObjectStore.LZHAMReaderStream.OpenStream(patchSize, baseStream);
-            using (FileStream fout = File.Open(patchFile, FileMode.Create))
-                reader.CopyTo(fout);
-
+            string originalPath = Path.GetFullPath(original);
             int result;
-            if (binary)
-                result = ApplyBinaryPatch(Path.GetFullPath(original), patchFile, tempFile);
+            byte[] rejections = new byte[0];
+            if (patchSize <= MaxInMemoryPatchInput && new FileInfo(originalPath).Length <= MaxInMemoryPatchInput)
+            {
+                byte[] patch;
+                using (MemoryStream patchStream = new MemoryStream((int)patchSize))
+                {
+                    reader.CopyTo(patchStream);
+                    patch = patchStream.ToArray();
+                }
+                byte[] originalData = File.ReadAllBytes(originalPath);
+                byte[] patched;
+                if (binary)
+                    result = ApplyBinaryPatch(originalData, patch, out patched);
+                else
+                    result = ApplyPatch(originalData, patch, options.Reverse, XDiffFlags.None, out patched, out rejections);
+                if (result == 0)
+                    File.WriteAllBytes(tempFile, patched);
+            }
             else
             {
-                result = ApplyPatch(Path.GetFullPath(original), patchFile, tempFile, rejectionFile, options.Reverse ? 1 : 0);
+                string patchFile = Path.Combine(tempFolder.FullName, Path.GetRandomFileName());
+                string rejectionFile = Path.Combine(tempFolder.FullName, Path.GetRandomFileName());
+                using (FileStream fout = File.Open(patchFile, FileMode.Create))
+                    reader.CopyTo(fout);
+                if (binary)
+                    result = ApplyBinaryPatch(originalPath, patchFile, tempFile);
+                else
+                    result = ApplyPatch(originalPath, patchFile, tempFile, rejectionFile, options.Reverse ? 1 : 0);
+                if (File.Exists(rejectionFile))
+                {
+                    rejections = File.ReadAllBytes(rejectionFile);
+                    File.Delete(rejectionFile);
+                }
+                File.Delete(patchFile);
+            }
 
+            if (!binary)
+            {
                 bool hasRejectedHunks = false;
-                using (FileStream fs = File.Open(rejectionFile, FileMode.Open))
-                using (TextReader tr = new StreamReader(fs))
-                {
-                    if (fs.Length != 0)
-                    {
-                        hasRejectedHunks = true;
-                        string[] errorLines = tr.ReadToEnd().Split('\n');
-                        Printer.PrintError("#e#Error:#b# Couldn't apply all patch hunks!##");
-                        foreach (var x in errorLines)
-                        {
-                            if (x.StartsWith("@@"))
-                                Printer.PrintMessage("#c#{0}##", Printer.Escape(x));
-                            else if (x.StartsWith("-"))
-                                Printer.PrintMessage("#e#{0}##", Printer.Escape(x));
-                            else if (x.StartsWith("+"))
-                                Printer.PrintMessage("#s#{0}##", Printer.Escape(x));
-                            else
-                                Printer.PrintMessage(Printer.Escape(x));
-                        }
+                if (rejections.Length != 0)
+                {
+                    hasRejectedHunks = true;
+                    string[] errorLines = Encoding.UTF8.GetString(rejections).Split('\n');
+                    Printer.PrintError("#e#Error:#b# Couldn't apply all patch hunks!##");
+                    foreach (var x in errorLines)
+                    {
+                        if (x.StartsWith("@@"))
+                            Printer.PrintMessage("#c#{0}##", Printer.Escape(x));
+                        else if (x.StartsWith("-"))
+                            Printer.PrintMessage("#e#{0}##", Printer.Escape(x));
+                        else if (x.StartsWith("+"))
+                            Printer.PrintMessage("#s#{0}##", Printer.Escape(x));
+                        else
+                            Printer.PrintMessage(Printer.Escape(x));
                     }
                 }
 
                 if (hasRejectedHunks && !options.AllowUncleanPatches)
                 {
                     Printer.PrintError("#e# - Not applied, patch not clean!");
-                    File.Delete(rejectionFile);
-                    File.Delete(patchFile);
                     File.Delete(tempFile);
                     return false;
                 }
@@ -1330,7 +1537,7 @@ namespace Versionr
                     Printer.PrintError("#w# - Patch not clean, generating rejection file!");
                     if (File.Exists(Path.GetFullPath(resultPath) + ".rejected"))
                         File.Delete(Path.GetFullPath(resultPath) + ".rejected");
-                    File.Move(rejectionFile, Path.GetFullPath(resultPath) + ".rejected");
+                    File.WriteAllBytes(Path.GetFullPath(resultPath) + ".rejected", rejections);
                 }
             }
             if (result != 0)
@@ -1341,6 +1548,7 @@ namespace Versionr
                 if (Entry.CheckHash(fi) == Entry.CheckHash(new FileInfo(tempFile)))
                 {
                     Printer.PrintMessage("  - No changes.");
+                    File.Delete(tempFile);
                 }
                 else
                 {
@@ -1351,11 +1559,88 @@ namespace Versionr
                 }
             }
 
-            File.Delete(patchFile);
-
             return true;
         }
 
+        // Stash patches are made and applied in memory when both sides are at most this size. Larger ones go through temp files and
+        // the file exports, since the buffer exports take int lengths and a patch can be larger than either input.
+        const long MaxInMemoryPatchInput = 512 * 1024 * 1024;
+
+        // Writes a stash entry's patch as its length followed by the compressed patch, returning the bytes written.
+        private static long WriteStashPatch(Stream s, byte[] patch)
+        {
+            long resultSize;
+            BinaryWriter bw = new BinaryWriter(s);
+            bw.Write((long)patch.Length);
+            using (MemoryStream input = new MemoryStream(patch, false))
+            {
+                Versionr.ObjectStore.LZHAMWriter.CompressToStream(patch.Length, 16 * 1024 * 1024, out resultSize, input, s);
+            }
+            return resultSize + 8;
+        }
+
+        // Diffs a record against a newer version of the file into a stash entry, returning the bytes written.
+        private long WriteStashPatch(Stream s, Record oldRecord, string newFile, bool binary)
+        {
+            if (oldRecord.Size <= MaxInMemoryPatchInput && new FileInfo(newFile).Length <= MaxInMemoryPatchInput)
+            {
+                byte[] patch;
+                if (GeneratePatch(RestoreRecordData(oldRecord), File.ReadAllBytes(newFile), binary, out patch) != 0)
+                    throw new Exception("Error during xdiff!");
+                return WriteStashPatch(s, patch);
+            }
+
+            var tempFolder = AdministrationFolder.CreateSubdirectory("Temp");
+            string priorRecord = Path.Combine(tempFolder.FullName, Path.GetRandomFileName());
+            string patchFile = Path.Combine(tempFolder.FullName, Path.GetRandomFileName());
+            try
+            {
+                RestoreRecord(oldRecord, DateTime.Now, priorRecord);
+
+                int xdiffres = 0;
+                if (binary)
+                    xdiffres = GenerateBinaryPatch(priorRecord, newFile, patchFile);
+                else
+                    xdiffres = GeneratePatch(priorRecord, newFile, patchFile);
+
+                if (xdiffres != 0)
+                    throw new Exception("Error during xdiff!");
+
+                long resultSize;
+                BinaryWriter bw = new BinaryWriter(s);
+                long patchSize = new FileInfo(patchFile).Length;
+                bw.Write(patchSize);
+
+                using (FileStream input = File.Open(patchFile, FileMode.Open, FileAccess.Read))
+                {
+                    Versionr.ObjectStore.LZHAMWriter.CompressToStream(patchSize, 16 * 1024 * 1024, out resultSize, input, s);
+                }
+                return resultSize + 8;
+            }
+            finally
+            {
+                var oldrec = new FileInfo(priorRecord);
+                if (oldrec.Exists)
+                {
+                    oldrec.IsReadOnly = false;
+                    oldrec.Delete();
+                }
+                File.Delete(patchFile);
+            }
+        }
+
+        // Only called for records up to MaxInMemoryPatchInput.
+        private byte[] RestoreRecordData(Record rec)
+        {
+            if (rec.Size == 0)
+                return new byte[0];
+            using (MemoryStream ms = new MemoryStream((int)rec.Size))
+            {
+                ObjectStore.ExportRecordStream(rec, ms);
+                return ms.Length == ms.Capacity ? ms.GetBuffer() : ms.ToArray();
+            }
+        }
+
         [Flags]
         public enum StashFlags
         {
@@ -1481,12 +1766,8 @@ namespace Versionr
 
                     var tempFileNew = GetTemporaryFile(newRecord);
                     RestoreRecord(newRecord, DateTime.Now, tempFileNew.FullName);
-                    var tempFileOld = GetTemporaryFile(oldRecord);
-                    RestoreRecord(oldRecord, DateTime.Now, tempFileOld.FullName);
 
                     tempFileNew = new FileInfo(tempFileNew.FullName);
-                    tempFileOld = new FileInfo(tempFileOld.FullName);
-
                     bool binary = FileClassifier.Classify(tempFileNew) == FileEncoding.Binary;
 
                     StashEntry entry = new StashEntry()
@@ -1502,38 +1783,13 @@ namespace Versionr
                         Flags = binary ? StashFlags.Binary : StashFlags.None
                     };
 
+                    // The prior version is only restored when the entry is written, so one pair of versions is held at a time.
                     stashWriters.Add(new Tuple<StashEntry, Func<Stream, long>>(entry, (s) =>
                     {
-                        long resultSize;
-
-                        string patchFile = Path.Combine(tempFolder.FullName, Path.GetRandomFileName());
-
-                        int xdiffres = 0;
-                        if (binary)
-                            xdiffres = GenerateBinaryPatch(tempFileOld.FullName, tempFileNew.FullName, patchFile);
-                        else
-                            xdiffres = GeneratePatch(tempFileOld.FullName, tempFileNew.FullName, patchFile);
-
-                        if (xdiffres != 0)
-                            throw new Exception("Error during xdiff!");
-
-                        BinaryWriter bw = new BinaryWriter(s);
-                        long patchSize = new FileInfo(patchFile).Length;
-                        bw.Write(patchSize);
-
-                        using (FileStream input = File.Open(patchFile, FileMode.Open, FileAccess.Read))
-                        {
-                            Versionr.ObjectStore.LZHAMWriter.CompressToStream(patchSize, 16 * 1024 * 1024, out resultSize, input, s);
-                        }
-
-                        File.Delete(patchFile);
-
+                        long resultSize = WriteStashPatch(s, oldRecord, tempFileNew.FullName, binary);
                         tempFileNew.IsReadOnly = false;
-                        tempFileOld.IsReadOnly = false;
                         tempFileNew.Delete();
-                        tempFileOld.Delete();
-
-                        return resultSize + 8;
+                        return resultSize;
                     }));
                 }
                 else if (x.Type == AlterationType.Copy || x.Type == AlterationType.Move)
@@ -1819,36 +2075,7 @@ namespace Versionr
                     {
                         if (x.Code == StatusCode.Modified || (entry.NewHash == entry.OriginalHash || entry.NewSize != entry.OriginalSize))
                         {
-                            long resultSize;
-
-                            string priorRecord = Path.Combine(tempFolder.FullName, Path.GetRandomFileName());
-                            string patchFile = Path.Combine(tempFolder.FullName, Path.GetRandomFileName());
-                            RestoreRecord(x.VersionControlRecord, DateTime.Now, priorRecord);
-
-                            int xdiffres = 0;
-                            if (binary)
-                                xdiffres = GenerateBinaryPatch(priorRecord, x.FilesystemEntry.Info.FullName, patchFile);
-                            else
-                                xdiffres = GeneratePatch(priorRecord, x.FilesystemEntry.Info.FullName, patchFile);
-
-                            if (xdiffres != 0)
-                                throw new Exception("Error during xdiff!");
-
-                            BinaryWriter bw = new BinaryWriter(s);
-                            long patchSize = new FileInfo(patchFile).Length;
-                            bw.Write(patchSize);
-
-                            using (FileStream input = File.Open(patchFile, FileMode.Open, FileAccess.Read))
-                            {
-                                Versionr.ObjectStore.LZHAMWriter.CompressToStream(patchSize, 16 * 1024 * 1024, out resultSize, input, s);
-                            }
-
-                            var oldrec = new FileInfo(priorRecord);
-                            oldrec.IsReadOnly = false;
-                            File.Delete(priorRecord);
-                            File.Delete(patchFile);
-
-                            return resultSize + 8;
+                            return WriteStashPatch(s, x.VersionControlRecord, x.FilesystemEntry.Info.FullName, binary);
                         }
                         return 0;
                     }));
@@ -4217,14 +4444,14 @@ namespace Versionr
             return ObjectStore.GetTransmissionLength(record.Fingerprint);
         }
 
-        internal bool TransmitObjectData(string dataID, Func<byte[], int, bool, bool> sender, byte[] scratchBuffer, Action beginTransmission = null)
+        internal bool TransmitObjectData(string dataID, Func<byte[], int, bool, bool> sender, byte[] scratchBuffer, Action beginTransmission = null, bool legacyFormat = false)
         {
-            return ObjectStore.TransmitObjectData(dataID, sender, scratchBuffer, beginTransmission);
+            return ObjectStore.TransmitObjectData(dataID, sender, scratchBuffer, beginTransmission, legacyFormat);
         }
 
-        internal bool TransmitRecordData(Record record, Func<byte[], int, bool, bool> sender, byte[] scratchBuffer, Action beginTransmission = null)
+        internal bool TransmitRecordData(Record record, Func<byte[], int, bool, bool> sender, byte[] scratchBuffer, Action beginTransmission = null, bool legacyFormat = false)
         {
-            return ObjectStore.TransmitObjectData(record.DataIdentifier, sender, scratchBuffer, beginTransmission);
+            return ObjectStore.TransmitObjectData(record.DataIdentifier, sender, scratchBuffer, beginTransmission, legacyFormat);
         }
 
         Dictionary<string, long?> KnownCanonicalNames = new Dictionary<string, long?>();
@@ -6252,16 +6479,30 @@ namespace Versionr
                 FileClassifier.Classify(parentFile) == FileEncoding.Binary;
 
             System.IO.File.Copy(ml, ml + ".mine", true);
+            // The native merge leaves conflict markers in its output; they are kept aside while an external tool gets
+            // a go at the same output file, and end up in the working file if the conflict stays unresolved.
+            string conflicted = null;
             if (!isBinary)
             {
-                bool xdiffSuccess = XDiffMerge3Way(mb, ml, mf, mr) == 0;
-                if (xdiffSuccess || Utilities.DiffTool.Merge3Way(mb, ml, mf, mr, Directives.ExternalMerge))
+                XDiffConflict[] conflicts;
+                int xdiffResult = XDiffMerge3Way(mb, ml, mf, mr, out conflicts);
+                if (xdiffResult == 1)
+                {
+                    Printer.PrintMessage("#w# - {0} conflicting region{1} at line {2}.##", conflicts.Length, conflicts.Length == 1 ? "" : "s", string.Join(", ", conflicts.Select(c => (c.OutputLine + 1).ToString())));
+                    conflicted = mr + ".conflicts";
+                    System.IO.File.Copy(mr, conflicted, true);
+                }
+                else if (xdiffResult == 3)
+                    Printer.PrintMessage("#e# - Couldn't read the merge inputs.##");
+                if (xdiffResult == 0 || Utilities.DiffTool.Merge3Way(mb, ml, mf, mr, Directives.ExternalMerge))
                 {
                     FileInfo fi = new FileInfo(ml + ".mine");
                     if (fi.IsReadOnly)
                         fi.IsReadOnly = false;
                     fi.Delete();
-                    if (!xdiffSuccess)
+                    if (conflicted != null)
+                        System.IO.File.Delete(conflicted);
+                    if (xdiffResult != 0)
                         Printer.PrintMessage("#s# - Resolved.##");
                     return temporaryFile;
                 }
@@ -6275,6 +6516,8 @@ namespace Versionr
                 if (fi.IsReadOnly)
                     fi.IsReadOnly = false;
                 fi.Delete();
+                if (conflicted != null)
+                    System.IO.File.Delete(conflicted);
                 return local;
             }
             if (resolution == ResolveType.Theirs)
@@ -6284,15 +6527,30 @@ namespace Versionr
                 if (fi.IsReadOnly)
                     fi.IsReadOnly = false;
                 fi.Delete();
+                if (conflicted != null)
+                    System.IO.File.Delete(conflicted);
                 return foreign;
             }
             else
             {
                 if (!allowConflict)
+                {
+                    if (conflicted != null)
+                        System.IO.File.Delete(conflicted);
                     throw new Exception();
+                }
                 System.IO.File.Move(mf, ml + ".theirs");
                 System.IO.File.Move(mb, ml + ".base");
-                Printer.PrintMessage("#e# - File not resolved. Please manually merge and then mark as resolved.##");
+                if (conflicted != null)
+                {
+                    if (local.IsReadOnly)
+                        local.IsReadOnly = false;
+                    System.IO.File.Copy(conflicted, ml, true);
+                    System.IO.File.Delete(conflicted);
+                    Printer.PrintMessage("#e# - File not resolved. Conflict markers were written to the file; please fix them and then mark as resolved.##");
+                }
+                else
+                    Printer.PrintMessage("#e# - File not resolved. Please manually merge and then mark as resolved.##");
                 return null;
             }
         }
@@ -345,6 +345,10 @@ namespace Versionr
         public string ExternalDiff { get; set; }
         public bool? NonBlockingDiff { get; set; }
         public bool? UseTortoiseMerge { get; set; }
+        // Megabytes the LZHAM codec may hold at once. Compression and decompression beyond it fail instead of exhausting memory.
+        public long? CodecMemoryLimit { get; set; }
+        // Record new LZHAM objects with the hash matcher (LZHAMCompressionParams.Fast). Meant for large first-time imports.
+        public bool? FastCompression { get; set; }
         public string ExternalMerge { get; set; }
         public string ExternalMerge2Way { get; set; }
         public SvnCompatibility Svn { get; set; }
@@ -411,6 +415,14 @@ namespace Versionr
                             NonBlockingDiff = System.Boolean.Parse(reader.Value.ToString());
                         else if (currentProperty == "UseTortoiseMerge")
                             UseTortoiseMerge = System.Boolean.Parse(reader.Value.ToString());
+                        else if (currentProperty == "FastCompression")
+                            FastCompression = System.Boolean.Parse(reader.Value.ToString());
+                        else
+                            Tokens[currentProperty] = Newtonsoft.Json.Linq.JToken.FromObject(reader.Value);
+                        break;
+                    case JsonToken.Integer:
+                        if (currentProperty == "CodecMemoryLimit")
+                            CodecMemoryLimit = System.Convert.ToInt64(reader.Value);
                         else
                             Tokens[currentProperty] = Newtonsoft.Json.Linq.JToken.FromObject(reader.Value);
                         break;
@@ -508,6 +520,10 @@ namespace Versionr
                 ExternalMerge2Way = other.ExternalMerge2Way;
             if (other.NonBlockingDiff != null)
                 NonBlockingDiff = other.NonBlockingDiff;
+            if (other.CodecMemoryLimit != null)
+                CodecMemoryLimit = other.CodecMemoryLimit;
+            if (other.FastCompression != null)
+                FastCompression = other.FastCompression;
             if (other.m_UserName != null)
                 m_UserName = other.m_UserName;
             if (!string.IsNullOrEmpty(other.ObjectStorePath))
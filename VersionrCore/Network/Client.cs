@@ -1231,6 +1231,8 @@ namespace Versionr.Network
                     Printer.PrintDiagnostics("Connected to server at {0}:{1}", host, port);
                     Handshake hs = Handshake.Create(protocols.Current);
                     hs.RequestedModule = Module;
+                    hs.LZHLWindowBits = Versionr.Utilities.LZHL.PreferredWindowBits;
+                    hs.LZHLStreaming = Versionr.Utilities.LZHL.AllowStreaming;
                     Printer.PrintDiagnostics("Sending handshake...");
                     Connection.NoDelay = true;
                     ProtoBuf.Serializer.SerializeWithLengthPrefix<Handshake>(Connection.GetStream(), hs, ProtoBuf.PrefixStyle.Fixed32);
@@ -1369,6 +1371,9 @@ namespace Versionr.Network
                             Client = true,
                             CommunicationProtocol = protocols.Current
                         };
+                        sharedInfo.SetLZHLWindow(Versionr.Utilities.LZHL.NegotiateWindowBits(startTransaction.ServerHandshake.LZHLWindowBits));
+                        if (startTransaction.ServerHandshake.LZHLStreaming == true)
+                            sharedInfo.EnableLZHLStreaming();
 
                         SharedInfo = sharedInfo;
                     }
@@ -1388,6 +1393,9 @@ namespace Versionr.Network
                             Client = true,
                             CommunicationProtocol = protocols.Current
                         };
+                        sharedInfo.SetLZHLWindow(Versionr.Utilities.LZHL.NegotiateWindowBits(startTransaction.ServerHandshake.LZHLWindowBits));
+                        if (startTransaction.ServerHandshake.LZHLStreaming == true)
+                            sharedInfo.EnableLZHLStreaming();
                         SharedInfo = sharedInfo;
                     }
                     return true;
@@ -16,6 +16,14 @@ namespace Versionr.Network
         [ProtoMember(2)]
         public string RequestedModule { get; set; }
 
+        // Client: largest LZHL window it accepts. Server: the window both sides will use.
+        [ProtoMember(3)]
+        public int? LZHLWindowBits { get; set; }
+
+        // Client: supports streamed LZH packets. Server: streaming is on for this connection.
+        [ProtoMember(4)]
+        public bool? LZHLStreaming { get; set; }
+
         public static Dictionary<SharedNetwork.Protocol, string> Protocols;
         
         static Handshake()
@@ -31,6 +39,7 @@ namespace Versionr.Network
             Protocols[SharedNetwork.Protocol.Versionr35] = "Versionr/Protocol:3.5";
             Protocols[SharedNetwork.Protocol.Versionr36] = "Versionr/Protocol:3.6";
             Protocols[SharedNetwork.Protocol.Versionr37] = "Versionr/Protocol:3.7";
+            Protocols[SharedNetwork.Protocol.Versionr38] = "Versionr/Protocol:3.8";
         }
 
         public static string GetProtocolString(SharedNetwork.Protocol protocol)
@@ -369,12 +369,17 @@ namespace Versionr.Network
                         if (!domainInfo.Bare && ws == null)
                             throw new Exception("No workspace at server path!");
                         sharedInfo.CommunicationProtocol = clientProtocol.Value;
+                        sharedInfo.SetLZHLWindow(Versionr.Utilities.LZHL.NegotiateWindowBits(hs.LZHLWindowBits));
+                        if (hs.LZHLStreaming == true && Versionr.Utilities.LZHL.AllowStreaming)
+                            sharedInfo.EnableLZHLStreaming();
                         Network.StartTransaction startSequence = null;
                         clientInfo.Access = Rights.Read | Rights.Write;
                         clientInfo.BareAccessRequired = domainInfo.Bare;
                         if (PrivateKey != null)
                         {
                             startSequence = Network.StartTransaction.Create(domainInfo.Bare ? string.Empty : ws.Domain.ToString(), PublicKey, clientProtocol.Value);
+                            startSequence.ServerHandshake.LZHLWindowBits = sharedInfo.LZHLWindowBits;
+                            startSequence.ServerHandshake.LZHLStreaming = sharedInfo.LZHLStreaming;
                             Printer.PrintDiagnostics("Sending RSA key...");
                             ProtoBuf.Serializer.SerializeWithLengthPrefix<Network.StartTransaction>(stream, startSequence, ProtoBuf.PrefixStyle.Fixed32);
                             if (!HandleAuthentication(clientInfo, client, sharedInfo))
@@ -393,6 +398,8 @@ namespace Versionr.Network
                         else
                         {
                             startSequence = Network.StartTransaction.Create(domainInfo.Bare ? string.Empty : ws.Domain.ToString(), clientProtocol.Value);
+                            startSequence.ServerHandshake.LZHLWindowBits = sharedInfo.LZHLWindowBits;
+                            startSequence.ServerHandshake.LZHLStreaming = sharedInfo.LZHLStreaming;
                             ProtoBuf.Serializer.SerializeWithLengthPrefix<Network.StartTransaction>(stream, startSequence, ProtoBuf.PrefixStyle.Fixed32);
                             if (!HandleAuthentication(clientInfo, client, sharedInfo))
                                 throw new Exception("Authentication failed.");
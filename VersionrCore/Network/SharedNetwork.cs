@@ -23,6 +23,7 @@ namespace Versionr.Network
             Versionr35,
             Versionr36,
             Versionr37,
+            Versionr38,
         }
         public static bool SupportsAuthentication(Protocol protocol)
         {
@@ -30,7 +31,13 @@ namespace Versionr.Network
                 return false;
             return true;
         }
-        public static Protocol[] AllowedProtocols = new Protocol[] { Protocol.Versionr37, Protocol.Versionr36, Protocol.Versionr35, Protocol.Versionr34, Protocol.Versionr33, Protocol.Versionr32, Protocol.Versionr31 };
+        // Records written with independent LZHAM chunks, seeded deltas or shared dictionaries can only be read from 3.8 on; older
+        // peers are sent those records rewritten in the original layout.
+        public static bool SupportsCurrentRecordFormat(Protocol protocol)
+        {
+            return protocol >= Protocol.Versionr38;
+        }
+        public static Protocol[] AllowedProtocols = new Protocol[] { Protocol.Versionr38, Protocol.Versionr37, Protocol.Versionr36, Protocol.Versionr35, Protocol.Versionr34, Protocol.Versionr33, Protocol.Versionr32, Protocol.Versionr31 };
         public static Protocol DefaultProtocol
         {
             get
@@ -85,9 +92,40 @@ namespace Versionr.Network
 
             public IntPtr LZHLCompressor { get; set; }
             public IntPtr LZHLDecompressor { get; set; }
+            public int LZHLWindowBits { get; private set; }
+            public IntPtr LZHLStreamCompressor { get; private set; }
+            public IntPtr LZHLStreamDecompressor { get; private set; }
+            public bool LZHLStreamResync { get; set; }
+            private IntPtr m_LZHLCompressPipeline;
+            // Worker compressors for Utilities.PreparePackets, created on first use.
+            public IntPtr LZHLCompressPipeline
+            {
+                get
+                {
+                    if (m_LZHLCompressPipeline == IntPtr.Zero)
+                        m_LZHLCompressPipeline = Versionr.Utilities.LZHL.CreateCompressPipeline(LZHLWindowBits, 0);
+                    return m_LZHLCompressPipeline;
+                }
+            }
+            public bool LZHLStreaming
+            {
+                get
+                {
+                    return LZHLStreamCompressor != IntPtr.Zero;
+                }
+            }
 
             public Dictionary<Guid, Guid> RemoteHeadInfo { get; set; }
 
+            // Decompressed packets are deserialized before the next receive, so one buffer per connection suffices.
+            private byte[] m_ReceiveBuffer;
+            public byte[] GetReceiveBuffer(int size)
+            {
+                if (m_ReceiveBuffer == null || m_ReceiveBuffer.Length < size)
+                    m_ReceiveBuffer = new byte[Math.Max(size, m_ReceiveBuffer == null ? 0 : m_ReceiveBuffer.Length * 2)];
+                return m_ReceiveBuffer;
+            }
+
             public SharedNetworkInfo()
             {
                 RemoteCheckedVersions = new HashSet<Guid>();
@@ -100,6 +138,7 @@ namespace Versionr.Network
                 RemoteRecordMap = new Dictionary<long, Record>();
                 LocalRecordMap = new Dictionary<long, Record>();
                 ReceivedBranchJournals = new List<BranchJournalPack>();
+                LZHLWindowBits = Versionr.Utilities.LZHL.DefaultWindowBits;
                 LZHLCompressor = Versionr.Utilities.LZHL.CreateCompressor();
                 LZHLDecompressor = Versionr.Utilities.LZHL.CreateDecompressor();
                 ChecksumType = Utilities.ChecksumCodec.Default;
@@ -107,6 +146,32 @@ namespace Versionr.Network
                 Automerges = new List<Guid>();
             }
 
+            public void SetLZHLWindow(int windowBits)
+            {
+                if (windowBits == LZHLWindowBits)
+                    return;
+                Versionr.Utilities.LZHL.DestroyCompressor(LZHLCompressor);
+                Versionr.Utilities.LZHL.DestroyDecompressor(LZHLDecompressor);
+                if (m_LZHLCompressPipeline != IntPtr.Zero)
+                {
+                    Versionr.Utilities.LZHL.DestroyCompressPipeline(m_LZHLCompressPipeline);
+                    m_LZHLCompressPipeline = IntPtr.Zero;
+                }
+                LZHLWindowBits = windowBits;
+                LZHLCompressor = Versionr.Utilities.LZHL.CreateCompressor(windowBits);
+                LZHLDecompressor = Versionr.Utilities.LZHL.CreateDecompressor(windowBits);
+            }
+
+            // Separate codecs so that standalone LZH packets never disturb the stream state.
+            public void EnableLZHLStreaming()
+            {
+                if (LZHLStreaming)
+                    return;
+                LZHLStreamCompressor = Versionr.Utilities.LZHL.CreateCompressor(LZHLWindowBits);
+                LZHLStreamDecompressor = Versionr.Utilities.LZHL.CreateDecompressor(LZHLWindowBits);
+                LZHLStreamResync = true;
+            }
+
             #region IDisposable Support
             private bool m_DisposedValue = false; // To detect redundant calls
 
@@ -116,6 +181,13 @@ namespace Versionr.Network
                 {
                     Versionr.Utilities.LZHL.DestroyCompressor(LZHLCompressor);
                     Versionr.Utilities.LZHL.DestroyDecompressor(LZHLDecompressor);
+                    if (LZHLStreaming)
+                    {
+                        Versionr.Utilities.LZHL.DestroyCompressor(LZHLStreamCompressor);
+                        Versionr.Utilities.LZHL.DestroyDecompressor(LZHLStreamDecompressor);
+                    }
+                    if (m_LZHLCompressPipeline != IntPtr.Zero)
+                        Versionr.Utilities.LZHL.DestroyCompressPipeline(m_LZHLCompressPipeline);
 
                     m_DisposedValue = true;
                 }
@@ -684,6 +756,19 @@ namespace Versionr.Network
             }
         }
 
+        private static IEnumerable<VersionPack> CreatePacks(SharedNetworkInfo sharedInfo, Stack<Objects.Version> versionsToSend)
+        {
+            while (versionsToSend.Count > 0)
+            {
+                List<Objects.Version> versionData = new List<Objects.Version>();
+                while (versionData.Count < 512 && versionsToSend.Count > 0)
+                {
+                    versionData.Add(versionsToSend.Pop());
+                }
+                yield return CreatePack(sharedInfo, versionData);
+            }
+        }
+
         private static VersionPack CreatePack(SharedNetworkInfo sharedInfo, List<Objects.Version> versionData)
         {
             VersionPack pack = new VersionPack();
@@ -740,17 +825,11 @@ namespace Versionr.Network
                         return true;
                     return false;
                 }
-                while (versionsToSend.Count > 0)
+                foreach (var packet in Utilities.PreparePackets(sharedInfo, CreatePacks(sharedInfo, versionsToSend)))
                 {
-                    List<Objects.Version> versionData = new List<Objects.Version>();
-                    while (versionData.Count < 512 && versionsToSend.Count > 0)
-                    {
-                        versionData.Add(versionsToSend.Pop());
-                    }
                     Printer.PrintDiagnostics("Sending version data pack...");
                     ProtoBuf.Serializer.SerializeWithLengthPrefix<NetCommand>(sharedInfo.Stream, new NetCommand() { Type = NetCommandType.PushVersions }, ProtoBuf.PrefixStyle.Fixed32);
-                    VersionPack pack = CreatePack(sharedInfo, versionData);
-                    Utilities.SendEncrypted(sharedInfo, pack);
+                    Utilities.SendPrepared(sharedInfo, packet);
 
                     NetCommand response = ProtoBuf.Serializer.DeserializeWithLengthPrefix<NetCommand>(sharedInfo.Stream, ProtoBuf.PrefixStyle.Fixed32);
                     if (response.Type == NetCommandType.Acknowledge)
@@ -827,7 +906,7 @@ namespace Versionr.Network
                             if (!sharedInfo.Workspace.TransmitRecordData(record, sender, tempBuffer, () =>
                             {
                                 sender(BitConverter.GetBytes(x), 8, false);
-                            }))
+                            }, !SupportsCurrentRecordFormat(sharedInfo.CommunicationProtocol)))
                             {
                                 sender(BitConverter.GetBytes(-x), 8, false);
                             }
@@ -1448,7 +1527,7 @@ namespace Versionr.Network
                     {
                         int success = 1;
                         sender(BitConverter.GetBytes(success), 4, false);
-                    }))
+                    }, !SupportsCurrentRecordFormat(sharedInfo.CommunicationProtocol)))
                     {
                         int failure = 0;
                         sender(BitConverter.GetBytes(failure), 4, false);
@@ -1686,6 +1765,19 @@ namespace Versionr.Network
             }
         }
 
+        private static IEnumerable<PushBranches> CreateBranchPacks(Stack<Branch> branchesToSend)
+        {
+            while (branchesToSend.Count > 0)
+            {
+                List<Objects.Branch> branchData = new List<Branch>();
+                while (branchData.Count < 512 && branchesToSend.Count > 0)
+                {
+                    branchData.Add(branchesToSend.Pop());
+                }
+                yield return new PushBranches() { Branches = branchData.ToArray() };
+            }
+        }
+
         internal static bool SendBranches(SharedNetworkInfo sharedInfo, Stack<Branch> branchesToSend)
         {
             try
@@ -1693,17 +1785,11 @@ namespace Versionr.Network
                 if (branchesToSend.Count == 0)
                     return true;
                 Printer.PrintDiagnostics("Synchronizing {0} branches to remote.", branchesToSend.Count);
-                while (branchesToSend.Count > 0)
+                foreach (var packet in Utilities.PreparePackets(sharedInfo, CreateBranchPacks(branchesToSend)))
                 {
-                    List<Objects.Branch> branchData = new List<Branch>();
-                    while (branchData.Count < 512 && branchesToSend.Count > 0)
-                    {
-                        branchData.Add(branchesToSend.Pop());
-                    }
                     Printer.PrintDiagnostics("Sending branch data pack...");
                     ProtoBuf.Serializer.SerializeWithLengthPrefix<NetCommand>(sharedInfo.Stream, new NetCommand() { Type = NetCommandType.PushBranch }, ProtoBuf.PrefixStyle.Fixed32);
-                    PushBranches pb = new PushBranches() { Branches = branchData.ToArray() };
-                    Utilities.SendEncrypted(sharedInfo, pb);
+                    Utilities.SendPrepared(sharedInfo, packet);
                     NetCommand response = ProtoBuf.Serializer.DeserializeWithLengthPrefix<NetCommand>(sharedInfo.Stream, ProtoBuf.PrefixStyle.Fixed32);
                     if (response.Type != NetCommandType.Acknowledge)
                         return false;
@@ -14,6 +14,7 @@ namespace Versionr.Network
             None,
             LZ4,
             LZH,
+            LZHStream,
         }
         public enum ChecksumCodec
         {
@@ -65,14 +66,14 @@ namespace Versionr.Network
             }
         }
 
-        public static uint ComputeChecksumAdler32(byte[] array)
+        public static uint ComputeChecksumAdler32(byte[] array, int length = -1)
         {
-            return ObjectStore.ChunkedChecksum.FastHash(array, array.Length);
+            return Versionr.Utilities.NativeChecksum.FastHash(array, length);
         }
 
-        public static uint ComputeChecksumXXHash(byte[] array)
+        public static uint ComputeChecksumXXHash(byte[] array, int length = -1)
         {
-            return xxHashSharp.xxHash.CalculateHash(array);
+            return Versionr.Utilities.NativeChecksum.XXHash32(array, length);
         }
 
         internal static Dictionary<Type, bool> s_Compressible = new Dictionary<Type, bool>();
@@ -98,6 +99,62 @@ namespace Versionr.Network
                 result = memoryStream.ToArray();
             }
 
+            ChecksumCodec ccode = GetChecksumCodec(info);
+            uint checksum = ComputeChecksum(ccode, result);
+            int? decompressedSize = null;
+            byte[] compressedBuffer = null;
+            PacketCompressionCodec codec = PacketCompressionCodec.None;
+            if (result.Length > 256 && !bypassCompression)
+            {
+                // Only packets written straight to the connection are in stream order.
+                if (info.LZHLStreaming && target == null)
+                {
+                    compressedBuffer = new byte[Versionr.Utilities.LZHL.CompressBound((uint)result.Length) + 1];
+                    uint compressedSize = Versionr.Utilities.LZHL.CompressStream(info.LZHLStreamCompressor, result, (uint)result.Length, compressedBuffer, info.LZHLStreamResync);
+                    if (compressedSize < result.Length)
+                    {
+                        Array.Resize(ref compressedBuffer, (int)compressedSize);
+                        decompressedSize = result.Length;
+                        codec = PacketCompressionCodec.LZHStream;
+                        result = compressedBuffer;
+                        info.LZHLStreamResync = false;
+                    }
+                    else
+                        info.LZHLStreamResync = true; // the receiver never sees this packet's history
+                }
+                // A negotiated large window means the peer decodes LZH packets with the same window.
+                else if (info.LZHLWindowBits > Versionr.Utilities.LZHL.DefaultWindowBits)
+                {
+                    Versionr.Utilities.LZHL.ResetCompressor(info.LZHLCompressor);
+                    compressedBuffer = new byte[Versionr.Utilities.LZHL.CompressBound((uint)result.Length)];
+                    uint compressedSize = Versionr.Utilities.LZHL.Compress(info.LZHLCompressor, result, (uint)result.Length, compressedBuffer);
+                    if (compressedSize < result.Length)
+                    {
+                        Array.Resize(ref compressedBuffer, (int)compressedSize);
+                        decompressedSize = result.Length;
+                        codec = PacketCompressionCodec.LZH;
+                        result = compressedBuffer;
+                    }
+                }
+                else
+                {
+                    compressedBuffer = LZ4.LZ4Codec.Encode(result, 0, result.Length);
+                    if (compressedBuffer.Length < result.Length)
+                    {
+                        decompressedSize = result.Length;
+                        codec = PacketCompressionCodec.LZ4;
+                        result = compressedBuffer;
+                    }
+                }
+            }
+            else
+                codec = PacketCompressionCodec.None;
+
+            WritePacket(info, result, checksum, ccode, codec, decompressedSize, target);
+        }
+
+        static ChecksumCodec GetChecksumCodec(SharedNetwork.SharedNetworkInfo info)
+        {
             ChecksumCodec ccode = info.ChecksumType;
             if (ccode == ChecksumCodec.Default)
             {
@@ -106,6 +163,11 @@ namespace Versionr.Network
                 else
                     ccode = ChecksumCodec.FastFNV;
             }
+            return ccode;
+        }
+
+        static uint ComputeChecksum(ChecksumCodec ccode, byte[] result)
+        {
             uint checksum = 0;
             if (ccode == ChecksumCodec.XXHash)
                 checksum = ComputeChecksumXXHash(result);
@@ -119,22 +181,127 @@ namespace Versionr.Network
                 var hash = hasher.ComputeHash(result);
                 checksum = BitConverter.ToUInt32(hash, 0) ^ BitConverter.ToUInt32(hash, 4) ^ BitConverter.ToUInt32(hash, 8) ^ BitConverter.ToUInt32(hash, 12);
             }
-            int? decompressedSize = null;
-            byte[] compressedBuffer = null;
-            PacketCompressionCodec codec = PacketCompressionCodec.None;
-            if (result.Length > 256 && !bypassCompression)
+            return checksum;
+        }
+
+        // A serialized, checksummed and compressed packet that only needs encrypting and writing.
+        internal class PreparedPacket
+        {
+            public byte[] Data;
+            public uint Checksum;
+            public ChecksumCodec ChecksumType;
+            public PacketCompressionCodec Compression;
+            public int? DecompressedSize;
+        }
+
+        // Serializes the arguments on the calling thread and compresses and checksums them in batches on the native
+        // pipeline, one batch ahead of the caller, so the caller only encrypts and writes. Packets come back in order.
+        internal static IEnumerable<PreparedPacket> PreparePackets<T>(SharedNetwork.SharedNetworkInfo info, IEnumerable<T> arguments)
+        {
+            ChecksumCodec ccode = GetChecksumCodec(info);
+            IntPtr pipeline = info.LZHLCompressPipeline;
+            if (pipeline == IntPtr.Zero)
+                throw new Exception("Couldn't start the LZHL compression workers.");
+            int batchSize = Environment.ProcessorCount * 2;
+            List<byte[]> batch = new List<byte[]>();
+            Task<PreparedPacket[]> pending = null;
+            try
             {
-                compressedBuffer = LZ4.LZ4Codec.Encode(result, 0, result.Length);
-                if (compressedBuffer.Length < result.Length)
+                foreach (var x in arguments)
                 {
-                    decompressedSize = result.Length;
-                    codec = PacketCompressionCodec.LZ4;
-                    result = compressedBuffer;
+                    using (System.IO.MemoryStream memoryStream = new System.IO.MemoryStream())
+                    {
+                        ProtoBuf.Serializer.Serialize<T>(memoryStream, x);
+                        batch.Add(memoryStream.ToArray());
+                    }
+                    if (batch.Count < batchSize)
+                        continue;
+                    // Only one batch uses the pipeline at a time.
+                    PreparedPacket[] finished = pending != null ? pending.Result : null;
+                    List<byte[]> next = batch;
+                    pending = Task.Run(() => CompressBatch(pipeline, ccode, next));
+                    batch = new List<byte[]>();
+                    if (finished != null)
+                    {
+                        foreach (var y in finished)
+                            yield return y;
+                    }
+                }
+                if (pending != null)
+                {
+                    foreach (var y in pending.Result)
+                        yield return y;
+                    pending = null;
+                }
+                if (batch.Count > 0)
+                {
+                    foreach (var y in CompressBatch(pipeline, ccode, batch))
+                        yield return y;
                 }
             }
-            else
-                codec = PacketCompressionCodec.None;
+            finally
+            {
+                // The pipeline belongs to the connection, which may be disposed once the caller stops early.
+                if (pending != null)
+                    pending.Wait();
+            }
+        }
+
+        static PreparedPacket[] CompressBatch(IntPtr pipeline, ChecksumCodec ccode, List<byte[]> payloads)
+        {
+            int count = payloads.Count;
+            uint[] offsets = new uint[count + 1];
+            uint[] compressedOffsets = new uint[count];
+            uint total = 0;
+            uint compressedTotal = 0;
+            for (int i = 0; i < count; i++)
+            {
+                offsets[i] = total;
+                compressedOffsets[i] = compressedTotal;
+                total += (uint)payloads[i].Length;
+                compressedTotal += Versionr.Utilities.LZHL.CompressBound((uint)payloads[i].Length);
+            }
+            offsets[count] = total;
+            byte[] input = new byte[total];
+            for (int i = 0; i < count; i++)
+                Buffer.BlockCopy(payloads[i], 0, input, (int)offsets[i], payloads[i].Length);
+
+            byte[] output = new byte[compressedTotal];
+            uint[] compressedSizes = new uint[count];
+            uint[] checksums = ccode == ChecksumCodec.FastFNV ? new uint[count] : null;
+            if (Versionr.Utilities.LZHL.CompressBatch(pipeline, count, input, offsets, output, compressedOffsets, compressedSizes, checksums) != 0)
+                throw new Exception("LZHL batch compression failed.");
+
+            PreparedPacket[] result = new PreparedPacket[count];
+            for (int i = 0; i < count; i++)
+            {
+                byte[] payload = payloads[i];
+                PreparedPacket packet = new PreparedPacket()
+                {
+                    Data = payload,
+                    Checksum = checksums != null ? checksums[i] : ComputeChecksum(ccode, payload),
+                    ChecksumType = ccode,
+                    Compression = PacketCompressionCodec.None
+                };
+                if (payload.Length > 256 && compressedSizes[i] < payload.Length)
+                {
+                    packet.Data = new byte[compressedSizes[i]];
+                    Buffer.BlockCopy(output, (int)compressedOffsets[i], packet.Data, 0, packet.Data.Length);
+                    packet.Compression = PacketCompressionCodec.LZH;
+                    packet.DecompressedSize = payload.Length;
+                }
+                result[i] = packet;
+            }
+            return result;
+        }
 
+        internal static void SendPrepared(SharedNetwork.SharedNetworkInfo info, PreparedPacket packet, System.IO.Stream target = null)
+        {
+            WritePacket(info, packet.Data, packet.Checksum, packet.ChecksumType, packet.Compression, packet.DecompressedSize, target);
+        }
+
+        static void WritePacket(SharedNetwork.SharedNetworkInfo info, byte[] result, uint checksum, ChecksumCodec ccode, PacketCompressionCodec codec, int? decompressedSize, System.IO.Stream target)
+        {
             int payload = result.Length;
             if (info.EncryptorFunction != null)
             {
@@ -164,25 +331,9 @@ namespace Versionr.Network
                 ProtoBuf.Serializer.SerializeWithLengthPrefix<Packet>(target, packet, ProtoBuf.PrefixStyle.Fixed32);
         }
 
-        public static unsafe uint ComputeChecksumFNVWeak(byte[] result)
+        public static uint ComputeChecksumFNVWeak(byte[] result, int length = -1)
         {
-            uint fnv = 2166136261;
-            int size = result.Length;
-            int i = 0;
-            fixed (byte* p = result)
-            {
-                for (; i < size - 4; i += 4)
-                {
-                    fnv ^= *(uint*)(p + i);
-                    fnv *= 16777619;
-                }
-            }
-            while (i != size)
-            {
-                fnv ^= result[i++];
-                fnv *= 16777619;
-            }
-            return fnv;
+            return Versionr.Utilities.NativeChecksum.FNVWeak(result, length);
         }
 
         public static T ReceiveEncrypted<T>(SharedNetwork.SharedNetworkInfo info)
@@ -194,9 +345,11 @@ namespace Versionr.Network
             Printer.PrintDiagnostics("Received {0} byte packet.", packet.Data.Length);
 
             byte[] decryptedData = packet.Data;
+            int dataLength = decryptedData.Length;
             if (info.DecryptorFunction != null)
             {
                 decryptedData = new byte[packet.PayloadSize];
+                dataLength = decryptedData.Length;
                 if (packet.PayloadSize > 0)
                 {
                     using (System.IO.MemoryStream memoryStream = new System.IO.MemoryStream(packet.Data))
@@ -214,14 +367,28 @@ namespace Versionr.Network
                     case PacketCompressionCodec.None:
                         break;
                     case PacketCompressionCodec.LZ4:
-                        decryptedData = LZ4.LZ4Codec.Decode(decryptedData, 0, decryptedData.Length, packet.DecompressedSize.Value);
+                        decryptedData = LZ4.LZ4Codec.Decode(decryptedData, 0, dataLength, packet.DecompressedSize.Value);
+                        dataLength = decryptedData.Length;
                         break;
                     case PacketCompressionCodec.LZH:
                     {
                         Versionr.Utilities.LZHL.ResetDecompressor(info.LZHLDecompressor);
-                        byte[] result = new byte[packet.DecompressedSize.Value];
-                        Versionr.Utilities.LZHL.Decompress(info.LZHLDecompressor, decryptedData, (uint)decryptedData.Length, result, (uint)result.Length);
+                        byte[] result = info.GetReceiveBuffer(packet.DecompressedSize.Value);
+                        if (Versionr.Utilities.LZHL.DecompressPacket(info.LZHLDecompressor, false, decryptedData, dataLength, result, packet.DecompressedSize.Value) != packet.DecompressedSize.Value)
+                            throw new Exception("LZH packet failed to decompress!");
+                        decryptedData = result;
+                        dataLength = packet.DecompressedSize.Value;
+                        break;
+                    }
+                    case PacketCompressionCodec.LZHStream:
+                    {
+                        if (!info.LZHLStreaming)
+                            throw new Exception("Received a streamed LZH packet without negotiating it!");
+                        byte[] result = info.GetReceiveBuffer(packet.DecompressedSize.Value);
+                        if (Versionr.Utilities.LZHL.DecompressPacket(info.LZHLStreamDecompressor, true, decryptedData, dataLength, result, packet.DecompressedSize.Value) != packet.DecompressedSize.Value)
+                            throw new Exception("Streamed LZH packet failed to decompress!");
                         decryptedData = result;
+                        dataLength = packet.DecompressedSize.Value;
                         break;
                     }
                 }
@@ -232,22 +399,22 @@ namespace Versionr.Network
             {
                 uint checksum = 0;
                 if (packet.Checksum == ChecksumCodec.XXHash)
-                    checksum = ComputeChecksumXXHash(decryptedData);
+                    checksum = ComputeChecksumXXHash(decryptedData, dataLength);
                 if (packet.Checksum == ChecksumCodec.Adler32)
-                    checksum = ComputeChecksumAdler32(decryptedData);
+                    checksum = ComputeChecksumAdler32(decryptedData, dataLength);
                 if (packet.Checksum == ChecksumCodec.FastFNV)
-                    checksum = ComputeChecksumFNVWeak(decryptedData);
+                    checksum = ComputeChecksumFNVWeak(decryptedData, dataLength);
                 if (packet.Checksum == ChecksumCodec.MurMur3)
                 {
                     var hasher = new Versionr.Utilities.Murmur3();
-                    var hash = hasher.ComputeHash(decryptedData);
+                    var hash = hasher.ComputeHash(decryptedData, dataLength);
                     checksum = BitConverter.ToUInt32(hash, 0) ^ BitConverter.ToUInt32(hash, 4) ^ BitConverter.ToUInt32(hash, 8) ^ BitConverter.ToUInt32(hash, 12);
                 }
                 if (checksum != packet.Hash)
                     throw new Exception("Data did not survive the trip!");
             }
 
-            using (System.IO.MemoryStream memoryStream = new System.IO.MemoryStream(decryptedData))
+            using (System.IO.MemoryStream memoryStream = new System.IO.MemoryStream(decryptedData, 0, dataLength))
             {
                 return ProtoBuf.Serializer.Deserialize<T>(memoryStream);
             }
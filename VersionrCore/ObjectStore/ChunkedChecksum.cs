@@ -365,14 +365,7 @@ namespace Versionr.ObjectStore
 
         public static uint FastHash(byte[] block, int size)
         {
-            ushort a = 1;
-            ushort b = 0;
-            for (int i = 0; i < size; i++)
-            {
-                a = (ushort)(block[i] + a);
-                b = (ushort)(b + a);
-            }
-            return (uint)((b << 16) | a);
+            return Utilities.NativeChecksum.FastHash(block, size);
         }
 
         internal static void Write(System.IO.Stream stream, ChunkedChecksum result)
@@ -9,6 +9,25 @@ namespace Versionr.ObjectStore
 {
     public abstract class ChunkedDecompressionStream : System.IO.Stream
     {
+        // Set in the stored chunk size when every chunk was compressed as a separate stream.
+        internal const int IndependentChunksFlag = 0x40000000;
+
+        // Independent chunk table entries keep the chunk length in the low bits and how it was written in the top two.
+        // Stored chunks are raw bytes; the other modes are all handed to RefillBuffer. Must match lzhamwrapper.
+        internal const int ChunkModeShift = 30;
+        internal const uint ChunkLengthMask = (1u << ChunkModeShift) - 1;
+        internal const uint ChunkModeStored = 1;
+
+        internal static uint ChunkLength(uint entry)
+        {
+            return entry & ChunkLengthMask;
+        }
+
+        internal static bool IsStoredChunk(uint entry)
+        {
+            return (entry >> ChunkModeShift) == ChunkModeStored;
+        }
+
         long m_Length;
         long[] m_ChunkOffsets;
         uint[] m_ChunkSizes;
@@ -23,6 +42,8 @@ namespace Versionr.ObjectStore
         int m_CurrentChunkSize;
         System.IO.Stream m_UnderlyingStream;
 
+        protected bool IndependentChunks { get; private set; }
+
         public ChunkedDecompressionStream(long size, int chunksize, Stream baseStream)
         {
             m_UnderlyingStream = baseStream;
@@ -35,7 +56,8 @@ namespace Versionr.ObjectStore
             List<long> offsets = new List<long>();
             List<uint> sizes = new List<uint>();
             byte[] temp = new byte[4];
-            m_ChunkSize = chunksize;
+            IndependentChunks = (chunksize & IndependentChunksFlag) != 0;
+            m_ChunkSize = chunksize & ~IndependentChunksFlag;
             while (true)
             {
                 baseStream.Read(temp, 0, 4);
@@ -50,7 +72,7 @@ namespace Versionr.ObjectStore
                 }
                 else
                     currentPos += m_ChunkSize;
-                compressedPos += chunkSize;
+                compressedPos += ChunkLength(chunkSize);
             }
             m_UnderlyingStreamOffset = m_UnderlyingStream.Position;
 
@@ -65,17 +87,101 @@ namespace Versionr.ObjectStore
             byte[] temp = new byte[4];
             baseStream.Read(temp, 0, 4);
             chunkSize = BitConverter.ToInt32(temp, 0);
-            if (chunkSize >= fileSize)
+            if ((chunkSize & ~IndependentChunksFlag) >= fileSize)
             {
                 baseStream.Read(temp, 0, 4);
-                uint compressedSize = BitConverter.ToUInt32(temp, 0);
-                byte[] compressedData = new byte[compressedSize];
-                baseStream.Read(compressedData, 0, (int)compressedSize);
+                uint entry = BitConverter.ToUInt32(temp, 0);
+                byte[] compressedData = new byte[ChunkLength(entry)];
+                baseStream.Read(compressedData, 0, compressedData.Length);
+                if (IsStoredChunk(entry))
+                    return new MemoryStream(compressedData);
                 return new MemoryStream(decompress(compressedData, 0, compressedData.Length, (int)fileSize));
             }
             return null;
         }
 
+        protected int ChunkSize
+        {
+            get
+            {
+                return m_ChunkSize;
+            }
+        }
+
+        // Index of the chunk being decoded while RefillBuffer runs.
+        protected int CurrentChunk
+        {
+            get
+            {
+                return m_ChunkIndex;
+            }
+        }
+
+        protected Stream UnderlyingStream
+        {
+            get
+            {
+                return m_UnderlyingStream;
+            }
+        }
+
+        // Offset of the chunk size header in the underlying stream.
+        protected long ContainerOffset
+        {
+            get
+            {
+                return m_UnderlyingStreamOffset - m_ChunkOffsets.Length * 4 - 4;
+            }
+        }
+
+        // For subclasses that decoded the remaining data by other means.
+        protected void SkipToEnd()
+        {
+            m_Position = m_Length;
+        }
+
+        // Writes everything from the current position to outputStream, handing whole runs of up to maxBatch compressed chunks
+        // to decompress(compressedData, compressedSizes, chunkCount, output, outputLength) instead of going through the chunk buffer.
+        protected void DecompressChunksTo(Stream outputStream, int maxBatch, Action<byte[], uint[], int, byte[], int> decompress)
+        {
+            int chunk = (int)(m_Position / m_ChunkSize);
+            if (m_Position >= m_Length || chunk >= m_ChunkOffsets.Length)
+                return;
+            int skip = (int)(m_Position - (long)chunk * m_ChunkSize);
+            int batch = System.Math.Max(1, System.Math.Min(maxBatch, m_ChunkOffsets.Length - chunk));
+            byte[] output = new byte[batch * m_ChunkSize];
+            uint[] sizes = new uint[batch];
+            byte[] compressedData = null;
+            while (chunk < m_ChunkOffsets.Length)
+            {
+                int count = System.Math.Min(batch, m_ChunkOffsets.Length - chunk);
+                long compressedLength = 0;
+                for (int i = 0; i < count; i++)
+                {
+                    sizes[i] = m_ChunkSizes[chunk + i];
+                    compressedLength += ChunkLength(sizes[i]);
+                }
+                if (compressedData == null || compressedData.Length < compressedLength)
+                    compressedData = new byte[compressedLength];
+                m_UnderlyingStream.Position = m_ChunkOffsets[chunk] + m_UnderlyingStreamOffset;
+                int read = 0;
+                while (read < compressedLength)
+                {
+                    int result = m_UnderlyingStream.Read(compressedData, read, (int)compressedLength - read);
+                    if (result <= 0)
+                        throw new EndOfStreamException();
+                    read += result;
+                }
+                bool lastChunk = chunk + count == m_ChunkOffsets.Length;
+                int outputLength = (count - 1) * m_ChunkSize + (lastChunk ? m_LastChunkSize : m_ChunkSize);
+                decompress(compressedData, sizes, count, output, outputLength);
+                outputStream.Write(output, skip, outputLength - skip);
+                skip = 0;
+                chunk += count;
+            }
+            m_Position = m_Length;
+        }
+
         protected void Reset()
         {
             m_ChunkIndex = -1;
@@ -157,11 +263,14 @@ namespace Versionr.ObjectStore
                 m_ChunkIndex = posChunk;
                 m_BasePosition = m_ChunkIndex * m_ChunkSize;
                 m_UnderlyingStream.Position = m_ChunkOffsets[m_ChunkIndex] + m_UnderlyingStreamOffset;
-                byte[] compressedData = new byte[m_ChunkSizes[m_ChunkIndex]];
+                byte[] compressedData = new byte[ChunkLength(m_ChunkSizes[m_ChunkIndex])];
                 m_UnderlyingStream.Read(compressedData, 0, compressedData.Length);
                 bool lastChunk = m_ChunkIndex == m_ChunkOffsets.Length - 1;
                 m_CurrentChunkSize = lastChunk ? m_LastChunkSize : m_ChunkSize;
-                RefillBuffer(compressedData, m_ChunkBuffer, m_CurrentChunkSize, lastChunk);
+                if (IsStoredChunk(m_ChunkSizes[m_ChunkIndex]))
+                    Array.Copy(compressedData, m_ChunkBuffer, m_CurrentChunkSize);
+                else
+                    RefillBuffer(compressedData, m_ChunkBuffer, m_CurrentChunkSize, lastChunk);
             }
         }
 
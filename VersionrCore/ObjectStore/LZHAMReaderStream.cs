@@ -6,6 +6,27 @@ using System.Threading.Tasks;
 
 namespace Versionr.ObjectStore
 {
+    // Mirrors DecompressionParams in lzhamwrapper. Must agree with the parameters the data was compressed with.
+    [System.Runtime.InteropServices.StructLayout(System.Runtime.InteropServices.LayoutKind.Sequential)]
+    public struct LZHAMDecompressionParams
+    {
+        public int DictionaryBits;
+        public uint TableUpdateRate;
+        public uint DecompressFlags;
+        public uint TableMaxUpdateInterval;
+        public uint TableUpdateIntervalSlowRate;
+        public uint SeedSize;
+        public IntPtr SeedBytes;
+
+        public static LZHAMDecompressionParams Default
+        {
+            get
+            {
+                return new LZHAMDecompressionParams() { DictionaryBits = 23 };
+            }
+        }
+    }
+
     public class LZHAMReaderStream : ChunkedDecompressionStream
     {
         static System.Collections.Concurrent.ConcurrentBag<IntPtr> s_Decompressors = new System.Collections.Concurrent.ConcurrentBag<IntPtr>();
@@ -14,6 +35,13 @@ namespace Versionr.ObjectStore
         [System.Runtime.InteropServices.DllImport("lzhamwrapper", EntryPoint = "CreateDecompressionStream", CallingConvention = System.Runtime.InteropServices.CallingConvention.Cdecl)]
         private static extern IntPtr CreateDecompressionStream(int windowBits);
 
+        [System.Runtime.InteropServices.DllImport("lzhamwrapper", EntryPoint = "CreateDecompressionStreamEx", CallingConvention = System.Runtime.InteropServices.CallingConvention.Cdecl)]
+        private static extern IntPtr CreateDecompressionStreamEx(ref LZHAMDecompressionParams parameters);
+
+        [System.Runtime.InteropServices.DllImport("lzhamwrapper", EntryPoint = "ReinitDecompressionStreamEx", CallingConvention = System.Runtime.InteropServices.CallingConvention.Cdecl)]
+        [return: System.Runtime.InteropServices.MarshalAs(System.Runtime.InteropServices.UnmanagedType.I1)]
+        private static extern bool ReinitDecompressionStreamEx(IntPtr stream, ref LZHAMDecompressionParams parameters);
+
         [System.Runtime.InteropServices.DllImport("lzhamwrapper", EntryPoint = "ResetDecompressionStream", CallingConvention = System.Runtime.InteropServices.CallingConvention.Cdecl)]
         private static extern IntPtr ResetDecompressionStream(IntPtr stream);
 
@@ -26,21 +54,92 @@ namespace Versionr.ObjectStore
         [System.Runtime.InteropServices.DllImport("lzhamwrapper", EntryPoint = "DecompressSetSource", CallingConvention = System.Runtime.InteropServices.CallingConvention.Cdecl)]
         private static extern int DecompressSetSource(IntPtr stream, IntPtr output, int outLength);
 
+        [System.Runtime.InteropServices.DllImport("lzhamwrapper", EntryPoint = "DecompressChunks", CallingConvention = System.Runtime.InteropServices.CallingConvention.Cdecl)]
+        [return: System.Runtime.InteropServices.MarshalAs(System.Runtime.InteropServices.UnmanagedType.I1)]
+        private static extern bool DecompressChunks(ref LZHAMDecompressionParams parameters, byte[] input, uint[] compressedSizes, int chunkCount, int chunkSize, byte[] output, int outputLength, int threads);
+
+        [System.Runtime.InteropServices.DllImport("lzhamwrapper", EntryPoint = "DecompressFile", CallingConvention = System.Runtime.InteropServices.CallingConvention.Cdecl)]
+        [return: System.Runtime.InteropServices.MarshalAs(System.Runtime.InteropServices.UnmanagedType.I1)]
+        private static extern bool DecompressFile(ref LZHAMDecompressionParams parameters, IntPtr inFile, long inOffset, long length, IntPtr outFile, long outOffset, int threads);
+
+        [System.Runtime.InteropServices.DllImport("lzhamwrapper", EntryPoint = "DecompressFileSeeded", CallingConvention = System.Runtime.InteropServices.CallingConvention.Cdecl)]
+        [return: System.Runtime.InteropServices.MarshalAs(System.Runtime.InteropServices.UnmanagedType.I1)]
+        private static extern bool DecompressFileSeeded(ref LZHAMDecompressionParams parameters, IntPtr inFile, long inOffset, long length, IntPtr baseFile, long baseOffset, long baseLength, IntPtr outFile, long outOffset, int threads);
+
+        [System.Runtime.InteropServices.DllImport("lzhamwrapper", EntryPoint = "GetSeedWindow", CallingConvention = System.Runtime.InteropServices.CallingConvention.Cdecl)]
+        private static extern void GetSeedWindow(long chunkOffset, int chunkSize, long baseLength, int dictionaryBits, out long seedOffset, out long seedLength);
+
         byte[] m_DecompressionBuffer = null;
+        LZHAMDecompressionParams? m_Params;
+        System.IO.Stream m_SeedStream;
+        byte[] m_SeedBuffer;
+        System.Runtime.InteropServices.GCHandle m_DictionaryHandle;
+
+        IntPtr CreateDecompressor()
+        {
+            if (m_Params.HasValue)
+            {
+                LZHAMDecompressionParams parameters = m_Params.Value;
+                return CreateDecompressionStreamEx(ref parameters);
+            }
+            return CreateDecompressionStream(WindowBits);
+        }
+
+        // Reads the window of the seed data that the current chunk was compressed against.
+        int LoadSeed()
+        {
+            long seedOffset, seedLength;
+            GetSeedWindow((long)CurrentChunk * ChunkSize, ChunkSize, m_SeedStream.Length, m_Params.Value.DictionaryBits, out seedOffset, out seedLength);
+            if (m_SeedBuffer == null || m_SeedBuffer.Length < seedLength)
+                m_SeedBuffer = new byte[seedLength];
+            m_SeedStream.Position = seedOffset;
+            int read = 0;
+            while (read < seedLength)
+            {
+                int count = m_SeedStream.Read(m_SeedBuffer, read, (int)seedLength - read);
+                if (count <= 0)
+                    throw new System.IO.EndOfStreamException();
+                read += count;
+            }
+            return (int)seedLength;
+        }
         protected override void RefillBuffer(byte[] data, byte[] output, int decompressedSize, bool end)
         {
 			unsafe
 			{
+				int seedLength = m_SeedStream != null ? LoadSeed() : 0;
 				fixed (byte* input = data)
 				fixed (byte* outptr = output)
+				fixed (byte* seedptr = m_SeedBuffer)
 				{
+					if (m_SeedStream != null)
+					{
+						LZHAMDecompressionParams parameters = m_Params.Value;
+						parameters.SeedSize = (uint)seedLength;
+						parameters.SeedBytes = (IntPtr)seedptr;
+						if (!ReinitDecompressionStreamEx(m_Decompressor, ref parameters))
+							throw new Exception("Corrupt LZHAM chunk.");
+					}
 					m_DecompressionBuffer = data;
 					DecompressSetSource(m_Decompressor, (IntPtr)input, data.Length);
 					bool finished;
+					if (IndependentChunks)
+					{
+						// Each chunk is a complete stream, so the decompressor is reset afterwards and any chunk can be read next.
+						int result = DecompressData(m_Decompressor, (IntPtr)outptr, decompressedSize, out finished);
+						int trailer = 0;
+						while (!finished && trailer >= 0)
+							trailer = DecompressData(m_Decompressor, (IntPtr)outptr, 0, out finished);
+						IntPtr decompressor = ResetDecompressionStream(m_Decompressor);
+						m_Decompressor = decompressor != IntPtr.Zero ? decompressor : CreateDecompressor();
+						if (result != decompressedSize && result != -decompressedSize)
+							throw new Exception("Corrupt LZHAM chunk.");
+						return;
+					}
 					while (DecompressData(m_Decompressor, (IntPtr)outptr, decompressedSize, out finished) != decompressedSize)
 					{
 						DestroyDecompressionStream(m_Decompressor);
-						m_Decompressor = CreateDecompressionStream(WindowBits);
+						m_Decompressor = CreateDecompressor();
 						DecompressSetSource(m_Decompressor, (IntPtr)input, data.Length);
 					}
 					while (!finished)
@@ -51,6 +150,51 @@ namespace Versionr.ObjectStore
 
         protected const int WindowBits = 23;
 
+        // Caps how many chunks DecompressTo decodes at once.
+        const int MaxParallelChunks = 8;
+
+        // Writes the rest of the object to outputStream. Independently compressed chunks are decoded in parallel.
+        public void DecompressTo(System.IO.Stream outputStream)
+        {
+            if (!IndependentChunks)
+            {
+                CopyTo(outputStream);
+                return;
+            }
+            LZHAMDecompressionParams parameters = m_Params ?? LZHAMDecompressionParams.Default;
+            System.IO.FileStream inputFile = UnderlyingStream as System.IO.FileStream;
+            System.IO.FileStream outputFile = outputStream as System.IO.FileStream;
+            System.IO.FileStream seedFile = m_SeedStream as System.IO.FileStream;
+            if (inputFile != null && outputFile != null && Position == 0 && (m_SeedStream == null || seedFile != null))
+            {
+                // File to file: let the wrapper read, decode and write without any managed buffers.
+                outputFile.Flush();
+                long outOffset = outputFile.Position;
+                bool decoded;
+                if (seedFile != null)
+                    decoded = DecompressFileSeeded(ref parameters, inputFile.SafeFileHandle.DangerousGetHandle(), ContainerOffset, Length, seedFile.SafeFileHandle.DangerousGetHandle(), 0, seedFile.Length, outputFile.SafeFileHandle.DangerousGetHandle(), outOffset, -1);
+                else
+                    decoded = DecompressFile(ref parameters, inputFile.SafeFileHandle.DangerousGetHandle(), ContainerOffset, Length, outputFile.SafeFileHandle.DangerousGetHandle(), outOffset, -1);
+                if (decoded)
+                {
+                    outputFile.Position = outOffset + Length;
+                    SkipToEnd();
+                    return;
+                }
+            }
+            if (m_SeedStream != null)
+            {
+                CopyTo(outputStream);
+                return;
+            }
+            DecompressChunksTo(outputStream, System.Math.Min(Environment.ProcessorCount, MaxParallelChunks),
+                (byte[] data, uint[] sizes, int count, byte[] output, int length) =>
+                {
+                    if (!DecompressChunks(ref parameters, data, sizes, count, ChunkSize, output, length, count))
+                        throw new Exception("Corrupt LZHAM chunk.");
+                });
+        }
+
         protected LZHAMReaderStream(long size, int chunkSize, System.IO.Stream baseStream)
             : base(size, chunkSize, baseStream)
         {
@@ -61,16 +205,39 @@ namespace Versionr.ObjectStore
             Reset();
         }
 
+        protected LZHAMReaderStream(long size, int chunkSize, System.IO.Stream baseStream, LZHAMDecompressionParams parameters)
+            : this(size, chunkSize, baseStream, parameters, null)
+        {
+        }
+
+        protected LZHAMReaderStream(long size, int chunkSize, System.IO.Stream baseStream, LZHAMDecompressionParams parameters, System.IO.Stream seedStream)
+            : base(size, chunkSize, baseStream)
+        {
+            m_Params = parameters;
+            m_SeedStream = seedStream;
+            m_Decompressor = CreateDecompressor();
+            if (m_Decompressor == IntPtr.Zero)
+                throw new ArgumentException("Invalid LZHAM decompression parameters.");
+            Reset();
+        }
+
         protected override void Dispose(bool disposing)
         {
             if (disposing)
             {
             }
             IntPtr decompressor = m_Decompressor;
-            decompressor = ResetDecompressionStream(decompressor);
-            if (decompressor != null)
-                s_Decompressors.Add(decompressor);
+            if (m_Params.HasValue)
+                DestroyDecompressionStream(decompressor);
+            else
+            {
+                decompressor = ResetDecompressionStream(decompressor);
+                if (decompressor != null)
+                    s_Decompressors.Add(decompressor);
+            }
             m_Decompressor = IntPtr.Zero;
+            if (m_DictionaryHandle.IsAllocated)
+                m_DictionaryHandle.Free();
             base.Dispose(disposing);
         }
 
@@ -107,5 +274,82 @@ namespace Versionr.ObjectStore
                 return stream;
             return new LZHAMReaderStream(fileSize, chunkSize, baseStream);
         }
+
+        // Opens a stream written with non-default LZHAMCompressionParams. The pooled decompressors are left untouched.
+        public static System.IO.Stream OpenStream(long fileSize, System.IO.Stream baseStream, LZHAMDecompressionParams parameters)
+        {
+            int chunkSize;
+            var stream = ChunkedDecompressionStream.OpenStreamFast(fileSize, baseStream, out chunkSize,
+                (byte[] data, int offset, int length, int outsize) =>
+                {
+                    IntPtr decompressor = CreateDecompressionStreamEx(ref parameters);
+                    if (decompressor == IntPtr.Zero)
+                        throw new ArgumentException("Invalid LZHAM decompression parameters.");
+
+                    byte[] output = new byte[outsize];
+                    unsafe
+                    {
+                        fixed (byte* outptr = output)
+                        fixed (byte* inptr = data)
+                        {
+                            DecompressSetSource(decompressor, (IntPtr)inptr, length);
+                            bool finished;
+                            DecompressData(decompressor, (IntPtr)outptr, outsize, out finished);
+                            if (!finished)
+                                DecompressData(decompressor, (IntPtr)outptr, 0, out finished);
+                        }
+                    }
+                    DestroyDecompressionStream(decompressor);
+                    return output;
+                });
+
+            if (stream != null)
+                return stream;
+            return new LZHAMReaderStream(fileSize, chunkSize, baseStream, parameters);
+        }
+
+        // Opens a stream written by LZHAMWriter.CompressWithDictionary. The dictionary stays pinned until the stream is disposed.
+        public static System.IO.Stream OpenDictionaryStream(long fileSize, System.IO.Stream baseStream, byte[] dictionary)
+        {
+            var handle = System.Runtime.InteropServices.GCHandle.Alloc(dictionary, System.Runtime.InteropServices.GCHandleType.Pinned);
+            try
+            {
+                LZHAMDecompressionParams parameters = LZHAMDecompressionParams.Default;
+                parameters.DictionaryBits = LZHAMWriter.SharedDictionaryBits;
+                parameters.SeedSize = (uint)dictionary.Length;
+                parameters.SeedBytes = handle.AddrOfPinnedObject();
+                var stream = OpenStream(fileSize, baseStream, parameters);
+                var reader = stream as LZHAMReaderStream;
+                if (reader == null)
+                {
+                    handle.Free();
+                    return stream;
+                }
+                reader.m_DictionaryHandle = handle;
+                return reader;
+            }
+            catch
+            {
+                handle.Free();
+                throw;
+            }
+        }
+
+        // Opens a stream written by LZHAMWriter.CompressFileSeeded. seedStream must hold exactly the data it was compressed against.
+        public static System.IO.Stream OpenSeededStream(long fileSize, System.IO.Stream baseStream, System.IO.Stream seedStream)
+        {
+            byte[] temp = new byte[4];
+            int read = 0;
+            while (read < temp.Length)
+            {
+                int count = baseStream.Read(temp, read, temp.Length - read);
+                if (count <= 0)
+                    throw new System.IO.EndOfStreamException();
+                read += count;
+            }
+            LZHAMDecompressionParams parameters = LZHAMDecompressionParams.Default;
+            parameters.DictionaryBits = LZHAMWriter.SeededDictionaryBits;
+            return new LZHAMReaderStream(fileSize, BitConverter.ToInt32(temp, 0), baseStream, parameters, seedStream);
+        }
     }
 }
@@ -6,6 +6,100 @@ using System.Threading.Tasks;
 
 namespace Versionr.ObjectStore
 {
+    // Mirrors CompressionParams in lzhamwrapper. Zero fields take the codec defaults.
+    [System.Runtime.InteropServices.StructLayout(System.Runtime.InteropServices.LayoutKind.Sequential)]
+    public struct LZHAMCompressionParams
+    {
+        public int Level;
+        public int DictionaryBits;
+        public int MaxHelperThreads;
+        public uint TableUpdateRate;
+        public uint CompressFlags;
+        public uint TableMaxUpdateInterval;
+        public uint TableUpdateIntervalSlowRate;
+        public uint SeedSize;
+        public IntPtr SeedBytes;
+
+        // CompressFlags bit for the chunked entry points: each chunk is probed and stored raw, at the fastest level or at Level,
+        // and the choice is recorded in the chunk table. Ignored for seeded data and by compression streams.
+        public const uint AdaptiveChunksFlag = 0x10000;
+
+        // LZHAM_COMP_FLAG_FAST_HASH_MATCHING: single-probe hash matching and greedy parsing instead of the level's parser. The
+        // output is an ordinary stream, so readers don't need to know.
+        public const uint FastHashMatchingFlag = 64;
+
+        public static LZHAMCompressionParams Default
+        {
+            get
+            {
+                return new LZHAMCompressionParams() { Level = 4, DictionaryBits = 23, MaxHelperThreads = -1, CompressFlags = AdaptiveChunksFlag };
+            }
+        }
+
+        // For bulk imports: several times faster than Default for a somewhat lower ratio.
+        public static LZHAMCompressionParams Fast
+        {
+            get
+            {
+                return new LZHAMCompressionParams() { Level = 0, DictionaryBits = 23, MaxHelperThreads = -1, CompressFlags = AdaptiveChunksFlag | FastHashMatchingFlag };
+            }
+        }
+    }
+
+    // Mirrors lzham_compress_stats. Times are wall clock microseconds.
+    [System.Runtime.InteropServices.StructLayout(System.Runtime.InteropServices.LayoutKind.Sequential)]
+    public struct LZHAMCompressionStats
+    {
+        public uint StructSize;
+        public uint MaxHelperThreads;
+        public ulong BytesIn;
+        public ulong BytesOut;
+        public ulong Blocks;
+        public ulong RawBlocks;
+        public ulong ParseMicroseconds;
+        public ulong ParseBusyMicroseconds;
+        public ulong HelperParseBusyMicroseconds;
+        public ulong CodingMicroseconds;
+        public ulong MatchFinderWaitMicroseconds;
+        public ulong ParseJobs;
+        public ulong HelperParseJobs;
+        public ulong Literals;
+        public ulong Matches;
+        public ulong RepMatches;
+        public ulong TotalMatchLength;
+
+        // Fraction of the helper threads' time spent on parse jobs while parsing; 0 when compression was single threaded.
+        public double HelperUtilization
+        {
+            get
+            {
+                if (MaxHelperThreads == 0 || ParseMicroseconds == 0)
+                    return 0;
+                return Math.Min(1.0, HelperParseBusyMicroseconds / ((double)ParseMicroseconds * MaxHelperThreads));
+            }
+        }
+
+        public void Add(LZHAMCompressionStats other)
+        {
+            MaxHelperThreads = Math.Max(MaxHelperThreads, other.MaxHelperThreads);
+            BytesIn += other.BytesIn;
+            BytesOut += other.BytesOut;
+            Blocks += other.Blocks;
+            RawBlocks += other.RawBlocks;
+            ParseMicroseconds += other.ParseMicroseconds;
+            ParseBusyMicroseconds += other.ParseBusyMicroseconds;
+            HelperParseBusyMicroseconds += other.HelperParseBusyMicroseconds;
+            CodingMicroseconds += other.CodingMicroseconds;
+            MatchFinderWaitMicroseconds += other.MatchFinderWaitMicroseconds;
+            ParseJobs += other.ParseJobs;
+            HelperParseJobs += other.HelperParseJobs;
+            Literals += other.Literals;
+            Matches += other.Matches;
+            RepMatches += other.RepMatches;
+            TotalMatchLength += other.TotalMatchLength;
+        }
+    }
+
     public class LZHAMWriter : ChunkedCompressionStreamWriter
     {
         IntPtr m_Compressor { get; set; }
@@ -13,6 +107,13 @@ namespace Versionr.ObjectStore
         [System.Runtime.InteropServices.DllImport("lzhamwrapper", EntryPoint = "CreateCompressionStream", CallingConvention = System.Runtime.InteropServices.CallingConvention.Cdecl)]
         private static extern IntPtr CreateCompressionStream(int level, int windowBits);
 
+        [System.Runtime.InteropServices.DllImport("lzhamwrapper", EntryPoint = "CreateCompressionStreamEx", CallingConvention = System.Runtime.InteropServices.CallingConvention.Cdecl)]
+        private static extern IntPtr CreateCompressionStreamEx(ref LZHAMCompressionParams parameters);
+
+        [System.Runtime.InteropServices.DllImport("lzhamwrapper", EntryPoint = "ReinitCompressionStreamEx", CallingConvention = System.Runtime.InteropServices.CallingConvention.Cdecl)]
+        [return: System.Runtime.InteropServices.MarshalAs(System.Runtime.InteropServices.UnmanagedType.I1)]
+        private static extern bool ReinitCompressionStreamEx(IntPtr stream, ref LZHAMCompressionParams parameters);
+
         [System.Runtime.InteropServices.DllImport("lzhamwrapper", EntryPoint = "DestroyCompressionStream", CallingConvention = System.Runtime.InteropServices.CallingConvention.Cdecl)]
         private static extern bool DestroyCompressionStream(IntPtr stream);
 
@@ -22,7 +123,91 @@ namespace Versionr.ObjectStore
         [System.Runtime.InteropServices.DllImport("lzhamwrapper", EntryPoint = "CompressData", CallingConvention = System.Runtime.InteropServices.CallingConvention.Cdecl)]
         private static extern int CompressData(IntPtr stream, byte[] input, int inLength, byte[] output, int outLength, bool flush, bool end);
 
+        [System.Runtime.InteropServices.DllImport("lzhamwrapper", EntryPoint = "CompressChunkBound", CallingConvention = System.Runtime.InteropServices.CallingConvention.Cdecl)]
+        private static extern int CompressChunkBound(int chunkSize);
+
+        [System.Runtime.InteropServices.DllImport("lzhamwrapper", EntryPoint = "CompressChunks", CallingConvention = System.Runtime.InteropServices.CallingConvention.Cdecl)]
+        [return: System.Runtime.InteropServices.MarshalAs(System.Runtime.InteropServices.UnmanagedType.I1)]
+        private static extern bool CompressChunks(ref LZHAMCompressionParams parameters, byte[] input, int inputLength, int chunkSize, byte[] output, int outputStride, uint[] compressedSizes, int threads, out LZHAMCompressionStats stats);
+
+        [System.Runtime.InteropServices.UnmanagedFunctionPointer(System.Runtime.InteropServices.CallingConvention.Cdecl)]
+        private delegate void ProgressCallback(long processed);
+
+        [System.Runtime.InteropServices.DllImport("lzhamwrapper", EntryPoint = "CompressFile", CallingConvention = System.Runtime.InteropServices.CallingConvention.Cdecl)]
+        private static extern long CompressFile(ref LZHAMCompressionParams parameters, IntPtr inFile, long inOffset, long length, IntPtr outFile, long outOffset, int chunkSize, int threads, ProgressCallback progress, out LZHAMCompressionStats stats);
+
+        [System.Runtime.InteropServices.DllImport("lzhamwrapper", EntryPoint = "CompressFileSeeded", CallingConvention = System.Runtime.InteropServices.CallingConvention.Cdecl)]
+        private static extern long CompressFileSeeded(ref LZHAMCompressionParams parameters, IntPtr inFile, long inOffset, long length, IntPtr baseFile, long baseOffset, long baseLength, IntPtr outFile, long outOffset, int chunkSize, int threads, ProgressCallback progress, out LZHAMCompressionStats stats);
+
+        [System.Runtime.InteropServices.UnmanagedFunctionPointer(System.Runtime.InteropServices.CallingConvention.Cdecl)]
+        [return: System.Runtime.InteropServices.MarshalAs(System.Runtime.InteropServices.UnmanagedType.I1)]
+        private delegate bool SeedReadCallback(long offset, IntPtr buffer, int length);
+
+        [System.Runtime.InteropServices.DllImport("lzhamwrapper", EntryPoint = "CompressFileSeededCallback", CallingConvention = System.Runtime.InteropServices.CallingConvention.Cdecl)]
+        private static extern long CompressFileSeededCallback(ref LZHAMCompressionParams parameters, IntPtr inFile, long inOffset, long length, SeedReadCallback readSeed, long baseLength, IntPtr outFile, long outOffset, int chunkSize, int threads, ProgressCallback progress, out LZHAMCompressionStats stats);
+
+        [System.Runtime.InteropServices.DllImport("lzhamwrapper", EntryPoint = "GetCompressionStats", CallingConvention = System.Runtime.InteropServices.CallingConvention.Cdecl)]
+        [return: System.Runtime.InteropServices.MarshalAs(System.Runtime.InteropServices.UnmanagedType.I1)]
+        private static extern bool GetCompressionStats(IntPtr stream, out LZHAMCompressionStats stats);
+
+        [System.Runtime.InteropServices.DllImport("lzhamwrapper", EntryPoint = "TrainDictionary", CallingConvention = System.Runtime.InteropServices.CallingConvention.Cdecl)]
+        private static extern int TrainDictionary(byte[] samples, uint[] sampleSizes, int sampleCount, byte[] dictionary, int capacity);
+
+        [System.Runtime.InteropServices.DllImport("lzhamwrapper", EntryPoint = "SetCompressionHelperThreads", CallingConvention = System.Runtime.InteropServices.CallingConvention.Cdecl)]
+        private static extern bool SetCompressionHelperThreads(int threads);
+
+        // Sizes the helper thread pool shared by all compressors (-1 = one per extra core). Fails once compressors are using it.
+        public static bool SetHelperThreadCount(int threads)
+        {
+            return SetCompressionHelperThreads(threads);
+        }
+
+        [System.Runtime.InteropServices.DllImport("lzhamwrapper", EntryPoint = "GetCodecMemoryStats", CallingConvention = System.Runtime.InteropServices.CallingConvention.Cdecl)]
+        private static extern void GetCodecMemoryStats(out long liveBytes, out long peakBytes, out long pooledBytes);
+
+        [System.Runtime.InteropServices.DllImport("lzhamwrapper", EntryPoint = "ResetCodecPeakMemory", CallingConvention = System.Runtime.InteropServices.CallingConvention.Cdecl)]
+        private static extern void ResetCodecPeakMemory();
+
+        [System.Runtime.InteropServices.DllImport("lzhamwrapper", EntryPoint = "SetCodecMemoryLimit", CallingConvention = System.Runtime.InteropServices.CallingConvention.Cdecl)]
+        private static extern void SetCodecMemoryLimit(long limit);
+
+        [System.Runtime.InteropServices.DllImport("lzhamwrapper", EntryPoint = "SetCodecPoolLimit", CallingConvention = System.Runtime.InteropServices.CallingConvention.Cdecl)]
+        private static extern void SetCodecPoolLimit(long limit);
+
+        [System.Runtime.InteropServices.DllImport("lzhamwrapper", EntryPoint = "SetCodecHugePages", CallingConvention = System.Runtime.InteropServices.CallingConvention.Cdecl)]
+        private static extern void SetCodecHugePages([System.Runtime.InteropServices.MarshalAs(System.Runtime.InteropServices.UnmanagedType.I1)] bool enable);
+
+        // Bytes held by LZHAM (compressors and decompressors alike), the peak since ResetPeakMemory, and freed blocks kept for reuse.
+        public static void GetMemoryStats(out long liveBytes, out long peakBytes, out long pooledBytes)
+        {
+            GetCodecMemoryStats(out liveBytes, out peakBytes, out pooledBytes);
+        }
+
+        public static void ResetPeakMemory()
+        {
+            ResetCodecPeakMemory();
+        }
+
+        // Caps the memory LZHAM may hold at once (0 = unlimited). Streams that would exceed it fail to create or to run.
+        public static void SetMemoryLimit(long bytes)
+        {
+            SetCodecMemoryLimit(bytes);
+        }
+
+        // Caps the freed codec blocks kept for reuse by later streams, releasing any excess now.
+        public static void SetPoolLimit(long bytes)
+        {
+            SetCodecPoolLimit(bytes);
+        }
+
+        // Dictionaries and match finder arrays of 2 MB and up are backed by huge pages and pre-faulted unless this is turned off.
+        public static void SetHugePages(bool enable)
+        {
+            SetCodecHugePages(enable);
+        }
+
         static System.Collections.Concurrent.ConcurrentBag<IntPtr> Compressors = new System.Collections.Concurrent.ConcurrentBag<IntPtr>();
+        bool m_Pooled = true;
 
         protected LZHAMWriter() : base()
         {
@@ -33,6 +218,24 @@ namespace Versionr.ObjectStore
             }
             m_Compressor = compressor;
         }
+        // Compressors with custom parameters are never returned to the shared pool.
+        protected LZHAMWriter(LZHAMCompressionParams parameters) : base()
+        {
+            m_Pooled = false;
+            m_Compressor = CreateCompressionStreamEx(ref parameters);
+            if (m_Compressor == IntPtr.Zero)
+                throw new ArgumentException("Invalid LZHAM compression parameters.");
+        }
+        // Codec statistics for everything written through this writer's stream.
+        public LZHAMCompressionStats Statistics
+        {
+            get
+            {
+                LZHAMCompressionStats stats;
+                GetCompressionStats(m_Compressor, out stats);
+                return stats;
+            }
+        }
         protected override void CompressData(byte[] inputData, byte[] outputData, int available, out uint blockSize, bool end)
         {
             var result = CompressData(m_Compressor, inputData, available, outputData, outputData.Length, true, false);
@@ -43,7 +246,9 @@ namespace Versionr.ObjectStore
         protected override void Dispose(bool disposing)
         {
             base.Dispose(disposing);
-            if (m_Compressor != IntPtr.Zero)
+            if (m_Compressor != IntPtr.Zero && !m_Pooled)
+                DestroyCompressionStream(m_Compressor);
+            else if (m_Compressor != IntPtr.Zero)
             {
                 try
                 {
@@ -58,12 +263,244 @@ namespace Versionr.ObjectStore
             }
             m_Compressor = IntPtr.Zero;
         }
+        // Caps the chunks held in memory at once by the parallel path (input plus worst case output per chunk).
+        const int MaxParallelChunks = 8;
+
+        // Compresses every chunk as its own stream, several at a time, writing the usual chunk table with IndependentChunksFlag set.
+        static void CompressChunksToStream(LZHAMCompressionParams parameters, long fileLength, int chunkSize, out long resultSize, System.IO.Stream inputData, System.IO.Stream outputData, Action<long, long, long> feedback)
+        {
+            if (!outputData.CanSeek)
+                throw new Exception();
+            long baseOutputPos = outputData.Position;
+
+            long chunkCount = (fileLength + chunkSize - 1) / chunkSize;
+            if (chunkCount > int.MaxValue)
+                throw new Exception("File is too big!");
+            int batchChunks = (int)Math.Min(chunkCount, Math.Min(Environment.ProcessorCount, MaxParallelChunks));
+            int stride = CompressChunkBound(chunkSize);
+            byte[] chunkBuffer = new byte[batchChunks * chunkSize];
+            byte[] outBuffer = new byte[batchChunks * stride];
+            uint[] batchSizes = new uint[batchChunks];
+            List<uint> sizes = new List<uint>();
+
+            outputData.Seek(baseOutputPos + chunkCount * 4 + 4, System.IO.SeekOrigin.Begin);
+            resultSize = chunkCount * 4 + 4;
+
+            long remainder = fileLength;
+            while (remainder > 0)
+            {
+                if (feedback != null)
+                    feedback(fileLength, fileLength - remainder, resultSize);
+                int available = (int)Math.Min(remainder, (long)batchChunks * chunkSize);
+                int read = 0;
+                while (read < available)
+                {
+                    int count = inputData.Read(chunkBuffer, read, available - read);
+                    if (count <= 0)
+                        throw new System.IO.EndOfStreamException();
+                    read += count;
+                }
+                remainder -= available;
+                LZHAMCompressionStats stats;
+                if (!CompressChunks(ref parameters, chunkBuffer, available, chunkSize, outBuffer, stride, batchSizes, batchChunks, out stats))
+                    throw new Exception();
+
+                int chunks = (available + chunkSize - 1) / chunkSize;
+                for (int i = 0; i < chunks; i++)
+                {
+                    uint length = ChunkedDecompressionStream.ChunkLength(batchSizes[i]);
+                    resultSize += length;
+                    sizes.Add(batchSizes[i]);
+                    outputData.Write(outBuffer, i * stride, (int)length);
+                }
+            }
+            long finalpos = outputData.Position;
+            outputData.Seek(baseOutputPos, System.IO.SeekOrigin.Begin);
+            outputData.Write(BitConverter.GetBytes(chunkSize | ChunkedDecompressionStream.IndependentChunksFlag), 0, 4);
+            foreach (var x in sizes)
+            {
+                outputData.Write(BitConverter.GetBytes(x), 0, 4);
+            }
+            outputData.Seek(finalpos, System.IO.SeekOrigin.Begin);
+        }
+        // Compresses fileLength bytes from the current position of inputData to outputData entirely in the wrapper, bypassing managed chunk buffers.
+        public static void CompressFile(long fileLength, int chunkSize, out long resultSize, System.IO.FileStream inputData, System.IO.FileStream outputData, Action<long, long, long> feedback = null)
+        {
+            LZHAMCompressionStats stats;
+            CompressFileInternal(LZHAMCompressionParams.Default, fileLength, chunkSize, out resultSize, out stats, inputData, null, outputData, feedback);
+        }
+        public static void CompressFile(long fileLength, int chunkSize, out long resultSize, out LZHAMCompressionStats stats, System.IO.FileStream inputData, System.IO.FileStream outputData, Action<long, long, long> feedback = null)
+        {
+            CompressFileInternal(LZHAMCompressionParams.Default, fileLength, chunkSize, out resultSize, out stats, inputData, null, outputData, feedback);
+        }
+        public static void CompressFile(LZHAMCompressionParams parameters, long fileLength, int chunkSize, out long resultSize, out LZHAMCompressionStats stats, System.IO.FileStream inputData, System.IO.FileStream outputData, Action<long, long, long> feedback = null)
+        {
+            CompressFileInternal(parameters, fileLength, chunkSize, out resultSize, out stats, inputData, null, outputData, feedback);
+        }
+
+        // Dictionary size for seeded containers: room for a 16 MB chunk plus a 48 MB window of the seed beside it.
+        public const int SeededDictionaryBits = 26;
+
+        // As CompressFile, but each chunk is compressed with the matching window of seedData (usually the prior revision) preloaded as a
+        // dictionary. Read the result back with LZHAMReaderStream.OpenSeededStream and the same seed data.
+        public static void CompressFileSeeded(long fileLength, int chunkSize, out long resultSize, System.IO.FileStream inputData, System.IO.FileStream seedData, System.IO.FileStream outputData, Action<long, long, long> feedback = null)
+        {
+            LZHAMCompressionStats stats;
+            CompressFileSeeded(fileLength, chunkSize, out resultSize, out stats, inputData, seedData, outputData, feedback);
+        }
+        public static void CompressFileSeeded(long fileLength, int chunkSize, out long resultSize, out LZHAMCompressionStats stats, System.IO.FileStream inputData, System.IO.FileStream seedData, System.IO.FileStream outputData, Action<long, long, long> feedback = null)
+        {
+            LZHAMCompressionParams parameters = LZHAMCompressionParams.Default;
+            parameters.DictionaryBits = SeededDictionaryBits;
+            CompressFileInternal(parameters, fileLength, chunkSize, out resultSize, out stats, inputData, seedData, outputData, feedback);
+        }
+
+        // As CompressFileSeeded, but the seed is any seekable stream, such as a decoded prior revision, so it needn't be extracted to a
+        // file first. Only the window beside each chunk is read, in pieces, under a lock on seedData.
+        public static void CompressFileSeeded(long fileLength, int chunkSize, out long resultSize, out LZHAMCompressionStats stats, System.IO.FileStream inputData, System.IO.Stream seedData, long seedLength, System.IO.FileStream outputData, Action<long, long, long> feedback = null)
+        {
+            if (!seedData.CanSeek)
+                throw new ArgumentException("Seed data must be seekable.");
+            LZHAMCompressionParams parameters = LZHAMCompressionParams.Default;
+            parameters.DictionaryBits = SeededDictionaryBits;
+            ProgressCallback progress = null;
+            if (feedback != null)
+                progress = (processed) => feedback(fileLength, processed, 0);
+            byte[] piece = new byte[1024 * 1024];
+            SeedReadCallback readSeed = (offset, buffer, length) =>
+            {
+                // Exceptions can't unwind through the wrapper, so a failed read fails the compression instead.
+                try
+                {
+                    lock (seedData)
+                    {
+                        seedData.Position = offset;
+                        int copied = 0;
+                        while (copied < length)
+                        {
+                            int count = seedData.Read(piece, 0, Math.Min(piece.Length, length - copied));
+                            if (count <= 0)
+                                return false;
+                            System.Runtime.InteropServices.Marshal.Copy(piece, 0, buffer + copied, count);
+                            copied += count;
+                        }
+                        return true;
+                    }
+                }
+                catch
+                {
+                    return false;
+                }
+            };
+            outputData.Flush();
+            long inOffset = inputData.Position;
+            long outOffset = outputData.Position;
+            resultSize = CompressFileSeededCallback(ref parameters, inputData.SafeFileHandle.DangerousGetHandle(), inOffset, fileLength, readSeed, seedLength, outputData.SafeFileHandle.DangerousGetHandle(), outOffset, chunkSize, -1, progress, out stats);
+            GC.KeepAlive(readSeed);
+            GC.KeepAlive(progress);
+            if (resultSize < 0)
+                throw new Exception("LZHAM seeded compression failed.");
+            inputData.Position = inOffset + fileLength;
+            outputData.Position = outOffset + resultSize;
+        }
+
+        static void CompressFileInternal(LZHAMCompressionParams parameters, long fileLength, int chunkSize, out long resultSize, out LZHAMCompressionStats stats, System.IO.FileStream inputData, System.IO.FileStream seedData, System.IO.FileStream outputData, Action<long, long, long> feedback)
+        {
+            ProgressCallback progress = null;
+            if (feedback != null)
+                progress = (processed) => feedback(fileLength, processed, 0);
+            outputData.Flush();
+            long inOffset = inputData.Position;
+            long outOffset = outputData.Position;
+            if (seedData != null)
+                resultSize = CompressFileSeeded(ref parameters, inputData.SafeFileHandle.DangerousGetHandle(), inOffset, fileLength, seedData.SafeFileHandle.DangerousGetHandle(), 0, seedData.Length, outputData.SafeFileHandle.DangerousGetHandle(), outOffset, chunkSize, -1, progress, out stats);
+            else
+                resultSize = CompressFile(ref parameters, inputData.SafeFileHandle.DangerousGetHandle(), inOffset, fileLength, outputData.SafeFileHandle.DangerousGetHandle(), outOffset, chunkSize, -1, progress, out stats);
+            GC.KeepAlive(progress);
+            if (resultSize < 0)
+                throw new Exception("LZHAM file compression failed.");
+            inputData.Position = inOffset + fileLength;
+            outputData.Position = outOffset + resultSize;
+        }
+        // Dictionary size for data compressed against a trained shared dictionary. Small objects need little window beyond the dictionary itself.
+        public const int SharedDictionaryBits = 20;
+
+        // Largest dictionary TrainDictionary will build; it has to fit in the window with room to spare.
+        public const int MaxSharedDictionarySize = 1 << (SharedDictionaryBits - 1);
+
+        // Builds a shared dictionary of up to capacity bytes from sample objects. Returns null if the samples have too little in common.
+        public static byte[] TrainDictionary(IList<byte[]> samples, int capacity)
+        {
+            capacity = Math.Min(capacity, MaxSharedDictionarySize);
+            long total = samples.Sum(x => (long)x.Length);
+            if (total > int.MaxValue)
+                throw new ArgumentException("Too much sample data.");
+            byte[] sampleData = new byte[total];
+            uint[] sampleSizes = new uint[samples.Count];
+            int offset = 0;
+            for (int i = 0; i < samples.Count; i++)
+            {
+                Buffer.BlockCopy(samples[i], 0, sampleData, offset, samples[i].Length);
+                sampleSizes[i] = (uint)samples[i].Length;
+                offset += samples[i].Length;
+            }
+            byte[] dictionary = new byte[capacity];
+            int length = TrainDictionary(sampleData, sampleSizes, samples.Count, dictionary, capacity);
+            if (length == 0)
+                return null;
+            Array.Resize(ref dictionary, length);
+            return dictionary;
+        }
+
+        // Compresses with a shared dictionary preloaded as the seed. Read it back with LZHAMReaderStream.OpenDictionaryStream and the same dictionary.
+        public static void CompressWithDictionary(long fileLength, int chunkSize, out long resultSize, System.IO.Stream inputData, System.IO.Stream outputData, byte[] dictionary, Action<long, long, long> feedback = null)
+        {
+            var handle = System.Runtime.InteropServices.GCHandle.Alloc(dictionary, System.Runtime.InteropServices.GCHandleType.Pinned);
+            try
+            {
+                LZHAMCompressionParams parameters = LZHAMCompressionParams.Default;
+                parameters.DictionaryBits = SharedDictionaryBits;
+                parameters.SeedSize = (uint)dictionary.Length;
+                parameters.SeedBytes = handle.AddrOfPinnedObject();
+                CompressToStream(fileLength, chunkSize, parameters, out resultSize, inputData, outputData, feedback);
+            }
+            finally
+            {
+                handle.Free();
+            }
+        }
+        // The original single-stream layout, with no independent chunks, chunk modes or seed, for readers that predate them.
+        public static void CompressToLegacyStream(long fileLength, int chunkSize, out long resultSize, System.IO.Stream inputData, System.IO.Stream outputData, Action<long, long, long> feedback = null)
+        {
+            using (LZHAMWriter writer = new LZHAMWriter())
+            {
+                writer.Run(fileLength, chunkSize, out resultSize, inputData, outputData, feedback);
+            }
+        }
         public static void CompressToStream(long fileLength, int chunkSize, out long resultSize, System.IO.Stream inputData, System.IO.Stream outputData, Action<long, long, long> feedback = null)
         {
+            if (fileLength > chunkSize)
+            {
+                CompressChunksToStream(LZHAMCompressionParams.Default, fileLength, chunkSize, out resultSize, inputData, outputData, feedback);
+                return;
+            }
             using (LZHAMWriter writer = new LZHAMWriter())
             {
                 writer.Run(fileLength, chunkSize, out resultSize, inputData, outputData, feedback);
             }
         }
+        public static void CompressToStream(long fileLength, int chunkSize, LZHAMCompressionParams parameters, out long resultSize, System.IO.Stream inputData, System.IO.Stream outputData, Action<long, long, long> feedback = null)
+        {
+            // Seeded data is always written as independent chunks, so each chunk decodes against the seed on its own.
+            if (fileLength > chunkSize || parameters.SeedSize != 0)
+            {
+                CompressChunksToStream(parameters, fileLength, chunkSize, out resultSize, inputData, outputData, feedback);
+                return;
+            }
+            using (LZHAMWriter writer = new LZHAMWriter(parameters))
+            {
+                writer.Run(fileLength, chunkSize, out resultSize, inputData, outputData, feedback);
+            }
+        }
     }
 }
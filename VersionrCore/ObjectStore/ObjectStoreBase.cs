@@ -28,7 +28,7 @@ namespace Versionr.ObjectStore
         public abstract string CreateDataStream(ObjectStoreTransaction transaction, System.IO.Stream stream);
         public abstract bool RecordData(ObjectStoreTransaction transaction, Objects.Record newRecord, Objects.Record priorRecord, Entry fileEntry);
         public abstract bool ReceiveRecordData(ObjectStoreTransaction transaction, string directName, System.IO.Stream dataStream, out string dependency);
-        public abstract bool TransmitObjectData(string dataID, Func<byte[], int, bool, bool> sender, byte[] scratchBuffer, Action beginTransmission = null);
+        public abstract bool TransmitObjectData(string dataID, Func<byte[], int, bool, bool> sender, byte[] scratchBuffer, Action beginTransmission = null, bool legacyFormat = false);
         public abstract System.IO.Stream GetRecordStream(Objects.Record record);
         public abstract System.IO.Stream GetDirectStream(string dataIdentifier);
         public abstract long GetTransmissionLength(string dataIdentifier);
@@ -54,5 +54,10 @@ namespace Versionr.ObjectStore
         public abstract void EraseData(string[] dataIdentifier);
         public abstract void BeginBulkQuery();
         public abstract void EndBulkQuery();
+        // Builds a new shared dictionary for compressing small objects. Stores without dictionary support return false.
+        public virtual bool TrainDictionary(int dictionarySize)
+        {
+            return false;
+        }
     }
 }
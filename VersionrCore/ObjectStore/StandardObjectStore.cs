@@ -1,4 +1,4 @@
-//#define SLOW_DATA_CHECK
+﻿//#define SLOW_DATA_CHECK
 
 using System;
 using System.Collections.Generic;
@@ -30,6 +30,20 @@ namespace Versionr.ObjectStore
         public HashSet<string> Cleanup = new HashSet<string>();
         public HashSet<string> Inputs = new HashSet<string>();
         public byte[] ScratchBuffer = new byte[1024 * 1024 * 16];
+        // LZHAM statistics per file extension for the records added since the last flush.
+        public Dictionary<string, LZHAMCompressionStats> CompressionStats = new Dictionary<string, LZHAMCompressionStats>();
+
+        internal void AddCompressionStats(FileInfo file, LZHAMCompressionStats stats)
+        {
+            string extension = string.IsNullOrEmpty(file.Extension) ? "(none)" : file.Extension.ToLowerInvariant();
+            lock (CompressionStats)
+            {
+                LZHAMCompressionStats total;
+                CompressionStats.TryGetValue(extension, out total);
+                total.Add(stats);
+                CompressionStats[extension] = total;
+            }
+        }
 
         internal long m_PendingBytes;
         internal int m_PendingCount;
@@ -89,6 +103,12 @@ namespace Versionr.ObjectStore
         public int Id { get; set; }
         public int Version { get; set; }
     }
+    public class CompressionDictionary
+    {
+        [SQLite.PrimaryKey, SQLite.AutoIncrement]
+        public long Id { get; set; }
+        public string Lookup { get; set; }
+    }
     public enum CompressionMode
     {
         None = 0,
@@ -104,6 +124,23 @@ namespace Versionr.ObjectStore
 
         long MinimumLooseFileSize = 16 * 1024;
 
+        // Set in the codec word of a delta record whose payload is the whole file compressed against its base as a seed dictionary.
+        const int SeededDeltaFlag = 0x4000;
+
+        // Seeded deltas are only attempted when the base's signature leaves less than this fraction of the file unmatched, or, for
+        // bases without a signature, when the file is small.
+        const long SeededDeltaUnmatchedFraction = 4;
+        const long MaxUnsignedSeededDeltaSize = 1024 * 1024;
+
+        // Set in the codec word of a flat record compressed against a shared dictionary. The dictionary lookup follows the size.
+        const int DictionaryFlag = 0x2000;
+
+        // Upper bound on the small objects read to train a dictionary.
+        const long MaxDictionarySampleBytes = 16 * 1024 * 1024;
+
+        CompressionDictionary ActiveDictionary { get; set; }
+        Dictionary<string, byte[]> LoadedDictionaries = new Dictionary<string, byte[]>();
+
         System.IO.DirectoryInfo DataFolder
         {
             get
@@ -150,6 +187,7 @@ namespace Versionr.ObjectStore
         }
 
         public CompressionMode DefaultCompression { get; set; }
+        LZHAMCompressionParams LZHAMParameters { get; set; }
 
         public override void BeginBulkQuery()
         {
@@ -182,14 +220,22 @@ namespace Versionr.ObjectStore
                     cmode = CompressionMode.LZHAM;
             }
             DefaultCompression = cmode;
+            if (Owner.Directives != null && Owner.Directives.CodecMemoryLimit.HasValue)
+                LZHAMWriter.SetMemoryLimit(Owner.Directives.CodecMemoryLimit.Value * 1024 * 1024);
+            LZHAMParameters = LZHAMCompressionParams.Default;
+            if (Owner.Directives != null && Owner.Directives.FastCompression == true)
+                LZHAMParameters = LZHAMCompressionParams.Fast;
 
             ObjectDatabase.EnableWAL = true;
             ObjectDatabase.BeginTransaction();
             ObjectDatabase.CreateTable<FileObjectStoreData>();
             ObjectDatabase.CreateTable<PackfileObject>();
             ObjectDatabase.CreateTable<StandardObjectStoreMetadata>();
+            ObjectDatabase.CreateTable<CompressionDictionary>();
             ObjectDatabase.Commit();
 
+            ActiveDictionary = ObjectDatabase.Query<CompressionDictionary>("SELECT * FROM CompressionDictionary ORDER BY Id DESC LIMIT 1").FirstOrDefault();
+
             BlobDatabase.EnableWAL = true;
             BlobDatabase.BeginTransaction();
             BlobDatabase.CreateTable<Blobject>();
@@ -423,14 +469,14 @@ namespace Versionr.ObjectStore
                     {
                         if (priorData.Mode == StorageMode.Delta)
                             priorData = ObjectDatabase.Find<FileObjectStoreData>(x => x.Lookup == priorData.DeltaBase);
+                        long deltaSize = size;
+                        List<ChunkedChecksum.FileBlock> blocks = null;
                         if (priorData != null && priorData.HasSignatureData)
                         {
                             try
                             {
                                 var signature = LoadSignature(priorData);
-                                long deltaSize;
-                                List<ChunkedChecksum.FileBlock> blocks;
-                                Printer.PrintDiagnostics(" - Trying delta encoding");
+                                Printer.PrintDiagnostics(" - Computing delta");
                                 Printer.InteractivePrinter printer = null;
                                 if (size > 16 * 1024 * 1024)
                                     printer = Printer.CreateSimplePrinter(" Computing Delta", (obj) => { return string.Format("{0:N1}%", (float)((long)obj / (double)size) * 100.0f); });
@@ -439,10 +485,24 @@ namespace Versionr.ObjectStore
                                     blocks = ChunkedChecksum.ComputeDelta(fileInput, size, signature, out deltaSize, (fs, ps) => { if (ps % (512 * 1024) == 0 && printer != null) printer.Update(ps); });
                                 }
                                 if (printer != null)
-                                {
                                     printer.End(size);
-                                    printer = null;
-                                }
+                            }
+                            catch
+                            {
+                                blocks = null;
+                                deltaSize = size;
+                            }
+                        }
+                        // A seeded attempt costs a whole compression, so it's only made when the signature already matches most of
+                        // the file, or when the file is too small for a wasted attempt to matter.
+                        bool trySeeded = blocks != null ? deltaSize < size / SeededDeltaUnmatchedFraction : size <= MaxUnsignedSeededDeltaSize;
+                        if (priorData != null && trySeeded && DefaultCompression == CompressionMode.LZHAM && size >= MinimumLooseFileSize && CreateSeededDelta(trans, inFile, size, dataIdentifier, priorData, filename, fn))
+                            return true;
+                        if (blocks != null)
+                        {
+                            try
+                            {
+                                Printer.InteractivePrinter printer = null;
                                 // dont encode as delta unless we get a 50% saving
                                 if (deltaSize < size / 2)
                                 {
@@ -533,20 +593,34 @@ namespace Versionr.ObjectStore
                     Mode = StorageMode.Flat,
                     Offset = 0
                 };
+                byte[] dictionary = null;
+                if (DefaultCompression == CompressionMode.LZHAM && ActiveDictionary != null && size > 0 && size < MinimumLooseFileSize && !computeSignature)
+                {
+                    dictionary = LoadDictionary(ActiveDictionary.Lookup);
+                    storeData.DeltaBase = ActiveDictionary.Lookup;
+                }
                 using (var fileInput = inFile.OpenRead())
                 using (var fileOutput = new FileInfo(fn).OpenWrite())
                 {
                     fileOutput.Write(new byte[] { (byte)'d', (byte)'b', (byte)'l', (byte)'k' }, 0, 4);
                     CompressionMode cmode = DefaultCompression;
-                    if (cmode != CompressionMode.None && size < 16 * 1024)
+                    if (cmode != CompressionMode.None && size < 16 * 1024 && dictionary == null)
                         cmode = CompressionMode.LZ4;
-                    if (cmode != CompressionMode.None && size < 1024)
+                    if (cmode != CompressionMode.None && size < 1024 && dictionary == null)
                         cmode = CompressionMode.None;
                     int sig = (int)cmode;
                     if (computeSignature)
                         sig |= 0x8000;
+                    if (dictionary != null)
+                        sig |= DictionaryFlag;
                     fileOutput.Write(BitConverter.GetBytes(sig), 0, 4);
                     fileOutput.Write(BitConverter.GetBytes(size), 0, 8);
+                    if (dictionary != null)
+                    {
+                        fileOutput.Write(BitConverter.GetBytes(storeData.DeltaBase.Length), 0, 4);
+                        byte[] lookupBytes = ASCIIEncoding.ASCII.GetBytes(storeData.DeltaBase);
+                        fileOutput.Write(lookupBytes, 0, lookupBytes.Length);
+                    }
                     Printer.InteractivePrinter printer = null;
                     if (size > 16 * 1024 * 1024)
                         printer = Printer.CreateSimplePrinter(" Computing Signature", (obj) => { return string.Format("{0:N1}%", (float)((long)obj / (double)size) * 100.0f); });
@@ -571,8 +645,14 @@ namespace Versionr.ObjectStore
                         },
                         (obj, lol) => { return string.Empty; }, 40);
                     }
-                    if (cmode == CompressionMode.LZHAM)
-                        LZHAMWriter.CompressToStream(size, 16 * 1024 * 1024, out resultSize, fileInput, fileOutput, (fs, ps, cs) => { if (printer != null) printer.Update(ps); });
+                    if (dictionary != null)
+                        LZHAMWriter.CompressWithDictionary(size, 16 * 1024 * 1024, out resultSize, fileInput, fileOutput, dictionary);
+                    else if (cmode == CompressionMode.LZHAM)
+                    {
+                        LZHAMCompressionStats stats;
+                        LZHAMWriter.CompressFile(LZHAMParameters, size, 16 * 1024 * 1024, out resultSize, out stats, fileInput, fileOutput, (fs, ps, cs) => { if (printer != null) printer.Update(ps); });
+                        trans.AddCompressionStats(inFile, stats);
+                    }
                     else if (cmode == CompressionMode.LZ4)
                         LZ4Writer.CompressToStream(size, 16 * 1024 * 1024, out resultSize, fileInput, fileOutput, (fs, ps, cs) => { if (printer != null) printer.Update(ps); });
                     else if (cmode == CompressionMode.LZ4HC)
@@ -585,7 +665,7 @@ namespace Versionr.ObjectStore
                     if (printer != null)
                         printer.End(size);
                 }
-                Printer.PrintMessage(" - Compressed: {1} => {2}{3}", "", Misc.FormatSizeFriendly(size), Misc.FormatSizeFriendly(resultSize), computeSignature ? " (computed signatures)" : "");
+                Printer.PrintMessage(" - Compressed: {1} => {2}{3}", "", Misc.FormatSizeFriendly(size), Misc.FormatSizeFriendly(resultSize), computeSignature ? " (computed signatures)" : (dictionary != null ? " (shared dictionary)" : ""));
                 trans.PendingTransactions.Add(
                     new StandardObjectStoreTransaction.PendingTransaction()
                     {
@@ -597,6 +677,62 @@ namespace Versionr.ObjectStore
             }
         }
 
+        private bool CreateSeededDelta(StandardObjectStoreTransaction trans, FileInfo inFile, long size, string dataIdentifier, FileObjectStoreData priorData, string filename, string fn)
+        {
+            try
+            {
+                Printer.PrintDiagnostics(" - Trying seeded delta encoding");
+                long resultSize;
+                LZHAMCompressionStats stats;
+                using (var seedInput = GetStreamForLookup(priorData.Lookup))
+                {
+                    if (!seedInput.CanSeek)
+                        return false;
+                    using (var fileInput = inFile.OpenRead())
+                    using (var fileOutput = new FileInfo(fn).Create())
+                    {
+                        fileOutput.Write(new byte[] { (byte)'d', (byte)'b', (byte)'l', (byte)'x' }, 0, 4);
+                        fileOutput.Write(BitConverter.GetBytes((int)CompressionMode.LZHAM | SeededDeltaFlag), 0, 4);
+                        fileOutput.Write(BitConverter.GetBytes(size), 0, 8);
+                        fileOutput.Write(BitConverter.GetBytes(size), 0, 8);
+                        fileOutput.Write(BitConverter.GetBytes(priorData.Lookup.Length), 0, 4);
+                        byte[] lookupBytes = ASCIIEncoding.ASCII.GetBytes(priorData.Lookup);
+                        fileOutput.Write(lookupBytes, 0, lookupBytes.Length);
+                        LZHAMWriter.CompressFileSeeded(size, 16 * 1024 * 1024, out resultSize, out stats, fileInput, seedInput, seedInput.Length, fileOutput);
+                    }
+                }
+                // only worth a dependency on the base if the seed did most of the work
+                if (resultSize >= size / 10)
+                {
+                    new FileInfo(fn).Delete();
+                    return false;
+                }
+                trans.AddCompressionStats(inFile, stats);
+                Printer.PrintMessage(" - Compressed: {0} (seeded delta) => {1}", Misc.FormatSizeFriendly(size), Misc.FormatSizeFriendly(resultSize));
+                trans.PendingTransactions.Add(
+                    new StandardObjectStoreTransaction.PendingTransaction()
+                    {
+                        Data = new FileObjectStoreData()
+                        {
+                            FileSize = size,
+                            HasSignatureData = false,
+                            Lookup = dataIdentifier,
+                            Mode = StorageMode.Delta,
+                            DeltaBase = priorData.Lookup,
+                            Offset = 0
+                        },
+                        Filename = filename
+                    }
+                );
+                return true;
+            }
+            catch
+            {
+                new FileInfo(fn).Delete();
+                return false;
+            }
+        }
+
         public override bool RecordData(ObjectStoreTransaction transaction, Record newRecord, Record priorRecord, Entry fileEntry)
         {
             return CreateDataStreamInternal(transaction, new FileInfo(fileEntry.FullName), fileEntry.Length, GetLookup(newRecord), priorRecord != null ? GetLookup(priorRecord) : null);
@@ -625,6 +761,8 @@ namespace Versionr.ObjectStore
             int data = BitConverter.ToInt32(buffer, 4);
             stream.Read(buffer, 0, 8);
             long length = BitConverter.ToInt64(buffer, 0);
+            if ((data & DictionaryFlag) != 0)
+                ReadDictionaryLookup(stream);
             if (((uint)data & 0x8000) != 0)
                 return ChunkedChecksum.Load(length, stream);
             else
@@ -680,11 +818,22 @@ namespace Versionr.ObjectStore
                         fileOutput.Write(sig, 0, 4);
                         dataStream.Read(sig, 0, 4);
                         fileOutput.Write(sig, 0, 4);
-                        if ((BitConverter.ToUInt32(sig, 0) & 0x8000) != 0)
+                        int codec = BitConverter.ToInt32(sig, 0);
+                        if ((codec & 0x8000) != 0)
                             data.HasSignatureData = true;
                         dataStream.Read(sig, 0, 8);
                         fileOutput.Write(sig, 0, 8);
                         data.FileSize = BitConverter.ToInt64(sig, 0);
+                        if ((codec & DictionaryFlag) != 0)
+                        {
+                            string dictionaryLookup = ReadDictionaryLookup(dataStream);
+                            fileOutput.Write(BitConverter.GetBytes(dictionaryLookup.Length), 0, 4);
+                            byte[] lookupBytes = ASCIIEncoding.ASCII.GetBytes(dictionaryLookup);
+                            fileOutput.Write(lookupBytes, 0, lookupBytes.Length);
+
+                            dependency = dictionaryLookup;
+                            data.DeltaBase = dictionaryLookup;
+                        }
                     }
                     else if (sig[0] == 'd' && sig[1] == 'b' && sig[2] == 'l' && sig[3] == 'x')
                     {
@@ -1037,6 +1186,7 @@ namespace Versionr.ObjectStore
                         ObjectDatabase.Commit();
                         transaction.m_PendingBytes = 0;
                         transaction.m_PendingCount = 0;
+                        PrintCompressionStats(transaction);
                     }
                     catch
                     {
@@ -1057,6 +1207,26 @@ namespace Versionr.ObjectStore
             return true;
         }
 
+        private void PrintCompressionStats(StandardObjectStoreTransaction transaction)
+        {
+            lock (transaction.CompressionStats)
+            {
+                if (transaction.CompressionStats.Count == 0)
+                    return;
+                Printer.PrintDiagnostics("LZHAM compression by file type:");
+                foreach (var x in transaction.CompressionStats.OrderByDescending(x => x.Value.BytesIn))
+                {
+                    var stats = x.Value;
+                    Printer.PrintDiagnostics(" - {0}: {1} => {2} ({3:N1}%), parse {4:N0}ms, coding {5:N0}ms, match finder wait {6:N0}ms, helper use {7:N0}%, {8} matches / {9} literals",
+                        x.Key, Misc.FormatSizeFriendly((long)stats.BytesIn), Misc.FormatSizeFriendly((long)stats.BytesOut),
+                        stats.BytesIn == 0 ? 100.0 : stats.BytesOut * 100.0 / stats.BytesIn,
+                        stats.ParseMicroseconds / 1000.0, stats.CodingMicroseconds / 1000.0, stats.MatchFinderWaitMicroseconds / 1000.0,
+                        stats.HelperUtilization * 100.0, stats.Matches, stats.Literals);
+                }
+                transaction.CompressionStats.Clear();
+            }
+        }
+
         private FileInfo GetFileForDataID(string id, bool readOnly = false)
         {
             string dirname = Path.Combine(DataFolder.FullName, id.Substring(0, 2));
@@ -1097,10 +1267,10 @@ namespace Versionr.ObjectStore
             return GetFileForDataID(storeData.Lookup).Length;
         }
 
-        public override bool TransmitObjectData(string dataID, Func<byte[], int, bool, bool> sender, byte[] scratchBuffer, Action beginTransmission = null)
+        public override bool TransmitObjectData(string dataID, Func<byte[], int, bool, bool> sender, byte[] scratchBuffer, Action beginTransmission = null, bool legacyFormat = false)
         {
             long dataSize;
-            using (System.IO.Stream dataStream = GetFlatDataStream(dataID, out dataSize))
+            using (System.IO.Stream dataStream = legacyFormat ? GetLegacyFormatDataStream(dataID, out dataSize) : GetFlatDataStream(dataID, out dataSize))
             {
                 if (dataSize == 0)
                     return true;
@@ -1132,6 +1302,100 @@ namespace Versionr.ObjectStore
             }
             return OpenLegacyStreamReadOnly(storeData, out length);
         }
+
+        // As GetFlatDataStream, but records in a layout that peers before protocol 3.8 can't read are rewritten first.
+        private Stream GetLegacyFormatDataStream(string lookup, out long length)
+        {
+            var storeData = ObjectDatabase.Find<FileObjectStoreData>(lookup);
+            if (storeData == null || !RequiresLegacyConversion(storeData))
+                return GetFlatDataStream(lookup, out length);
+            return OpenLegacyFormatStream(storeData, out length);
+        }
+
+        // Independent LZHAM chunks (and the chunk modes they may carry), seeded deltas and shared dictionaries are all newer than
+        // the original record layout.
+        private bool RequiresLegacyConversion(FileObjectStoreData storeData)
+        {
+            if (storeData.Mode == StorageMode.Legacy)
+                return false;
+            using (var stream = OpenLegacyStream(storeData))
+            {
+                byte[] buffer = new byte[8];
+                stream.Read(buffer, 0, 8);
+                int codec = BitConverter.ToInt32(buffer, 4);
+                if ((codec & (SeededDeltaFlag | DictionaryFlag)) != 0)
+                    return true;
+                if ((CompressionMode)(codec & 0x0FFF) != CompressionMode.LZHAM)
+                    return false;
+                stream.Read(buffer, 0, 8);
+                if (storeData.Mode == StorageMode.Delta)
+                {
+                    stream.Read(buffer, 0, 8);
+                    stream.Read(buffer, 0, 4);
+                    stream.Seek(BitConverter.ToInt32(buffer, 0), SeekOrigin.Current);
+                }
+                else if (((uint)codec & 0x8000) != 0)
+                    ChunkedChecksum.Skip(stream);
+                stream.Read(buffer, 0, 4);
+                return (BitConverter.ToInt32(buffer, 0) & ChunkedDecompressionStream.IndependentChunksFlag) != 0;
+            }
+        }
+
+        // Rewrites a record as a flat one holding a single LZHAM stream, which needs neither a base nor a dictionary on the peer.
+        private Stream OpenLegacyFormatStream(FileObjectStoreData storeData, out long length)
+        {
+            string filename;
+            lock (this)
+            {
+                do
+                {
+                    filename = Path.GetRandomFileName();
+                } while (TempFiles.Contains(filename));
+                TempFiles.Add(filename);
+            }
+            FileInfo decodedFile = new FileInfo(Path.Combine(TempFolder.FullName, filename));
+            Stream result = null;
+            try
+            {
+                using (var decodedOutput = decodedFile.Create())
+                    WriteRecordStream(storeData, decodedOutput);
+                result = new FileStream(decodedFile.FullName + ".legacy", FileMode.Create, FileAccess.ReadWrite, FileShare.None, 4096, FileOptions.DeleteOnClose);
+                using (var fileInput = decodedFile.OpenRead())
+                {
+                    result.Write(new byte[] { (byte)'d', (byte)'b', (byte)'l', (byte)'k' }, 0, 4);
+                    bool computeSignature = storeData.FileSize > 1024 * 64;
+                    int signature = (int)CompressionMode.LZHAM;
+                    if (computeSignature)
+                        signature |= 0x8000;
+                    result.Write(BitConverter.GetBytes(signature), 0, 4);
+                    result.Write(BitConverter.GetBytes(storeData.FileSize), 0, 8);
+                    if (computeSignature)
+                    {
+                        var checksum = ChunkedChecksum.Compute(1024, fileInput);
+                        fileInput.Position = 0;
+                        ChunkedChecksum.Write(result, checksum);
+                    }
+                    long resultSize;
+                    LZHAMWriter.CompressToLegacyStream(storeData.FileSize, 16 * 1024 * 1024, out resultSize, fileInput, result);
+                }
+                Printer.PrintDiagnostics(" - Rewrote {0} in the pre-3.8 record layout", storeData.Lookup);
+                length = result.Length;
+                result.Position = 0;
+                return result;
+            }
+            catch
+            {
+                if (result != null)
+                    result.Dispose();
+                throw;
+            }
+            finally
+            {
+                decodedFile.Delete();
+                lock (this)
+                    TempFiles.Remove(filename);
+            }
+        }
         public override System.IO.Stream GetRecordStream(Objects.Record record)
         {
             string lookup = GetLookup(record);
@@ -1196,8 +1460,12 @@ namespace Versionr.ObjectStore
             {
                 Stream baseStream;
                 FileInfo tempBaseFile;
-                dataStream = OpenDeltaCodecStream(OpenLegacyStream(storeData), out baseStream, out tempBaseFile);
-                ChunkedChecksum.ApplyDelta(baseStream, dataStream, outputStream);
+                bool seeded;
+                dataStream = OpenDeltaCodecStream(OpenLegacyStream(storeData), out baseStream, out tempBaseFile, out seeded);
+                if (seeded)
+                    ((LZHAMReaderStream)dataStream).DecompressTo(outputStream);
+                else
+                    ChunkedChecksum.ApplyDelta(baseStream, dataStream, outputStream);
                 dataStream.Dispose();
                 baseStream.Dispose();
                 tempBaseFile.Delete();
@@ -1214,6 +1482,13 @@ namespace Versionr.ObjectStore
                 }
                 else
                     throw new Exception();
+                LZHAMReaderStream lzhamStream = dataStream as LZHAMReaderStream;
+                if (lzhamStream != null)
+                {
+                    lzhamStream.DecompressTo(outputStream);
+                    lzhamStream.Dispose();
+                    return;
+                }
                 Printer.InteractivePrinter printer = null;
                 long total = 0;
                 int blockSize = (int)System.Math.Min(storeData.FileSize, 16 * 1024 * 1024);
@@ -1236,7 +1511,7 @@ namespace Versionr.ObjectStore
             }
         }
 
-        private Stream OpenDeltaCodecStream(Stream stream, out Stream baseFileStream, out FileInfo tempFileName)
+        private Stream OpenDeltaCodecStream(Stream stream, out Stream baseFileStream, out FileInfo tempFileName, out bool seeded)
         {
             string filename;
             lock (this)
@@ -1273,6 +1548,10 @@ namespace Versionr.ObjectStore
 
             baseFileStream = tempFileName.OpenRead();
 
+            seeded = (data & SeededDeltaFlag) != 0;
+            if (seeded)
+                return LZHAMReaderStream.OpenSeededStream(deltaLength, stream, baseFileStream);
+
             switch ((CompressionMode)(data & 0x0FFF))
             {
                 case CompressionMode.LZ4:
@@ -1305,8 +1584,17 @@ namespace Versionr.ObjectStore
             stream.Read(buffer, 0, 8);
             long length = BitConverter.ToInt64(buffer, 0);
             flength = length;
+            string dictionaryLookup = null;
+            if ((data & DictionaryFlag) != 0)
+                dictionaryLookup = ReadDictionaryLookup(stream);
             if (((uint)data & 0x8000) != 0)
                 ChunkedChecksum.Skip(stream);
+            if (dictionaryLookup != null)
+            {
+                if ((CompressionMode)(data & 0x0FFF) != CompressionMode.LZHAM)
+                    throw new Exception();
+                return LZHAMReaderStream.OpenDictionaryStream(length, stream, LoadDictionary(dictionaryLookup));
+            }
             switch ((CompressionMode)(data & 0x0FFF))
             {
                 case CompressionMode.None:
@@ -1321,6 +1609,89 @@ namespace Versionr.ObjectStore
             }
         }
 
+        private static string ReadDictionaryLookup(Stream stream)
+        {
+            byte[] buffer = new byte[4];
+            stream.Read(buffer, 0, 4);
+            byte[] lookupData = new byte[BitConverter.ToInt32(buffer, 0)];
+            stream.Read(lookupData, 0, lookupData.Length);
+            return ASCIIEncoding.ASCII.GetString(lookupData);
+        }
+
+        // Dictionaries are small and shared by many objects, so they stay in memory once read.
+        private byte[] LoadDictionary(string lookup)
+        {
+            lock (LoadedDictionaries)
+            {
+                byte[] dictionary;
+                if (LoadedDictionaries.TryGetValue(lookup, out dictionary))
+                    return dictionary;
+                MemoryStream ms = new MemoryStream();
+                using (var stream = GetStreamForLookup(lookup))
+                    stream.CopyTo(ms);
+                dictionary = ms.ToArray();
+                LoadedDictionaries[lookup] = dictionary;
+                return dictionary;
+            }
+        }
+
+        public override bool TrainDictionary(int dictionarySize)
+        {
+            if (DefaultCompression != CompressionMode.LZHAM)
+            {
+                Printer.PrintError("#e#Error:## Shared dictionaries require LZHAM compression.");
+                return false;
+            }
+            var candidates = ObjectDatabase.Query<FileObjectStoreData>("SELECT * FROM FileObjectStoreData WHERE BlobID IS NOT NULL").Where(x => x.Mode == StorageMode.Flat).ToList();
+            Random random = new Random();
+            for (int i = candidates.Count - 1; i > 0; i--)
+            {
+                int j = random.Next(i + 1);
+                var temp = candidates[i];
+                candidates[i] = candidates[j];
+                candidates[j] = temp;
+            }
+            List<byte[]> samples = new List<byte[]>();
+            long sampleBytes = 0;
+            foreach (var x in candidates)
+            {
+                if (sampleBytes >= MaxDictionarySampleBytes)
+                    break;
+                MemoryStream ms = new MemoryStream();
+                using (var stream = GetStreamForLookup(x.Lookup))
+                    stream.CopyTo(ms);
+                if (ms.Length == 0)
+                    continue;
+                samples.Add(ms.ToArray());
+                sampleBytes += ms.Length;
+            }
+            Printer.PrintMessage("Training dictionary from {0} objects ({1})...", samples.Count, Misc.FormatSizeFriendly(sampleBytes));
+            byte[] dictionary = samples.Count > 0 ? LZHAMWriter.TrainDictionary(samples, dictionarySize) : null;
+            if (dictionary == null)
+            {
+                Printer.PrintError("#w#Warning:## Not enough shared data in small objects to build a dictionary.");
+                return false;
+            }
+
+            var transaction = BeginStorageTransaction();
+            string lookup;
+            try
+            {
+                lookup = CreateDataStream(transaction, new MemoryStream(dictionary));
+                EndStorageTransaction(transaction);
+            }
+            catch
+            {
+                AbortStorageTransaction(transaction);
+                throw;
+            }
+            var entry = new CompressionDictionary() { Lookup = lookup };
+            ObjectDatabase.InsertSafe(entry);
+            ActiveDictionary = entry;
+            Printer.PrintMessage("Stored {0} dictionary #b#{1}## as version {2}. New objects under {3} will be compressed with it.", Misc.FormatSizeFriendly(dictionary.Length), lookup, entry.Id, Misc.FormatSizeFriendly(MinimumLooseFileSize));
+            return true;
+        }
+
         private Stream OpenLegacyStreamReadOnly(FileObjectStoreData storeData, out long length)
         {
             if (storeData.BlobID.HasValue)
@@ -9,12 +9,45 @@ namespace Versionr.Utilities
 {
     public class LZHL
     {
+        // Window sizes (log2 bytes) instantiated by the native library: 16K, 256K and 4M.
+        public const int DefaultWindowBits = 14;
+        public static readonly int[] SupportedWindowBits = new int[] { 14, 18, 22 };
+        public static int PreferredWindowBits = 18;
+        public static bool AllowStreaming = true;
+
+        public static int NegotiateWindowBits(int? requested)
+        {
+            int result = DefaultWindowBits;
+            if (requested.HasValue)
+            {
+                foreach (var x in SupportedWindowBits)
+                {
+                    if (x <= requested.Value && x <= PreferredWindowBits)
+                        result = Math.Max(result, x);
+                }
+            }
+            return result;
+        }
+
         [DllImport("lzhl", EntryPoint = "CreateCompressor", CallingConvention = CallingConvention.Cdecl)]
         public static extern IntPtr CreateCompressor();
+        [DllImport("lzhl", EntryPoint = "CreateCompressorWindow", CallingConvention = CallingConvention.Cdecl)]
+        public static extern IntPtr CreateCompressor(int windowBits);
         [DllImport("lzhl", EntryPoint = "DestroyCompressor", CallingConvention = CallingConvention.Cdecl)]
         public static extern void DestroyCompressor(IntPtr compressor);
+        [DllImport("lzhl", EntryPoint = "CreateCompressPipeline", CallingConvention = CallingConvention.Cdecl)]
+        public static extern IntPtr CreateCompressPipeline(int windowBits, int threads);
+        [DllImport("lzhl", EntryPoint = "DestroyCompressPipeline", CallingConvention = CallingConvention.Cdecl)]
+        public static extern void DestroyCompressPipeline(IntPtr pipeline);
+        // Codes standalone packets input[offsets[i]..offsets[i + 1]) in parallel, each into output at outputOffsets[i] with room for
+        // CompressBound of its size. checksums (may be null) receive Network.Utilities.ComputeChecksumFNVWeak of each packet.
+        // Returns 0, or -1 if any packet failed.
+        [DllImport("lzhl", EntryPoint = "CompressBatch", CallingConvention = CallingConvention.Cdecl)]
+        public static extern int CompressBatch(IntPtr pipeline, int count, byte[] input, uint[] offsets, byte[] output, uint[] outputOffsets, uint[] outputSizes, uint[] checksums);
         [DllImport("lzhl", EntryPoint = "CreateDecompressor", CallingConvention = CallingConvention.Cdecl)]
         public static extern IntPtr CreateDecompressor();
+        [DllImport("lzhl", EntryPoint = "CreateDecompressorWindow", CallingConvention = CallingConvention.Cdecl)]
+        public static extern IntPtr CreateDecompressor(int windowBits);
         [DllImport("lzhl", EntryPoint = "DestroyDecompressor", CallingConvention = CallingConvention.Cdecl)]
         public static extern void DestroyDecompressor(IntPtr decompressor);
         [DllImport("lzhl", EntryPoint = "ResetCompressor", CallingConvention = CallingConvention.Cdecl)]
@@ -24,7 +57,40 @@ namespace Versionr.Utilities
 
         [DllImport("lzhl", EntryPoint = "Compress", CallingConvention = CallingConvention.Cdecl)]
         public static extern uint Compress(IntPtr compressor, byte[] buffer, uint bufferSize, byte[] result);
+        [DllImport("lzhl", EntryPoint = "CompressBound", CallingConvention = CallingConvention.Cdecl)]
+        public static extern uint CompressBound(uint bufferSize);
         [DllImport("lzhl", EntryPoint = "Decompress", CallingConvention = CallingConvention.Cdecl)]
         public static extern uint Decompress(IntPtr decompressor, byte[] buffer, uint bufferSize, byte[] result, uint outputSize);
+
+        // Stream packets keep the window and Huffman statistics of the previous packets; result needs CompressBound(bufferSize) + 1 bytes.
+        [DllImport("lzhl", EntryPoint = "CompressStream", CallingConvention = CallingConvention.Cdecl)]
+        public static extern uint CompressStream(IntPtr compressor, byte[] buffer, uint bufferSize, byte[] result, bool resync);
+        [DllImport("lzhl", EntryPoint = "DecompressStream", CallingConvention = CallingConvention.Cdecl)]
+        public static extern uint DecompressStream(IntPtr decompressor, byte[] buffer, uint bufferSize, byte[] result, uint outputSize);
+
+        // Resumable decoding: returns 1 when the packet is complete, 0 when the output is full and -1 if the packet is corrupt.
+        [DllImport("lzhl", EntryPoint = "DecompressPartial", CallingConvention = CallingConvention.Cdecl)]
+        static unsafe extern int DecompressPartial(IntPtr decompressor, byte* buffer, uint bufferSize, byte* result, uint outputSize, out uint consumed, out uint produced, bool first);
+        [DllImport("lzhl", EntryPoint = "DecompressStreamPartial", CallingConvention = CallingConvention.Cdecl)]
+        static unsafe extern int DecompressStreamPartial(IntPtr decompressor, byte* buffer, uint bufferSize, byte* result, uint outputSize, out uint consumed, out uint produced, bool first);
+
+        // Decodes a packet into the first outputSize bytes of output. Returns the decompressed size, or -1 if
+        // the packet is corrupt or larger than outputSize.
+        public static unsafe int DecompressPacket(IntPtr decompressor, bool stream, byte[] packet, int packetSize, byte[] output, int outputSize)
+        {
+            if (outputSize > output.Length || packetSize > packet.Length)
+                throw new ArgumentOutOfRangeException();
+            uint consumed, produced;
+            int result;
+            fixed (byte* src = packet)
+            fixed (byte* dst = output)
+            {
+                if (stream)
+                    result = DecompressStreamPartial(decompressor, src, (uint)packetSize, dst, (uint)outputSize, out consumed, out produced, true);
+                else
+                    result = DecompressPartial(decompressor, src, (uint)packetSize, dst, (uint)outputSize, out consumed, out produced, true);
+            }
+            return result == 1 ? (int)produced : -1;
+        }
     }
 }
@@ -0,0 +1,69 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Text;
+using System.Threading.Tasks;
+using System.Runtime.InteropServices;
+
+namespace Versionr.Utilities
+{
+    // Checksums from the native checksum module (checksum/checksum.c), exported by lzhamwrapper. Arrays are pinned for the call.
+    public class NativeChecksum
+    {
+        [DllImport("lzhamwrapper", EntryPoint = "ChecksumAdler32", CallingConvention = CallingConvention.Cdecl)]
+        static extern uint Adler32Native(uint adler, byte[] data, int length);
+        [DllImport("lzhamwrapper", EntryPoint = "ChecksumFastHash", CallingConvention = CallingConvention.Cdecl)]
+        static extern uint FastHashNative(byte[] data, int length);
+        [DllImport("lzhamwrapper", EntryPoint = "ChecksumCRC32C", CallingConvention = CallingConvention.Cdecl)]
+        static extern uint CRC32CNative(uint crc, byte[] data, int length);
+        [DllImport("lzhamwrapper", EntryPoint = "ChecksumXXHash32", CallingConvention = CallingConvention.Cdecl)]
+        static extern uint XXHash32Native(byte[] data, int length, uint seed);
+        [DllImport("lzhamwrapper", EntryPoint = "ChecksumXXHash64", CallingConvention = CallingConvention.Cdecl)]
+        static extern ulong XXHash64Native(byte[] data, int length, ulong seed);
+        [DllImport("lzhamwrapper", EntryPoint = "ChecksumFNVWeak", CallingConvention = CallingConvention.Cdecl)]
+        static extern uint FNVWeakNative(byte[] data, int length);
+
+        static int CheckLength(byte[] data, int length)
+        {
+            if (length < 0)
+                return data.Length;
+            if (length > data.Length)
+                throw new ArgumentOutOfRangeException("length");
+            return length;
+        }
+
+        // zlib Adler-32; pass a previous result to continue it.
+        public static uint Adler32(byte[] data, int length = -1, uint adler = 1)
+        {
+            return Adler32Native(adler, data, CheckLength(data, length));
+        }
+
+        // Same value as ObjectStore.ChunkedChecksum.FastHash (Adler sums modulo 2^16).
+        public static uint FastHash(byte[] data, int length = -1)
+        {
+            return FastHashNative(data, CheckLength(data, length));
+        }
+
+        public static uint CRC32C(byte[] data, int length = -1, uint crc = 0)
+        {
+            return CRC32CNative(crc, data, CheckLength(data, length));
+        }
+
+        // Same value as xxHashSharp.xxHash.CalculateHash.
+        public static uint XXHash32(byte[] data, int length = -1, uint seed = 0)
+        {
+            return XXHash32Native(data, CheckLength(data, length), seed);
+        }
+
+        public static ulong XXHash64(byte[] data, int length = -1, ulong seed = 0)
+        {
+            return XXHash64Native(data, CheckLength(data, length), seed);
+        }
+
+        // Same value as Network.Utilities.ComputeChecksumFNVWeak.
+        public static uint FNVWeak(byte[] data, int length = -1)
+        {
+            return FNVWeakNative(data, CheckLength(data, length));
+        }
+    }
+}
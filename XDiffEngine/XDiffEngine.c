@@ -36,11 +36,12 @@
 #define XDIFF_EXPORT __attribute__ ((visibility ("default")))
 #endif
 
-static int markfail(void *priv, mmbuffer_t *mb, int nbuf)
-{
-	*(int*)priv = 1;
-	return 0;
-}
+/* Line matching used by the file exports, which have no flags parameter. Histogram diff keeps rewritten files
+   close to linear and anchors hunks on unique lines; Myers still handles whatever it cannot anchor. */
+#define XDIFF_DEFAULT_FLAGS XDF_HISTOGRAM_DIFF
+
+/* The xpparam_t flags the buffer exports accept. */
+#define XDIFF_DIFF_FLAGS (XDF_NEED_MINIMAL | XDF_PATIENCE_DIFF | XDF_HISTOGRAM_DIFF)
 
 static int xdlt_outf(void *priv, mmbuffer_t *mb, int nbuf) {
 	int i;
@@ -65,240 +66,642 @@ void usage(char const *prg) {
 }
 
 
-static void *wrap_malloc(void *priv, unsigned int size) {
+/*
+ * Engine contexts. Each call installs its context's allocator for the calling thread, so libxdiff allocates from a
+ * bump-pointer arena laid out like chastore_t (a list of fixed-size nodes with a fill mark) and the whole arena is
+ * rewound when the call ends. Allocations too big for a node are malloc'd on their own and linked so that free and
+ * realloc still return their memory early. A context serves one call at a time; concurrent callers use one each.
+ */
+#define ARENA_ALIGN 16
+#define ARENA_ROUND(n) (((n) + ARENA_ALIGN - 1) & ~(long) (ARENA_ALIGN - 1))
+#define ARENA_NODE_SIZE (1024 * 1024)
+#define ARENA_LARGE_SIZE (ARENA_NODE_SIZE / 4)
+#define ARENA_RETAIN_NODES 4
+
+typedef struct s_arenablock {
+	struct s_arenablock *prev, *next;
+	unsigned int size;
+	int large;
+} arenablock_t;
+
+typedef struct s_arenanode {
+	struct s_arenanode *next;
+	long used;
+} arenanode_t;
+
+#define ARENA_BLOCK_HDR ARENA_ROUND((long) sizeof(arenablock_t))
+#define ARENA_NODE_HDR ARENA_ROUND((long) sizeof(arenanode_t))
+
+typedef struct s_xdcontext {
+	memallocator_t malt;
+	arenanode_t *nodes, *cur;
+	arenablock_t *large, *last;
+} xdcontext_t;
+
+static void *arena_malloc(void *priv, unsigned int size) {
+	xdcontext_t *ctx = (xdcontext_t *) priv;
+	long need = ARENA_BLOCK_HDR + ARENA_ROUND((long) size);
+	arenablock_t *blk;
+	arenanode_t *node;
+
+	if (need > ARENA_LARGE_SIZE) {
+		if (!(blk = (arenablock_t *) malloc(ARENA_BLOCK_HDR + size)))
+			return NULL;
+		blk->large = 1;
+		blk->size = size;
+		blk->prev = NULL;
+		if ((blk->next = ctx->large) != NULL)
+			blk->next->prev = blk;
+		ctx->large = blk;
+		return (char *) blk + ARENA_BLOCK_HDR;
+	}
+	if (!ctx->cur || ctx->cur->used + need > ARENA_NODE_SIZE) {
+		if (!(node = ctx->cur ? ctx->cur->next: ctx->nodes)) {
+			if (!(node = (arenanode_t *) malloc(ARENA_NODE_HDR + ARENA_NODE_SIZE)))
+				return NULL;
+			node->next = NULL;
+			if (ctx->cur)
+				ctx->cur->next = node;
+			else
+				ctx->nodes = node;
+		}
+		node->used = 0;
+		ctx->cur = node;
+	}
+	blk = (arenablock_t *) ((char *) ctx->cur + ARENA_NODE_HDR + ctx->cur->used);
+	blk->large = 0;
+	blk->size = size;
+	ctx->cur->used += need;
+	ctx->last = blk;
 
-	return malloc(size);
+	return (char *) blk + ARENA_BLOCK_HDR;
 }
 
+static void arena_free(void *priv, void *ptr) {
+	xdcontext_t *ctx = (xdcontext_t *) priv;
+	arenablock_t *blk;
+
+	if (!ptr)
+		return;
+	blk = (arenablock_t *) ((char *) ptr - ARENA_BLOCK_HDR);
+	if (blk->large) {
+		if (blk->prev)
+			blk->prev->next = blk->next;
+		else
+			ctx->large = blk->next;
+		if (blk->next)
+			blk->next->prev = blk->prev;
+		free(blk);
+	} else if (blk == ctx->last) {
+		/* Only the newest block can be taken back; the rest go when the call ends. */
+		ctx->cur->used = (long) ((char *) blk - ((char *) ctx->cur + ARENA_NODE_HDR));
+		ctx->last = NULL;
+	}
+}
 
-static void wrap_free(void *priv, void *ptr) {
+static void *arena_realloc(void *priv, void *ptr, unsigned int size) {
+	xdcontext_t *ctx = (xdcontext_t *) priv;
+	arenablock_t *blk;
+	long need, offset;
+	void *data;
+
+	if (!ptr)
+		return arena_malloc(priv, size);
+	blk = (arenablock_t *) ((char *) ptr - ARENA_BLOCK_HDR);
+	if (blk->large) {
+		if (!(blk = (arenablock_t *) realloc(blk, ARENA_BLOCK_HDR + size)))
+			return NULL;
+		blk->size = size;
+		if (blk->prev)
+			blk->prev->next = blk;
+		else
+			ctx->large = blk;
+		if (blk->next)
+			blk->next->prev = blk;
+		return (char *) blk + ARENA_BLOCK_HDR;
+	}
+	need = ARENA_BLOCK_HDR + ARENA_ROUND((long) size);
+	if (blk == ctx->last && need <= ARENA_LARGE_SIZE) {
+		/* The newest block can grow or shrink in place while its node has room. */
+		offset = (long) ((char *) blk - ((char *) ctx->cur + ARENA_NODE_HDR));
+		if (offset + need <= ARENA_NODE_SIZE) {
+			ctx->cur->used = offset + need;
+			blk->size = size;
+			return ptr;
+		}
+	}
+	if (!(data = arena_malloc(priv, size)))
+		return NULL;
+	memcpy(data, ptr, blk->size < size ? blk->size: size);
+	arena_free(priv, ptr);
 
-	free(ptr);
+	return data;
 }
 
+static void context_init(xdcontext_t *ctx) {
+	ctx->malt.priv = ctx;
+	ctx->malt.malloc = arena_malloc;
+	ctx->malt.free = arena_free;
+	ctx->malt.realloc = arena_realloc;
+	ctx->nodes = ctx->cur = NULL;
+	ctx->large = ctx->last = NULL;
+}
 
-static void *wrap_realloc(void *priv, void *ptr, unsigned int size) {
+/* Drops every allocation, keeping up to retain nodes for the next call. */
+static void context_reset(xdcontext_t *ctx, int retain) {
+	arenablock_t *blk, *next;
+	arenanode_t *node, **link;
 
-	return realloc(ptr, size);
+	for (blk = ctx->large; blk; blk = next) {
+		next = blk->next;
+		free(blk);
+	}
+	for (link = &ctx->nodes; *link && retain > 0; retain--)
+		link = &(*link)->next;
+	for (node = *link, *link = NULL; node; node = ctx->cur) {
+		ctx->cur = node->next;
+		free(node);
+	}
+	ctx->cur = NULL;
+	ctx->large = ctx->last = NULL;
 }
 
-void Init()
-{
-	memallocator_t malt;
+/* Installs the context given by the caller, or the call-local one if there is none. */
+static xdcontext_t *begin_call(void *context, xdcontext_t *local) {
+	xdcontext_t *ctx = (xdcontext_t *) context;
 
-	malt.priv = NULL;
-	malt.malloc = wrap_malloc;
-	malt.free = wrap_free;
-	malt.realloc = wrap_realloc;
-	xdl_set_allocator(&malt);
+	if (!ctx) {
+		context_init(local);
+		ctx = local;
+	}
+	xdl_set_thread_allocator(&ctx->malt);
+
+	return ctx;
+}
+
+static void end_call(xdcontext_t *ctx, xdcontext_t *local) {
+	xdl_set_thread_allocator(NULL);
+	context_reset(ctx, ctx == local ? 0: ARENA_RETAIN_NODES);
 }
 
-int XDIFF_EXPORT Merge3Way(const char* base, const char* f1, const char* f2, const char* out)
+void XDIFF_EXPORT *CreateContext(void)
 {
-	mmfile_t mf1, mf2, mfb;
-	xpparam_t xpp;
-	xdemitconf_t xecfg;
-	bdiffparam_t bdp;
-	xdemitcb_t ecb, rjecb;
-	int status = 0;
-	xecfg.ctxlen = 3;
+	xdcontext_t *ctx = (xdcontext_t *) malloc(sizeof(xdcontext_t));
 
-	Init();
+	if (ctx)
+		context_init(ctx);
+	return ctx;
+}
 
-	xpp.flags = 0;
-	if (xdlt_load_mmfile(base, &mfb, 1) < 0) {
-		return 1;
-	}
-	if (xdlt_load_mmfile(f1, &mf1, 1) < 0) {
-		xdl_free_mmfile(&mfb);
-		return 1;
+void XDIFF_EXPORT DestroyContext(void* context)
+{
+	if (context) {
+		context_reset((xdcontext_t *) context, 0);
+		free(context);
 	}
-	if (xdlt_load_mmfile(f2, &mf2, 1) < 0) {
-		xdl_free_mmfile(&mf1);
-		xdl_free_mmfile(&mfb);
-		return 1;
+}
+
+/* Growable output for the *Buffer exports; the caller releases ptr with FreeBuffer. */
+typedef struct s_outbuffer {
+	char *ptr;
+	long size, capacity;
+} outbuffer_t;
+
+static int buffer_outf(void *priv, mmbuffer_t *mb, int nbuf) {
+	outbuffer_t *ob = (outbuffer_t *) priv;
+	int i;
+	long need, capacity;
+	char *ptr;
+
+	for (i = 0; i < nbuf; i++) {
+		need = ob->size + mb[i].size;
+		if (need > ob->capacity) {
+			capacity = ob->capacity ? ob->capacity * 2 : 4096;
+			if (capacity < need)
+				capacity = need;
+			if (!(ptr = (char *) realloc(ob->ptr, capacity)))
+				return -1;
+			ob->ptr = ptr;
+			ob->capacity = capacity;
+		}
+		memcpy(ob->ptr + ob->size, mb[i].ptr, mb[i].size);
+		ob->size = need;
 	}
 
-	FILE* f = fopen(out, "wb");
-	ecb.priv = f;
-	ecb.outf = xdlt_outf;
-	rjecb.priv = &status;
-	rjecb.outf = markfail;
+	return 0;
+}
 
-	if (xdl_merge3(&mfb, &mf1, &mf2, &ecb, &rjecb) < 0) {
-		fclose(f);
+static void buffer_init(outbuffer_t *ob, xdemitcb_t *ecb) {
+	ob->ptr = NULL;
+	ob->size = ob->capacity = 0;
+	if (ecb) {
+		ecb->priv = ob;
+		ecb->outf = buffer_outf;
+	}
+}
 
-		xdl_free_mmfile(&mf2);
-		xdl_free_mmfile(&mf1);
-		xdl_free_mmfile(&mfb);
-		return 2;
+/* Hands the result to the caller, or drops it if the operation failed (status 2, or 3 for an unreadable merge input). */
+static void buffer_finish(outbuffer_t *ob, int status, void **output, int *outputLength) {
+	if (status >= 2) {
+		free(ob->ptr);
+		ob->ptr = NULL;
+		ob->size = 0;
 	}
+	*output = ob->ptr;
+	*outputLength = (int) ob->size;
+}
 
-	fclose(f);
+/* One merge conflict as handed to the caller: zero-based line ranges in the base, both files and the merged output.
+   The output range covers the marker lines. */
+typedef struct s_conflict {
+	int baseLine, baseCount;
+	int line1, count1;
+	int line2, count2;
+	int outputLine, outputCount;
+} conflict_t;
+
+static int conflict_add(void *priv, xmconflict_t const *xmc) {
+	conflict_t c;
+	mmbuffer_t mb;
+
+	c.baseLine = (int) xmc->io;
+	c.baseCount = (int) xmc->chgo;
+	c.line1 = (int) xmc->i1;
+	c.count1 = (int) xmc->chg1;
+	c.line2 = (int) xmc->i2;
+	c.count2 = (int) xmc->chg2;
+	c.outputLine = (int) xmc->ir;
+	c.outputCount = (int) xmc->chgr;
+	mb.ptr = (char *) &c;
+	mb.size = sizeof(c);
+
+	return buffer_outf(priv, &mb, 1);
+}
 
-	xdl_free_mmfile(&mf2);
-	xdl_free_mmfile(&mf1);
-	xdl_free_mmfile(&mfb);
-	return status;
+static void conflicts_finish(outbuffer_t *ob, int status, void **conflicts, int *conflictCount) {
+	buffer_finish(ob, status, conflicts, conflictCount);
+	*conflictCount /= (int) sizeof(conflict_t);
 }
 
+/* Wraps caller memory in a read-only block, so the input is diffed in place rather than copied. */
+static int load_buffer(const char *data, int size, mmfile_t *mf) {
+	static char empty;
 
-int XDIFF_EXPORT GeneratePatch(const char* f1, const char* f2, const char* out)
-{
-	mmfile_t mf1, mf2;
-	xpparam_t xpp;
-	xdemitconf_t xecfg;
-	bdiffparam_t bdp;
-	xdemitcb_t ecb, rjecb;
-	xecfg.ctxlen = 3;
+	if (size < 0 || xdl_init_mmfile(mf, 1024 * 8, XDL_MMF_ATOMIC) < 0)
+		return -1;
+	if (xdl_mmfile_ptradd(mf, size ? (char *) data : &empty, size, XDL_MMB_READONLY) < 0) {
+		xdl_free_mmfile(mf);
+		return -1;
+	}
 
-	Init();
+	return 0;
+}
 
-	xpp.flags = 0;
-	if (xdlt_load_mmfile(f1, &mf1, 1) < 0) {
-		return 1;
+/* Maps both inputs; release them with xdlt_free_mmfile. */
+static int load_files(const char *f1, mmfile_t *mf1, const char *f2, mmfile_t *mf2) {
+	if (xdlt_map_mmfile(f1, mf1) < 0)
+		return -1;
+	if (xdlt_map_mmfile(f2, mf2) < 0) {
+		xdlt_free_mmfile(mf1);
+		return -1;
 	}
-	if (xdlt_load_mmfile(f2, &mf2, 1) < 0) {
-		xdl_free_mmfile(&mf1);
-		return 1;
-	}
-
-	FILE* f = fopen(out, "wb");
-	ecb.priv = f;
-	ecb.outf = xdlt_outf;
 
-	if (xdl_diff(&mf1, &mf2, &xpp, &xecfg, &ecb) < 0) {
-		fclose(f);
+	return 0;
+}
 
-		xdl_free_mmfile(&mf2);
-		xdl_free_mmfile(&mf1);
-		return 2;
+static int load_buffers(const char *d1, int n1, mmfile_t *mf1, const char *d2, int n2, mmfile_t *mf2) {
+	if (load_buffer(d1, n1, mf1) < 0)
+		return -1;
+	if (load_buffer(d2, n2, mf2) < 0) {
+		xdl_free_mmfile(mf1);
+		return -1;
 	}
 
-	fclose(f);
-
-	xdl_free_mmfile(&mf2);
-	xdl_free_mmfile(&mf1);
 	return 0;
 }
 
-int XDIFF_EXPORT ApplyPatch(const char* f1, const char* f2, const char* out, const char* errors, int reverse, int flags)
+/* The operations behind both the file and the buffer exports. They return 0 on success and 2 if libxdiff failed;
+   merge3 returns 1 if f1 and f2 conflict, in which case the output holds diff3 style markers labelled after the
+   .mine, .base and .theirs files Versionr leaves next to an unresolved file. */
+static int do_merge3(mmfile_t *mfb, mmfile_t *mf1, mmfile_t *mf2, int flags, xdemitcb_t *ecb, outbuffer_t *conflicts)
+{
+	xmparam_t xmp;
+	xmconflictcb_t ccb;
+	int nconf;
+
+	xmp.xpp.flags = flags & XDIFF_DIFF_FLAGS;
+	xmp.flags = XDL_MERGE_DIFF3;
+	xmp.name1 = "mine";
+	xmp.name2 = "theirs";
+	xmp.nameo = "base";
+	ccb.priv = conflicts;
+	ccb.conflictf = conflict_add;
+	if ((nconf = xdl_diff3(mfb, mf1, mf2, &xmp, ecb, &ccb)) < 0)
+		return 2;
+
+	return nconf > 0 ? 1: 0;
+}
+
+static int do_diff(mmfile_t *mf1, mmfile_t *mf2, int flags, xdemitcb_t *ecb)
 {
-	mmfile_t mf1, mf2;
 	xpparam_t xpp;
 	xdemitconf_t xecfg;
-	bdiffparam_t bdp;
-	xdemitcb_t ecb, rjecb;
+
+	xpp.flags = flags & XDIFF_DIFF_FLAGS;
+	xecfg.ctxlen = 3;
+	if (xdl_diff(mf1, mf2, &xpp, &xecfg, ecb) < 0)
+		return 2;
+
+	return 0;
+}
+
+static int do_patch(mmfile_t *mf, mmfile_t *mfp, int reverse, int flags, xdemitcb_t *ecb, xdemitcb_t *rjecb)
+{
 	int mode;
 
 	if (reverse == 1)
 		mode = XDL_PATCH_REVERSE | flags;
 	else
 		mode = XDL_PATCH_NORMAL | flags;
+	if (xdl_patch(mf, mfp, mode, ecb, rjecb) < 0)
+		return 2;
 
-	Init();
+	return 0;
+}
 
-	xpp.flags = 0;
-	if (xdlt_load_mmfile(f1, &mf1, 1) < 0) {
-		return 1;
+static int do_bdiff(mmfile_t *mf1, mmfile_t *mf2, xdemitcb_t *ecb)
+{
+	if (xdl_rabdiff(mf1, mf2, ecb) < 0)
+		return 2;
+
+	return 0;
+}
+
+static int do_bpatch(mmfile_t *mf, mmfile_t *mfp, xdemitcb_t *ecb)
+{
+	if (xdl_bpatch(mf, mfp, ecb) < 0)
+		return 2;
+
+	return 0;
+}
+
+/* conflicts is set like the outputs of the *Buffer exports below, to conflictCount conflict_t entries. Returns 0 for a
+   clean merge, 1 for conflicts, 2 if libxdiff failed and 3 if an input couldn't be read; the baseline's 1 for an
+   unreadable input now means conflicts, so it has a code of its own. */
+int XDIFF_EXPORT Merge3Way(const char* base, const char* f1, const char* f2, const char* out, void** conflicts, int* conflictCount)
+{
+	mmfile_t mf1, mf2, mfb;
+	xdemitcb_t ecb;
+	outbuffer_t cb;
+	xdcontext_t local, *ctx = begin_call(NULL, &local);
+	FILE* f;
+	int status = 3;
+
+	buffer_init(&cb, NULL);
+	if (xdlt_map_mmfile(base, &mfb) == 0) {
+		if (load_files(f1, &mf1, f2, &mf2) == 0) {
+			f = fopen(out, "wb");
+			ecb.priv = f;
+			ecb.outf = xdlt_outf;
+			status = do_merge3(&mfb, &mf1, &mf2, XDIFF_DEFAULT_FLAGS, &ecb, &cb);
+			fclose(f);
+
+			xdlt_free_mmfile(&mf2);
+			xdlt_free_mmfile(&mf1);
+		}
+		xdlt_free_mmfile(&mfb);
 	}
-	if (xdlt_load_mmfile(f2, &mf2, 1) < 0) {
-		xdl_free_mmfile(&mf1);
-		return 1;
+	conflicts_finish(&cb, status, conflicts, conflictCount);
+
+	end_call(ctx, &local);
+	return status;
+}
+
+
+int XDIFF_EXPORT GeneratePatch(const char* f1, const char* f2, const char* out)
+{
+	mmfile_t mf1, mf2;
+	xdemitcb_t ecb;
+	xdcontext_t local, *ctx = begin_call(NULL, &local);
+	FILE* f;
+	int status = 1;
+
+	if (load_files(f1, &mf1, f2, &mf2) == 0) {
+		f = fopen(out, "wb");
+		ecb.priv = f;
+		ecb.outf = xdlt_outf;
+		status = do_diff(&mf1, &mf2, XDIFF_DEFAULT_FLAGS, &ecb);
+		fclose(f);
+
+		xdlt_free_mmfile(&mf2);
+		xdlt_free_mmfile(&mf1);
 	}
 
-	FILE* f = fopen(out, "wb");
-	FILE* e = fopen(errors, "wb");
-	ecb.priv = f;
-	ecb.outf = xdlt_outf;
-	rjecb.priv = e;
-	rjecb.outf = xdlt_outf;
-	if (xdl_patch(&mf1, &mf2, mode, &ecb, &rjecb) < 0) {
+	end_call(ctx, &local);
+	return status;
+}
+
+int XDIFF_EXPORT ApplyPatch(const char* f1, const char* f2, const char* out, const char* errors, int reverse, int flags)
+{
+	mmfile_t mf1, mf2;
+	xdemitcb_t ecb, rjecb;
+	xdcontext_t local, *ctx = begin_call(NULL, &local);
+	FILE *f, *e;
+	int status = 1;
+
+	if (load_files(f1, &mf1, f2, &mf2) == 0) {
+		f = fopen(out, "wb");
+		e = fopen(errors, "wb");
+		ecb.priv = f;
+		ecb.outf = xdlt_outf;
+		rjecb.priv = e;
+		rjecb.outf = xdlt_outf;
+		status = do_patch(&mf1, &mf2, reverse, flags, &ecb, &rjecb);
 		fclose(f);
 		fclose(e);
-		xdl_free_mmfile(&mf2);
-		xdl_free_mmfile(&mf1);
-		return 2;
-	}
 
-	fclose(f);
-	fclose(e);
+		xdlt_free_mmfile(&mf2);
+		xdlt_free_mmfile(&mf1);
+	}
 
-	xdl_free_mmfile(&mf2);
-	xdl_free_mmfile(&mf1);
-	return 0;
+	end_call(ctx, &local);
+	return status;
 }
 
 int XDIFF_EXPORT GenerateBinaryPatch(const char* f1, const char* f2, const char* out)
 {
 	mmfile_t mf1, mf2;
-	xpparam_t xpp;
-	xdemitconf_t xecfg;
-	bdiffparam_t bdp;
-	xdemitcb_t ecb, rjecb;
+	xdemitcb_t ecb;
+	xdcontext_t local, *ctx = begin_call(NULL, &local);
+	FILE* f;
+	int status = 1;
+
+	if (load_files(f1, &mf1, f2, &mf2) == 0) {
+		f = fopen(out, "wb");
+		ecb.priv = f;
+		ecb.outf = xdlt_outf;
+		status = do_bdiff(&mf1, &mf2, &ecb);
+		fclose(f);
 
-	Init();
+		xdlt_free_mmfile(&mf2);
+		xdlt_free_mmfile(&mf1);
+	}
 
-	xpp.flags = 0;
-	if (xdlt_load_mmfile(f1, &mf1, 1) < 0) {
-		return 1;
+	end_call(ctx, &local);
+	return status;
+}
+
+int XDIFF_EXPORT ApplyBinaryPatch(const char* f1, const char* f2, const char* out)
+{
+	mmfile_t mf1, mf2;
+	xdemitcb_t ecb;
+	xdcontext_t local, *ctx = begin_call(NULL, &local);
+	FILE* f;
+	int status = 1;
+
+	if (load_files(f1, &mf1, f2, &mf2) == 0) {
+		f = fopen(out, "wb");
+		ecb.priv = f;
+		ecb.outf = xdlt_outf;
+		status = do_bpatch(&mf1, &mf2, &ecb);
+		fclose(f);
+
+		xdlt_free_mmfile(&mf2);
+		xdlt_free_mmfile(&mf1);
 	}
-	if (xdlt_load_mmfile(f2, &mf2, 1) < 0) {
-		xdl_free_mmfile(&mf1);
-		return 1;
+
+	end_call(ctx, &local);
+	return status;
+}
+
+/* Buffer-in, buffer-out versions of the exports above. Inputs are only read and may be pinned managed arrays.
+   Each output is set to a buffer the caller must release with FreeBuffer; it is NULL if empty or if the call failed.
+   context comes from CreateContext and may be NULL for a one-off call. flags selects the diff algorithm (XDF_*) for
+   the text diff and merge, and the patch mode flags (XDL_PATCH_*) for ApplyPatchBuffer. */
+
+int XDIFF_EXPORT Merge3WayBuffer(void* context, const char* base, int baseLength, const char* d1, int length1, const char* d2, int length2, void** output, int* outputLength, void** conflicts, int* conflictCount, int flags)
+{
+	mmfile_t mf1, mf2, mfb;
+	xdemitcb_t ecb;
+	outbuffer_t ob, cb;
+	xdcontext_t local, *ctx = begin_call(context, &local);
+	int status = 3;
+
+	*output = NULL;
+	*outputLength = 0;
+	buffer_init(&cb, NULL);
+	if (load_buffer(base, baseLength, &mfb) == 0) {
+		if (load_buffers(d1, length1, &mf1, d2, length2, &mf2) == 0) {
+			buffer_init(&ob, &ecb);
+			status = do_merge3(&mfb, &mf1, &mf2, flags, &ecb, &cb);
+			buffer_finish(&ob, status, output, outputLength);
+
+			xdl_free_mmfile(&mf2);
+			xdl_free_mmfile(&mf1);
+		}
+		xdl_free_mmfile(&mfb);
 	}
+	conflicts_finish(&cb, status, conflicts, conflictCount);
 
-	FILE* f = fopen(out, "wb");
-	ecb.priv = f;
-	ecb.outf = xdlt_outf;
+	end_call(ctx, &local);
+	return status;
+}
 
-	if (xdl_rabdiff(&mf1, &mf2, &ecb) < 0) {
-		fclose(f);
+int XDIFF_EXPORT GeneratePatchBuffer(void* context, const char* d1, int length1, const char* d2, int length2, void** output, int* outputLength, int flags)
+{
+	mmfile_t mf1, mf2;
+	xdemitcb_t ecb;
+	outbuffer_t ob;
+	xdcontext_t local, *ctx = begin_call(context, &local);
+	int status = 1;
+
+	*output = NULL;
+	*outputLength = 0;
+	if (load_buffers(d1, length1, &mf1, d2, length2, &mf2) == 0) {
+		buffer_init(&ob, &ecb);
+		status = do_diff(&mf1, &mf2, flags, &ecb);
+		buffer_finish(&ob, status, output, outputLength);
 
 		xdl_free_mmfile(&mf2);
 		xdl_free_mmfile(&mf1);
-		return 2;
 	}
 
-	fclose(f);
-
-	xdl_free_mmfile(&mf2);
-	xdl_free_mmfile(&mf1);
-	return 0;
+	end_call(ctx, &local);
+	return status;
 }
 
-int XDIFF_EXPORT ApplyBinaryPatch(const char* f1, const char* f2, const char* out)
+int XDIFF_EXPORT ApplyPatchBuffer(void* context, const char* d1, int length1, const char* patch, int patchLength, void** output, int* outputLength, void** errors, int* errorsLength, int reverse, int flags)
 {
 	mmfile_t mf1, mf2;
-	xpparam_t xpp;
-	xdemitconf_t xecfg;
-	bdiffparam_t bdp;
 	xdemitcb_t ecb, rjecb;
+	outbuffer_t ob, rjob;
+	xdcontext_t local, *ctx = begin_call(context, &local);
+	int status = 1;
+
+	*output = *errors = NULL;
+	*outputLength = *errorsLength = 0;
+	if (load_buffers(d1, length1, &mf1, patch, patchLength, &mf2) == 0) {
+		buffer_init(&ob, &ecb);
+		buffer_init(&rjob, &rjecb);
+		status = do_patch(&mf1, &mf2, reverse, flags, &ecb, &rjecb);
+		buffer_finish(&ob, status, output, outputLength);
+		buffer_finish(&rjob, status, errors, errorsLength);
 
-	Init();
-
-	xpp.flags = 0;
-	if (xdlt_load_mmfile(f1, &mf1, 1) < 0) {
-		return 1;
+		xdl_free_mmfile(&mf2);
+		xdl_free_mmfile(&mf1);
 	}
-	if (xdlt_load_mmfile(f2, &mf2, 1) < 0) {
+
+	end_call(ctx, &local);
+	return status;
+}
+
+int XDIFF_EXPORT GenerateBinaryPatchBuffer(void* context, const char* d1, int length1, const char* d2, int length2, void** output, int* outputLength)
+{
+	mmfile_t mf1, mf2;
+	xdemitcb_t ecb;
+	outbuffer_t ob;
+	xdcontext_t local, *ctx = begin_call(context, &local);
+	int status = 1;
+
+	*output = NULL;
+	*outputLength = 0;
+	if (load_buffers(d1, length1, &mf1, d2, length2, &mf2) == 0) {
+		buffer_init(&ob, &ecb);
+		status = do_bdiff(&mf1, &mf2, &ecb);
+		buffer_finish(&ob, status, output, outputLength);
+
+		xdl_free_mmfile(&mf2);
 		xdl_free_mmfile(&mf1);
-		return 1;
 	}
 
-	FILE* f = fopen(out, "wb");
-	ecb.priv = f;
-	ecb.outf = xdlt_outf;
-	if (xdl_bpatch(&mf1, &mf2, &ecb) < 0) {
-		fclose(f);
+	end_call(ctx, &local);
+	return status;
+}
+
+int XDIFF_EXPORT ApplyBinaryPatchBuffer(void* context, const char* d1, int length1, const char* patch, int patchLength, void** output, int* outputLength)
+{
+	mmfile_t mf1, mf2;
+	xdemitcb_t ecb;
+	outbuffer_t ob;
+	xdcontext_t local, *ctx = begin_call(context, &local);
+	int status = 1;
+
+	*output = NULL;
+	*outputLength = 0;
+	if (load_buffers(d1, length1, &mf1, patch, patchLength, &mf2) == 0) {
+		buffer_init(&ob, &ecb);
+		status = do_bpatch(&mf1, &mf2, &ecb);
+		buffer_finish(&ob, status, output, outputLength);
+
 		xdl_free_mmfile(&mf2);
 		xdl_free_mmfile(&mf1);
-		return 2;
 	}
 
-	fclose(f);
+	end_call(ctx, &local);
+	return status;
+}
 
-	xdl_free_mmfile(&mf2);
-	xdl_free_mmfile(&mf1);
-	return 0;
+void XDIFF_EXPORT FreeBuffer(void* buffer)
+{
+	free(buffer);
 }
@@ -0,0 +1,426 @@
+#include "checksum.h"
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CHECKSUM_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define CHECKSUM_TARGET(isa) __attribute__((target(isa)))
+#else
+#define CHECKSUM_TARGET(isa)
+#endif
+
+/* Tables and kernel selection are set up once when the library is loaded. */
+#ifdef _MSC_VER
+static void __cdecl checksum_init(void);
+#pragma section(".CRT$XCU", read)
+__declspec(allocate(".CRT$XCU")) void (__cdecl *checksum_init_entry)(void) = checksum_init;
+#ifdef _WIN64
+#pragma comment(linker, "/include:checksum_init_entry")
+#else
+#pragma comment(linker, "/include:_checksum_init_entry")
+#endif
+#else
+static void checksum_init(void) __attribute__((constructor));
+#endif
+
+static inline uint32_t read32(const uint8_t* p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t read64(const uint8_t* p)
+{
+	return (uint64_t)read32(p) | ((uint64_t)read32(p + 4) << 32);
+}
+
+static inline uint32_t rotl32(uint32_t x, int r)
+{
+	return (x << r) | (x >> (32 - r));
+}
+
+static inline uint64_t rotl64(uint64_t x, int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+/* Adler sums */
+
+#define ADLER_BASE 65521u
+/* Largest n such that 255n(n+1)/2 + (n+1)(BASE-1) <= 2^32-1 */
+#define ADLER_NMAX 5552
+
+typedef void (*AdlerSums)(uint32_t* s1, uint32_t* s2, const uint8_t* p, size_t len);
+
+/* Adds len bytes to both sums without reducing them. */
+static void adler_sums_scalar(uint32_t* s1, uint32_t* s2, const uint8_t* p, size_t len)
+{
+	uint32_t a = *s1;
+	uint32_t b = *s2;
+	for (; len >= 8; len -= 8, p += 8)
+	{
+		a += p[0]; b += a;
+		a += p[1]; b += a;
+		a += p[2]; b += a;
+		a += p[3]; b += a;
+		a += p[4]; b += a;
+		a += p[5]; b += a;
+		a += p[6]; b += a;
+		a += p[7]; b += a;
+	}
+	while (len--)
+	{
+		a += *p++;
+		b += a;
+	}
+	*s1 = a;
+	*s2 = b;
+}
+
+#ifdef CHECKSUM_X86
+CHECKSUM_TARGET("avx2")
+static uint32_t hsum_avx2(__m256i v)
+{
+	__m128i x = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+	x = _mm_add_epi32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2)));
+	x = _mm_add_epi32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1)));
+	return (uint32_t)_mm_cvtsi128_si32(x);
+}
+
+/* 32 bytes per step: byte sums via SAD, position-weighted sums via maddubs, and the s1 carried
+   into s2 by each step kept in `prior` and scaled by 32 at the end. */
+CHECKSUM_TARGET("avx2")
+static void adler_sums_avx2(uint32_t* s1, uint32_t* s2, const uint8_t* p, size_t len)
+{
+	const __m256i taps = _mm256_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17,
+	                                      16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+	const __m256i ones = _mm256_set1_epi16(1);
+	const __m256i zero = _mm256_setzero_si256();
+	__m256i sum = zero;
+	__m256i prior = zero;
+	__m256i weighted = zero;
+	size_t blocks = len / 32;
+	size_t i;
+
+	for (i = 0; i < blocks; i++)
+	{
+		__m256i bytes = _mm256_loadu_si256((const __m256i*)(p + i * 32));
+		prior = _mm256_add_epi32(prior, sum);
+		sum = _mm256_add_epi32(sum, _mm256_sad_epu8(bytes, zero));
+		weighted = _mm256_add_epi32(weighted, _mm256_madd_epi16(_mm256_maddubs_epi16(bytes, taps), ones));
+	}
+	weighted = _mm256_add_epi32(weighted, _mm256_slli_epi32(prior, 5));
+	*s2 += *s1 * (uint32_t)(blocks * 32) + hsum_avx2(weighted);
+	*s1 += hsum_avx2(sum);
+	adler_sums_scalar(s1, s2, p + blocks * 32, len - blocks * 32);
+}
+#endif
+
+static AdlerSums adler_sums = adler_sums_scalar;
+
+uint32_t checksum_adler32(uint32_t adler, const void* buf, size_t len)
+{
+	const uint8_t* p = (const uint8_t*)buf;
+	uint32_t s1 = adler & 0xffff;
+	uint32_t s2 = adler >> 16;
+	while (len > 0)
+	{
+		size_t n = len < ADLER_NMAX ? len : ADLER_NMAX;
+		adler_sums(&s1, &s2, p, n);
+		s1 %= ADLER_BASE;
+		s2 %= ADLER_BASE;
+		p += n;
+		len -= n;
+	}
+	return (s2 << 16) | s1;
+}
+
+/* Every step is linear, so sums wrapping at 2^32 are still right modulo 2^16. */
+uint32_t checksum_fast_hash(uint32_t hash, const void* buf, size_t len)
+{
+	uint32_t s1 = hash & 0xffff;
+	uint32_t s2 = hash >> 16;
+	adler_sums(&s1, &s2, (const uint8_t*)buf, len);
+	return ((s2 & 0xffff) << 16) | (s1 & 0xffff);
+}
+
+/* CRCs */
+
+typedef uint32_t (*CRCUpdate)(uint32_t crc, const uint8_t* p, size_t len);
+
+static uint32_t crc32_table[8][256];
+static uint32_t crc32c_table[8][256];
+
+static void build_crc_table(uint32_t table[8][256], uint32_t poly)
+{
+	int i, j;
+	for (i = 0; i < 256; i++)
+	{
+		uint32_t crc = (uint32_t)i;
+		for (j = 0; j < 8; j++)
+			crc = (crc >> 1) ^ (poly & (0u - (crc & 1)));
+		table[0][i] = crc;
+	}
+	for (i = 0; i < 256; i++)
+	{
+		for (j = 1; j < 8; j++)
+			table[j][i] = (table[j - 1][i] >> 8) ^ table[0][table[j - 1][i] & 0xff];
+	}
+}
+
+/* Slicing-by-8 for any reflected CRC-32 */
+static uint32_t crc_slice8(uint32_t table[8][256], uint32_t crc, const uint8_t* p, size_t len)
+{
+	crc = ~crc;
+	for (; len >= 8; len -= 8, p += 8)
+	{
+		uint32_t lo = crc ^ read32(p);
+		uint32_t hi = read32(p + 4);
+		crc = table[7][lo & 0xff] ^ table[6][(lo >> 8) & 0xff] ^ table[5][(lo >> 16) & 0xff] ^ table[4][lo >> 24] ^
+		      table[3][hi & 0xff] ^ table[2][(hi >> 8) & 0xff] ^ table[1][(hi >> 16) & 0xff] ^ table[0][hi >> 24];
+	}
+	while (len--)
+		crc = (crc >> 8) ^ table[0][(crc ^ *p++) & 0xff];
+	return ~crc;
+}
+
+static uint32_t crc32c_scalar(uint32_t crc, const uint8_t* p, size_t len)
+{
+	return crc_slice8(crc32c_table, crc, p, len);
+}
+
+#ifdef CHECKSUM_X86
+CHECKSUM_TARGET("sse4.2")
+static uint32_t crc32c_sse42(uint32_t crc, const uint8_t* p, size_t len)
+{
+	crc = ~crc;
+#if defined(_M_X64) || defined(__x86_64__)
+	{
+		uint64_t crc64 = crc;
+		for (; len >= 8; len -= 8, p += 8)
+		{
+			uint64_t word;
+			memcpy(&word, p, 8);
+			crc64 = _mm_crc32_u64(crc64, word);
+		}
+		crc = (uint32_t)crc64;
+	}
+#endif
+	for (; len >= 4; len -= 4, p += 4)
+	{
+		uint32_t word;
+		memcpy(&word, p, 4);
+		crc = _mm_crc32_u32(crc, word);
+	}
+	while (len--)
+		crc = _mm_crc32_u8(crc, *p++);
+	return ~crc;
+}
+#endif
+
+static CRCUpdate crc32c_update = crc32c_scalar;
+
+uint32_t checksum_crc32(uint32_t crc, const void* buf, size_t len)
+{
+	return crc_slice8(crc32_table, crc, (const uint8_t*)buf, len);
+}
+
+uint32_t checksum_crc32c(uint32_t crc, const void* buf, size_t len)
+{
+	return crc32c_update(crc, (const uint8_t*)buf, len);
+}
+
+/* xxHash */
+
+#define PRIME32_1 2654435761u
+#define PRIME32_2 2246822519u
+#define PRIME32_3 3266489917u
+#define PRIME32_4 668265263u
+#define PRIME32_5 374761393u
+
+#define PRIME64_1 11400714785074694791ull
+#define PRIME64_2 14029467366897019727ull
+#define PRIME64_3 1609587929392839161ull
+#define PRIME64_4 9650029242287828579ull
+#define PRIME64_5 2870177450012600261ull
+
+static inline uint32_t xxh32_round(uint32_t acc, uint32_t input)
+{
+	acc += input * PRIME32_2;
+	return rotl32(acc, 13) * PRIME32_1;
+}
+
+uint32_t checksum_xxhash32(const void* buf, size_t len, uint32_t seed)
+{
+	const uint8_t* p = (const uint8_t*)buf;
+	const uint8_t* end = p + len;
+	uint32_t h;
+
+	if (len >= 16)
+	{
+		const uint8_t* limit = end - 16;
+		uint32_t v1 = seed + PRIME32_1 + PRIME32_2;
+		uint32_t v2 = seed + PRIME32_2;
+		uint32_t v3 = seed;
+		uint32_t v4 = seed - PRIME32_1;
+		do
+		{
+			v1 = xxh32_round(v1, read32(p));
+			v2 = xxh32_round(v2, read32(p + 4));
+			v3 = xxh32_round(v3, read32(p + 8));
+			v4 = xxh32_round(v4, read32(p + 12));
+			p += 16;
+		} while (p <= limit);
+		h = rotl32(v1, 1) + rotl32(v2, 7) + rotl32(v3, 12) + rotl32(v4, 18);
+	}
+	else
+		h = seed + PRIME32_5;
+
+	h += (uint32_t)len;
+	for (; p + 4 <= end; p += 4)
+		h = rotl32(h + read32(p) * PRIME32_3, 17) * PRIME32_4;
+	for (; p < end; p++)
+		h = rotl32(h + *p * PRIME32_5, 11) * PRIME32_1;
+
+	h ^= h >> 15;
+	h *= PRIME32_2;
+	h ^= h >> 13;
+	h *= PRIME32_3;
+	h ^= h >> 16;
+	return h;
+}
+
+static inline uint64_t xxh64_round(uint64_t acc, uint64_t input)
+{
+	acc += input * PRIME64_2;
+	return rotl64(acc, 31) * PRIME64_1;
+}
+
+static inline uint64_t xxh64_merge(uint64_t acc, uint64_t v)
+{
+	acc ^= xxh64_round(0, v);
+	return acc * PRIME64_1 + PRIME64_4;
+}
+
+uint64_t checksum_xxhash64(const void* buf, size_t len, uint64_t seed)
+{
+	const uint8_t* p = (const uint8_t*)buf;
+	const uint8_t* end = p + len;
+	uint64_t h;
+
+	if (len >= 32)
+	{
+		const uint8_t* limit = end - 32;
+		uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+		uint64_t v2 = seed + PRIME64_2;
+		uint64_t v3 = seed;
+		uint64_t v4 = seed - PRIME64_1;
+		do
+		{
+			v1 = xxh64_round(v1, read64(p));
+			v2 = xxh64_round(v2, read64(p + 8));
+			v3 = xxh64_round(v3, read64(p + 16));
+			v4 = xxh64_round(v4, read64(p + 24));
+			p += 32;
+		} while (p <= limit);
+		h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+		h = xxh64_merge(h, v1);
+		h = xxh64_merge(h, v2);
+		h = xxh64_merge(h, v3);
+		h = xxh64_merge(h, v4);
+	}
+	else
+		h = seed + PRIME64_5;
+
+	h += (uint64_t)len;
+	for (; p + 8 <= end; p += 8)
+		h = rotl64(h ^ xxh64_round(0, read64(p)), 27) * PRIME64_1 + PRIME64_4;
+	if (p + 4 <= end)
+	{
+		h = rotl64(h ^ ((uint64_t)read32(p) * PRIME64_1), 23) * PRIME64_2 + PRIME64_3;
+		p += 4;
+	}
+	for (; p < end; p++)
+		h = rotl64(h ^ (*p * PRIME64_5), 11) * PRIME64_1;
+
+	h ^= h >> 33;
+	h *= PRIME64_2;
+	h ^= h >> 29;
+	h *= PRIME64_3;
+	h ^= h >> 32;
+	return h;
+}
+
+/* FNV */
+
+uint32_t checksum_fnv_weak(const void* buf, size_t len)
+{
+	const uint8_t* p = (const uint8_t*)buf;
+	uint32_t fnv = 2166136261u;
+	size_t i = 0;
+	for (; i + 4 < len; i += 4)
+	{
+		uint32_t word;
+		memcpy(&word, p + i, 4);
+		fnv ^= word;
+		fnv *= 16777619u;
+	}
+	for (; i < len; i++)
+	{
+		fnv ^= p[i];
+		fnv *= 16777619u;
+	}
+	return fnv;
+}
+
+/* Setup */
+
+#ifdef CHECKSUM_X86
+static void detect_cpu(int* sse42, int* avx2)
+{
+#ifdef _MSC_VER
+	int info[4];
+	int maxLeaf;
+	__cpuid(info, 0);
+	maxLeaf = info[0];
+	__cpuid(info, 1);
+	*sse42 = (info[2] >> 20) & 1;
+	*avx2 = 0;
+	/* AVX state must be enabled by the OS (OSXSAVE and XCR0 bits 1-2) */
+	if (maxLeaf >= 7 && ((info[2] >> 27) & 1) && ((info[2] >> 28) & 1) && (_xgetbv(0) & 6) == 6)
+	{
+		__cpuidex(info, 7, 0);
+		*avx2 = (info[1] >> 5) & 1;
+	}
+#else
+	__builtin_cpu_init();
+	*sse42 = __builtin_cpu_supports("sse4.2");
+	*avx2 = __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+#ifdef _MSC_VER
+static void __cdecl checksum_init(void)
+#else
+static void checksum_init(void)
+#endif
+{
+	build_crc_table(crc32_table, 0xedb88320u);
+	build_crc_table(crc32c_table, 0x82f63b78u);
+#ifdef CHECKSUM_X86
+	{
+		int sse42, avx2;
+		detect_cpu(&sse42, &avx2);
+		if (avx2)
+			adler_sums = adler_sums_avx2;
+		if (sse42)
+			crc32c_update = crc32c_sse42;
+	}
+#endif
+}
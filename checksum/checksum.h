@@ -0,0 +1,39 @@
+#ifndef CHECKSUM_CHECKSUM_H
+#define CHECKSUM_CHECKSUM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Checksums shared by lzham, libxdiff and (through lzhamwrapper) VersionrCore. The Adler and CRC-32C
+   functions use AVX2/SSE4.2 kernels when the CPU has them and portable C otherwise; all results are
+   identical either way. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* zlib Adler-32. Start with 1 and pass the previous result to continue. */
+uint32_t checksum_adler32(uint32_t adler, const void* buf, size_t len);
+
+/* Adler-32 with both sums kept modulo 2^16 instead of 65521, as ChunkedChecksum.FastHash. Start with 1. */
+uint32_t checksum_fast_hash(uint32_t hash, const void* buf, size_t len);
+
+/* CRC-32 (IEEE 802.3, zlib conventions). Start with 0. */
+uint32_t checksum_crc32(uint32_t crc, const void* buf, size_t len);
+
+/* CRC-32C (Castagnoli), as computed by the SSE4.2 crc32 instruction. Start with 0. */
+uint32_t checksum_crc32c(uint32_t crc, const void* buf, size_t len);
+
+/* XXH32 and XXH64. XXH32 matches xxHashSharp.xxHash.CalculateHash. */
+uint32_t checksum_xxhash32(const void* buf, size_t len, uint32_t seed);
+uint64_t checksum_xxhash64(const void* buf, size_t len, uint64_t seed);
+
+/* FNV-1 over native-order 32-bit words while more than 4 bytes remain, then bytes, as
+   Network.Utilities.ComputeChecksumFNVWeak. */
+uint32_t checksum_fnv_weak(const void* buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -30,6 +30,7 @@
 
 #if defined(WIN32) || defined(_WIN32)
 
+#include <windows.h>
 #include <io.h>
 
 #define write _write
@@ -45,6 +46,7 @@
 #else /* #if defined(WIN32) || defined(_WIN32) */
 
 #include <unistd.h>
+#include <sys/mman.h>
 
 #endif /* #if defined(WIN32) || defined(_WIN32) */
 
@@ -129,6 +131,83 @@ int xdlt_load_mmfile(char const *fname, mmfile_t *mf, int binmode) {
 }
 
 
+/*
+ * Maps the file read-only and wraps the mapping in a single read-only block,
+ * so it is diffed straight out of the page cache. Files that cannot be
+ * mapped (empty ones, for instance) are read as xdlt_load_mmfile does.
+ * Release the result with xdlt_free_mmfile.
+ */
+int xdlt_map_mmfile(char const *fname, mmfile_t *mf) {
+	char *ptr;
+	long size;
+#if defined(WIN32) || defined(_WIN32)
+	HANDLE file, mapping;
+	LARGE_INTEGER fsize;
+
+	if ((file = CreateFileA(fname, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+				NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL)) == INVALID_HANDLE_VALUE)
+		return xdlt_load_mmfile(fname, mf, 1);
+	if (!GetFileSizeEx(file, &fsize) || fsize.QuadPart <= 0 || fsize.QuadPart > 0x7fffffff) {
+		CloseHandle(file);
+		return xdlt_load_mmfile(fname, mf, 1);
+	}
+	size = (long) fsize.QuadPart;
+	mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+	if (!mapping)
+		return xdlt_load_mmfile(fname, mf, 1);
+	ptr = (char *) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	if (!ptr)
+		return xdlt_load_mmfile(fname, mf, 1);
+#else
+	int fd;
+	struct stat st;
+	void *map;
+
+	if ((fd = open(fname, O_RDONLY)) == -1)
+		return xdlt_load_mmfile(fname, mf, 1);
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size <= 0 || st.st_size > 0x7fffffff) {
+		close(fd);
+		return xdlt_load_mmfile(fname, mf, 1);
+	}
+	size = (long) st.st_size;
+	map = mmap(NULL, (size_t) size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return xdlt_load_mmfile(fname, mf, 1);
+	ptr = (char *) map;
+#endif
+
+	if (xdl_init_mmfile(mf, XDLT_STD_BLKSIZE, XDL_MMF_ATOMIC) < 0 ||
+	    xdl_mmfile_ptradd(mf, ptr, size, XDL_MMB_READONLY | XDLT_MMB_MAPPED) < 0) {
+#if defined(WIN32) || defined(_WIN32)
+		UnmapViewOfFile(ptr);
+#else
+		munmap(ptr, (size_t) size);
+#endif
+		return -1;
+	}
+
+	return 0;
+}
+
+
+void xdlt_free_mmfile(mmfile_t *mf) {
+	mmblock_t *cur;
+
+	for (cur = mf->head; cur; cur = cur->next)
+		if (cur->flags & XDLT_MMB_MAPPED) {
+#if defined(WIN32) || defined(_WIN32)
+			UnmapViewOfFile(cur->ptr);
+#else
+			munmap(cur->ptr, (size_t) cur->size);
+#endif
+		}
+	xdl_free_mmfile(mf);
+}
+
+
 static int xdlt_mmfile_outf(void *priv, mmbuffer_t *mb, int nbuf) {
 	mmfile_t *mmf = priv;
 
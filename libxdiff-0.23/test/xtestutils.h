@@ -27,10 +27,14 @@
 
 #define DBL_RAND() (((double) rand()) / (1.0 + (double) RAND_MAX))
 
+#define XDLT_MMB_MAPPED (1 << 8)
+
 
 
 int xdlt_dump_mmfile(char const *fname, mmfile_t *mmf);
 int xdlt_load_mmfile(char const *fname, mmfile_t *mf, int binmode);
+int xdlt_map_mmfile(char const *fname, mmfile_t *mf);
+void xdlt_free_mmfile(mmfile_t *mf);
 int xdlt_do_diff(mmfile_t *mf1, mmfile_t *mf2, xpparam_t const *xpp,
 		 xdemitconf_t const *xecfg, mmfile_t *mfp);
 int xdlt_do_patch(mmfile_t *mfo, mmfile_t *mfp, int mode, mmfile_t *mfr);
@@ -21,50 +21,16 @@
  */
 
 #include "xinclude.h"
+#include "../../checksum/checksum.h"
 
 
 
-/* largest prime smaller than 65536 */
-#define BASE 65521L
-
-/* NMAX is the largest n such that 255n(n+1)/2 + (n+1)(BASE-1) <= 2^32-1 */
-#define NMAX 5552
-
-
-#define DO1(buf, i)  { s1 += buf[i]; s2 += s1; }
-#define DO2(buf, i)  DO1(buf, i); DO1(buf, i + 1);
-#define DO4(buf, i)  DO2(buf, i); DO2(buf, i + 2);
-#define DO8(buf, i)  DO4(buf, i); DO4(buf, i + 4);
-#define DO16(buf)    DO8(buf, 0); DO8(buf, 8);
-
-
-
+/* Adler-32 now comes from the shared checksum module, which has SIMD kernels. */
 unsigned long xdl_adler32(unsigned long adler, unsigned char const *buf,
 			  unsigned int len) {
-	int k;
-	unsigned long s1 = adler & 0xffff;
-	unsigned long s2 = (adler >> 16) & 0xffff;
 
 	if (!buf)
 		return 1;
 
-	while (len > 0) {
-		k = len < NMAX ? len :NMAX;
-		len -= k;
-		while (k >= 16) {
-			DO16(buf);
-			buf += 16;
-			k -= 16;
-		}
-		if (k != 0)
-			do {
-				s1 += *buf++;
-				s2 += s1;
-			} while (--k);
-		s1 %= BASE;
-		s2 %= BASE;
-	}
-
-	return (s2 << 16) | s1;
+	return checksum_adler32((uint32_t) adler, buf, len);
 }
-
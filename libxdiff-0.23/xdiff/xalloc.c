@@ -24,7 +24,16 @@
 
 
 
+#if defined(_MSC_VER)
+#define XDL_THREAD_LOCAL __declspec(thread)
+#else
+#define XDL_THREAD_LOCAL __thread
+#endif
+
+
+
 static memallocator_t xmalt = {NULL, NULL, NULL};
+static XDL_THREAD_LOCAL memallocator_t const *xtmalt = NULL;
 
 
 
@@ -34,18 +43,34 @@ int xdl_set_allocator(memallocator_t const *malt) {
 }
 
 
+/*
+ * Overrides the global allocator for the calling thread until it is reset
+ * with NULL. The allocator is used by reference and must stay valid meanwhile.
+ */
+int xdl_set_thread_allocator(memallocator_t const *malt) {
+	xtmalt = malt;
+	return 0;
+}
+
+
 void *xdl_malloc(unsigned int size) {
-	return xmalt.malloc ? xmalt.malloc(xmalt.priv, size): NULL;
+	memallocator_t const *malt = xtmalt ? xtmalt: &xmalt;
+
+	return malt->malloc ? malt->malloc(malt->priv, size): NULL;
 }
 
 
 void xdl_free(void *ptr) {
-	if (xmalt.free)
-		xmalt.free(xmalt.priv, ptr);
+	memallocator_t const *malt = xtmalt ? xtmalt: &xmalt;
+
+	if (malt->free)
+		malt->free(malt->priv, ptr);
 }
 
 
 void *xdl_realloc(void *ptr, unsigned int size) {
-	return xmalt.realloc ? xmalt.realloc(xmalt.priv, ptr, size): NULL;
+	memallocator_t const *malt = xtmalt ? xtmalt: &xmalt;
+
+	return malt->realloc ? malt->realloc(malt->priv, ptr, size): NULL;
 }
 
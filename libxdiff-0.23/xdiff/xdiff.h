@@ -29,6 +29,8 @@ extern "C" {
 
 
 #define XDF_NEED_MINIMAL (1 << 1)
+#define XDF_PATIENCE_DIFF (1 << 2)
+#define XDF_HISTOGRAM_DIFF (1 << 3)
 
 #define XDL_PATCH_NORMAL '-'
 #define XDL_PATCH_REVERSE '+'
@@ -39,6 +41,8 @@ extern "C" {
 
 #define XDL_MMF_ATOMIC (1 << 0)
 
+#define XDL_MERGE_DIFF3 (1 << 0)
+
 #define XDL_BDOP_INS 1
 #define XDL_BDOP_CPY 2
 #define XDL_BDOP_INSB 3
@@ -88,8 +92,27 @@ typedef struct s_bdiffparam {
 	long bsize;
 } bdiffparam_t;
 
+typedef struct s_xmparam {
+	xpparam_t xpp;
+	unsigned long flags;
+	char const *name1, *name2, *nameo;
+} xmparam_t;
+
+typedef struct s_xmconflict {
+	long io, chgo;
+	long i1, chg1;
+	long i2, chg2;
+	long ir, chgr;
+} xmconflict_t;
+
+typedef struct s_xmconflictcb {
+	void *priv;
+	int (*conflictf)(void *, xmconflict_t const *);
+} xmconflictcb_t;
+
 
 int xdl_set_allocator(memallocator_t const *malt);
+int xdl_set_thread_allocator(memallocator_t const *malt);
 void *xdl_malloc(unsigned int size);
 void xdl_free(void *ptr);
 void *xdl_realloc(void *ptr, unsigned int size);
@@ -115,8 +138,10 @@ int xdl_diff(mmfile_t *mf1, mmfile_t *mf2, xpparam_t const *xpp,
 int xdl_patch(mmfile_t *mf, mmfile_t *mfp, int mode, xdemitcb_t *ecb,
 	      xdemitcb_t *rjecb);
 
-int xdl_merge3(mmfile_t *mmfo, mmfile_t *mmf1, mmfile_t *mmf2, xdemitcb_t *ecb,
-	       xdemitcb_t *rjecb);
+int xdl_merge3(mmfile_t *mmfo, mmfile_t *mmf1, mmfile_t *mmf2, xpparam_t const *xpp,
+	       xdemitcb_t *ecb, xdemitcb_t *rjecb);
+int xdl_diff3(mmfile_t *mmfo, mmfile_t *mmf1, mmfile_t *mmf2, xmparam_t const *xmp,
+	      xdemitcb_t *ecb, xmconflictcb_t *ccb);
 
 int xdl_bdiff_mb(mmbuffer_t *mmb1, mmbuffer_t *mmb2, bdiffparam_t const *bdp, xdemitcb_t *ecb);
 int xdl_bdiff(mmfile_t *mmf1, mmfile_t *mmf2, bdiffparam_t const *bdp, xdemitcb_t *ecb);
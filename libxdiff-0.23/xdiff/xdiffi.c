@@ -318,6 +318,8 @@ int xdl_do_diff(mmfile_t *mf1, mmfile_t *mf2, xpparam_t const *xpp,
 	long *kvd, *kvdf, *kvdb;
 	xdalgoenv_t xenv;
 	diffdata_t dd1, dd2;
+	int (*cmp)(diffdata_t *, long, long, diffdata_t *, long, long,
+		   long *, long *, int, xdalgoenv_t *);
 
 	if (xdl_prepare_env(mf1, mf2, xpp, xe) < 0) {
 
@@ -354,8 +356,19 @@ int xdl_do_diff(mmfile_t *mf1, mmfile_t *mf2, xpparam_t const *xpp,
 	dd2.rchg = xe->xdf2.rchg;
 	dd2.rindex = xe->xdf2.rindex;
 
-	if (xdl_recs_cmp(&dd1, 0, dd1.nrec, &dd2, 0, dd2.nrec,
-			 kvdf, kvdb, (xpp->flags & XDF_NEED_MINIMAL) != 0, &xenv) < 0) {
+	/*
+	 * Patience and histogram only pick anchors, every box they cannot anchor
+	 * is still handed to xdl_recs_cmp().
+	 */
+	if (xpp->flags & XDF_PATIENCE_DIFF)
+		cmp = xdl_patience_cmp;
+	else if (xpp->flags & XDF_HISTOGRAM_DIFF)
+		cmp = xdl_histogram_cmp;
+	else
+		cmp = xdl_recs_cmp;
+
+	if (cmp(&dd1, 0, dd1.nrec, &dd2, 0, dd2.nrec,
+		kvdf, kvdb, (xpp->flags & XDF_NEED_MINIMAL) != 0, &xenv) < 0) {
 
 		xdl_free(kvd);
 		xdl_free_env(xe);
@@ -384,7 +397,7 @@ static xdchange_t *xdl_add_change(xdchange_t *xscr, long i1, long i2, long chg1,
 }
 
 
-static int xdl_change_compact(xdfile_t *xdf, xdfile_t *xdfo) {
+int xdl_change_compact(xdfile_t *xdf, xdfile_t *xdfo) {
 	long ix, ixo, ixs, ixref, grpsiz, nrec = xdf->nrec;
 	char *rchg = xdf->rchg, *rchgo = xdfo->rchg;
 	xrecord_t **recs = xdf->recs;
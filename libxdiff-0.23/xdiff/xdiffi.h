@@ -48,8 +48,15 @@ typedef struct s_xdchange {
 int xdl_recs_cmp(diffdata_t *dd1, long off1, long lim1,
 		 diffdata_t *dd2, long off2, long lim2,
 		 long *kvdf, long *kvdb, int need_min, xdalgoenv_t *xenv);
+int xdl_patience_cmp(diffdata_t *dd1, long off1, long lim1,
+		     diffdata_t *dd2, long off2, long lim2,
+		     long *kvdf, long *kvdb, int need_min, xdalgoenv_t *xenv);
+int xdl_histogram_cmp(diffdata_t *dd1, long off1, long lim1,
+		      diffdata_t *dd2, long off2, long lim2,
+		      long *kvdf, long *kvdb, int need_min, xdalgoenv_t *xenv);
 int xdl_do_diff(mmfile_t *mf1, mmfile_t *mf2, xpparam_t const *xpp,
 		xdfenv_t *xe);
+int xdl_change_compact(xdfile_t *xdf, xdfile_t *xdfo);
 int xdl_build_script(xdfenv_t *xe, xdchange_t **xscr);
 void xdl_free_script(xdchange_t *xscr);
 int xdl_emit_diff(xdfenv_t *xe, xdchange_t *xscr, xdemitcb_t *ecb,
@@ -0,0 +1,180 @@
+/*
+ *  LibXDiff by Davide Libenzi ( File Differential Library )
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "xinclude.h"
+
+
+
+#define XDL_HIST_MAX_CHAIN 64
+
+
+
+typedef struct s_xdhentry {
+	unsigned long ha;
+	long head;
+	long cnt;
+	long next;
+} xdhentry_t;
+
+typedef struct s_xdhregion {
+	long s1, e1;
+	long s2, e2;
+} xdhregion_t;
+
+
+
+/*
+ * Finds the longest common region of the box whose rarest record occurs the
+ * fewest times in the first file. Records that occur more often than
+ * XDL_HIST_MAX_CHAIN are never used as a starting point, which keeps the scan
+ * close to linear on repetitive input. Returns 1 if a region was found, 0 if
+ * the box should be left to the Myers algorithm, or -1 on allocation failure.
+ */
+static int xdl_histogram_lcs(unsigned long const *ha1, long off1, long lim1,
+			     unsigned long const *ha2, long off2, long lim2,
+			     xdhregion_t *lcs) {
+	long i, e, b, bnext, hsize, nent = 0, lowcnt = XDL_HIST_MAX_CHAIN + 1;
+	unsigned int hbits;
+	long *hbuck, *chain, *aent;
+	xdhentry_t *ent;
+
+	hbits = xdl_hashbits((unsigned int) (lim1 - off1));
+	hsize = 1L << hbits;
+	if (!(hbuck = (long *) xdl_malloc((hsize + 2 * (lim1 - off1)) * sizeof(long)))) {
+
+		return -1;
+	}
+	if (!(ent = (xdhentry_t *) xdl_malloc((lim1 - off1) * sizeof(xdhentry_t)))) {
+
+		xdl_free(hbuck);
+		return -1;
+	}
+	chain = hbuck + hsize;
+	aent = chain + (lim1 - off1);
+	for (i = 0; i < hsize; i++)
+		hbuck[i] = -1;
+
+	/*
+	 * Scan backward so that every chain lists its positions in ascending order.
+	 */
+	for (i = lim1 - 1; i >= off1; i--) {
+		long hi = (long) XDL_HASHLONG(ha1[i], hbits);
+
+		for (e = hbuck[hi]; e >= 0 && ent[e].ha != ha1[i]; e = ent[e].next);
+		if (e < 0) {
+			e = nent++;
+			ent[e].ha = ha1[i];
+			ent[e].head = -1;
+			ent[e].cnt = 0;
+			ent[e].next = hbuck[hi];
+			hbuck[hi] = e;
+		}
+		chain[i - off1] = ent[e].head;
+		ent[e].head = i;
+		ent[e].cnt++;
+		aent[i - off1] = e;
+	}
+
+	for (b = off2; b < lim2; b = bnext) {
+		long a, hi = (long) XDL_HASHLONG(ha2[b], hbits);
+
+		bnext = b + 1;
+		for (e = hbuck[hi]; e >= 0 && ent[e].ha != ha2[b]; e = ent[e].next);
+		if (e < 0 || ent[e].cnt > lowcnt || ent[e].cnt > XDL_HIST_MAX_CHAIN)
+			continue;
+
+		for (a = ent[e].head; a >= 0;) {
+			long s1 = a, e1 = a + 1, s2 = b, e2 = b + 1, rc = ent[e].cnt;
+
+			for (; s1 > off1 && s2 > off2 && ha1[s1 - 1] == ha2[s2 - 1]; s1--, s2--)
+				if (rc > ent[aent[s1 - 1 - off1]].cnt)
+					rc = ent[aent[s1 - 1 - off1]].cnt;
+			for (; e1 < lim1 && e2 < lim2 && ha1[e1] == ha2[e2]; e1++, e2++)
+				if (rc > ent[aent[e1 - off1]].cnt)
+					rc = ent[aent[e1 - off1]].cnt;
+
+			if (bnext < e2)
+				bnext = e2;
+			if (rc < lowcnt || (rc == lowcnt && lcs->e1 - lcs->s1 < e1 - s1)) {
+				lcs->s1 = s1;
+				lcs->e1 = e1;
+				lcs->s2 = s2;
+				lcs->e2 = e2;
+				lowcnt = rc;
+			}
+
+			/*
+			 * Positions inside the region just found would only find a
+			 * shorter piece of it.
+			 */
+			for (a = chain[a - off1]; a >= 0 && a < e1; a = chain[a - off1]);
+		}
+	}
+
+	xdl_free(ent);
+	xdl_free(hbuck);
+
+	return lowcnt <= XDL_HIST_MAX_CHAIN;
+}
+
+
+/*
+ * See the histogram diff of JGit. Splits the box around the longest region
+ * built on its least frequent common records, so that unique lines like
+ * function signatures anchor the result the same way they do with patience
+ * diff, while repeated ones still contribute matches. Boxes with no usable
+ * region fall back to the Myers algorithm.
+ */
+int xdl_histogram_cmp(diffdata_t *dd1, long off1, long lim1,
+		      diffdata_t *dd2, long off2, long lim2,
+		      long *kvdf, long *kvdb, int need_min, xdalgoenv_t *xenv) {
+	unsigned long const *ha1 = dd1->ha, *ha2 = dd2->ha;
+	int ret;
+	xdhregion_t lcs;
+
+	for (;;) {
+		for (; off1 < lim1 && off2 < lim2 && ha1[off1] == ha2[off2]; off1++, off2++);
+		for (; off1 < lim1 && off2 < lim2 && ha1[lim1 - 1] == ha2[lim2 - 1]; lim1--, lim2--);
+
+		if (off1 == lim1 || off2 == lim2)
+			break;
+
+		lcs.s1 = lcs.e1 = off1;
+		lcs.s2 = lcs.e2 = off2;
+		if ((ret = xdl_histogram_lcs(ha1, off1, lim1, ha2, off2, lim2, &lcs)) < 0)
+			return -1;
+		if (ret == 0)
+			break;
+
+		/*
+		 * Recurse on the left box and iterate on the right one.
+		 */
+		if (xdl_histogram_cmp(dd1, off1, lcs.s1, dd2, off2, lcs.s2,
+				      kvdf, kvdb, need_min, xenv) < 0) {
+
+			return -1;
+		}
+		off1 = lcs.e1;
+		off2 = lcs.e2;
+	}
+
+	return xdl_recs_cmp(dd1, off1, lim1, dd2, off2, lim2,
+			    kvdf, kvdb, need_min, xenv);
+}
+
@@ -28,9 +28,8 @@
 
 
 
-int xdl_merge3(mmfile_t *mmfo, mmfile_t *mmf1, mmfile_t *mmf2, xdemitcb_t *ecb,
-	       xdemitcb_t *rjecb) {
-	xpparam_t xpp;
+int xdl_merge3(mmfile_t *mmfo, mmfile_t *mmf1, mmfile_t *mmf2, xpparam_t const *xpp,
+	       xdemitcb_t *ecb, xdemitcb_t *rjecb) {
 	xdemitconf_t xecfg;
 	xdemitcb_t xecb;
 	mmfile_t mmfp;
@@ -40,14 +39,12 @@ int xdl_merge3(mmfile_t *mmfo, mmfile_t *mmf1, mmfile_t *mmf2, xdemitcb_t *ecb,
 		return -1;
 	}
 
-	xpp.flags = 0;
-
 	xecfg.ctxlen = XDL_MERGE3_CTXLEN;
 
 	xecb.priv = &mmfp;
 	xecb.outf = xdl_mmfile_outf;
 
-	if (xdl_diff(mmfo, mmf2, &xpp, &xecfg, &xecb) < 0) {
+	if (xdl_diff(mmfo, mmf2, xpp, &xecfg, &xecb) < 0) {
 
 		xdl_free_mmfile(&mmfp);
 		return -1;
@@ -64,3 +61,234 @@ int xdl_merge3(mmfile_t *mmfo, mmfile_t *mmf1, mmfile_t *mmf2, xdemitcb_t *ecb,
 	return 0;
 }
 
+
+
+
+typedef struct s_xdmside {
+	xdfenv_t xe;
+	xdchange_t *xscr, *cur;
+	long delta;
+} xdmside_t;
+
+typedef struct s_xdmout {
+	xdemitcb_t *ecb;
+	long nrec;
+	int eol;
+} xdmout_t;
+
+
+
+static int xdl_diff3_side(mmfile_t *mmfo, mmfile_t *mmf, xpparam_t const *xpp,
+			  xdmside_t *xms) {
+
+	if (xdl_do_diff(mmfo, mmf, xpp, &xms->xe) < 0) {
+
+		return -1;
+	}
+	if (xdl_change_compact(&xms->xe.xdf1, &xms->xe.xdf2) < 0 ||
+	    xdl_change_compact(&xms->xe.xdf2, &xms->xe.xdf1) < 0 ||
+	    xdl_build_script(&xms->xe, &xms->xscr) < 0) {
+
+		xdl_free_env(&xms->xe);
+		return -1;
+	}
+	xms->cur = xms->xscr;
+	xms->delta = 0;
+
+	return 0;
+}
+
+
+static void xdl_diff3_free(xdmside_t *xms) {
+
+	xdl_free_script(xms->xscr);
+	xdl_free_env(&xms->xe);
+}
+
+
+/*
+ * Emits records [s, e) of the file, handing runs that are contiguous in
+ * memory to the callback as a single buffer.
+ */
+static int xdl_diff3_emit(xdfile_t *xdf, long s, long e, xdmout_t *xmo) {
+	xrecord_t **recs = xdf->recs;
+	mmbuffer_t mb;
+
+	if (s >= e)
+		return 0;
+	xmo->nrec += e - s;
+	xmo->eol = recs[e - 1]->ptr[recs[e - 1]->size - 1] == '\n';
+	while (s < e) {
+		mb.ptr = (char *) recs[s]->ptr;
+		mb.size = recs[s]->size;
+		for (s++; s < e && recs[s]->ptr == mb.ptr + mb.size; s++)
+			mb.size += recs[s]->size;
+		if (xmo->ecb->outf(xmo->ecb->priv, &mb, 1) < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+
+/*
+ * Emits a conflict marker line, first terminating the previous record if it
+ * was the last one of a file without a final newline.
+ */
+static int xdl_diff3_marker(char const *marker, char const *name, xdmout_t *xmo) {
+	int nbuf = 0;
+	mmbuffer_t mb[5];
+
+	if (!xmo->eol) {
+		mb[nbuf].ptr = (char *) "\n";
+		mb[nbuf++].size = 1;
+	}
+	mb[nbuf].ptr = (char *) marker;
+	mb[nbuf++].size = 7;
+	if (name) {
+		mb[nbuf].ptr = (char *) " ";
+		mb[nbuf++].size = 1;
+		mb[nbuf].ptr = (char *) name;
+		mb[nbuf++].size = (long) strlen(name);
+	}
+	mb[nbuf].ptr = (char *) "\n";
+	mb[nbuf++].size = 1;
+	xmo->nrec++;
+	xmo->eol = 1;
+
+	return xmo->ecb->outf(xmo->ecb->priv, mb, nbuf) < 0 ? -1: 0;
+}
+
+
+/*
+ * Three way merge in the style of diff3. Both edit scripts against the base
+ * are walked together: hunks whose base ranges overlap or touch form a
+ * region, which takes the only side that changed it, the common result if
+ * both sides changed it the same way, and a conflict otherwise. Lines that
+ * both sides agree on at the edges of a conflict are merged. Conflicts are
+ * written with markers and reported through "ccb" (if not NULL), with the
+ * record ranges of the base, both files and the merged output. Returns the
+ * number of conflicts, or -1 on error.
+ */
+int xdl_diff3(mmfile_t *mmfo, mmfile_t *mmf1, mmfile_t *mmf2, xmparam_t const *xmp,
+	      xdemitcb_t *ecb, xmconflictcb_t *ccb) {
+	int chg1, chg2;
+	long start, end, s1, e1, s2, e2, pos, edge, nconf = 0;
+	xdfile_t *xdfo, *xdf1, *xdf2;
+	xdchange_t *xch;
+	xdmside_t xms1, xms2;
+	xdmout_t xmo;
+	xmconflict_t xmc;
+
+	if (xdl_diff3_side(mmfo, mmf1, &xmp->xpp, &xms1) < 0) {
+
+		return -1;
+	}
+	if (xdl_diff3_side(mmfo, mmf2, &xmp->xpp, &xms2) < 0) {
+
+		xdl_diff3_free(&xms1);
+		return -1;
+	}
+	xdfo = &xms1.xe.xdf1;
+	xdf1 = &xms1.xe.xdf2;
+	xdf2 = &xms2.xe.xdf2;
+	xmo.ecb = ecb;
+	xmo.nrec = 0;
+	xmo.eol = 1;
+
+	for (pos = 0; xms1.cur || xms2.cur; pos = end) {
+		/*
+		 * Grow the region from the first pending hunk until no hunk of
+		 * either side starts inside it or right at its end.
+		 */
+		if (!xms2.cur || (xms1.cur && xms1.cur->i1 <= xms2.cur->i1))
+			start = xms1.cur->i1;
+		else
+			start = xms2.cur->i1;
+		s1 = start + xms1.delta;
+		s2 = start + xms2.delta;
+		for (end = start, chg1 = chg2 = 0;;) {
+			if ((xch = xms1.cur) != NULL && xch->i1 <= end) {
+				xms1.delta = xch->i2 + xch->chg2 - (xch->i1 + xch->chg1);
+				xms1.cur = xch->next;
+				chg1 = 1;
+			} else if ((xch = xms2.cur) != NULL && xch->i1 <= end) {
+				xms2.delta = xch->i2 + xch->chg2 - (xch->i1 + xch->chg1);
+				xms2.cur = xch->next;
+				chg2 = 1;
+			} else
+				break;
+			if (end < xch->i1 + xch->chg1)
+				end = xch->i1 + xch->chg1;
+		}
+		e1 = end + xms1.delta;
+		e2 = end + xms2.delta;
+
+		if (xdl_diff3_emit(xdfo, pos, start, &xmo) < 0)
+			goto fail;
+		if (!chg2) {
+			if (xdl_diff3_emit(xdf1, s1, e1, &xmo) < 0)
+				goto fail;
+			continue;
+		}
+		if (!chg1) {
+			if (xdl_diff3_emit(xdf2, s2, e2, &xmo) < 0)
+				goto fail;
+			continue;
+		}
+
+		/*
+		 * Both sides changed the region. Whatever they agree on at its
+		 * edges is merged, and if that is all of it there is no conflict.
+		 */
+		for (edge = s1; s1 < e1 && s2 < e2 &&
+			     XDL_RECMATCH(xdf1->recs[s1], xdf2->recs[s2]); s1++, s2++);
+		if (xdl_diff3_emit(xdf1, edge, s1, &xmo) < 0)
+			goto fail;
+		for (edge = e1; s1 < e1 && s2 < e2 &&
+			     XDL_RECMATCH(xdf1->recs[e1 - 1], xdf2->recs[e2 - 1]); e1--, e2--);
+		if (s1 == e1 && s2 == e2) {
+			if (xdl_diff3_emit(xdf1, e1, edge, &xmo) < 0)
+				goto fail;
+			continue;
+		}
+
+		xmc.io = start;
+		xmc.chgo = end - start;
+		xmc.i1 = s1;
+		xmc.chg1 = e1 - s1;
+		xmc.i2 = s2;
+		xmc.chg2 = e2 - s2;
+		xmc.ir = xmo.nrec;
+		if (xdl_diff3_marker("<<<<<<<", xmp->name1, &xmo) < 0 ||
+		    xdl_diff3_emit(xdf1, s1, e1, &xmo) < 0 ||
+		    ((xmp->flags & XDL_MERGE_DIFF3) &&
+		     (xdl_diff3_marker("|||||||", xmp->nameo, &xmo) < 0 ||
+		      xdl_diff3_emit(xdfo, start, end, &xmo) < 0)) ||
+		    xdl_diff3_marker("=======", NULL, &xmo) < 0 ||
+		    xdl_diff3_emit(xdf2, s2, e2, &xmo) < 0 ||
+		    xdl_diff3_marker(">>>>>>>", xmp->name2, &xmo) < 0) {
+
+			goto fail;
+		}
+		xmc.chgr = xmo.nrec - xmc.ir;
+		if (ccb && ccb->conflictf(ccb->priv, &xmc) < 0)
+			goto fail;
+		nconf++;
+
+		if (xdl_diff3_emit(xdf1, e1, edge, &xmo) < 0)
+			goto fail;
+	}
+	if (xdl_diff3_emit(xdfo, pos, xdfo->nrec, &xmo) < 0)
+		goto fail;
+
+	xdl_diff3_free(&xms2);
+	xdl_diff3_free(&xms1);
+
+	return nconf;
+
+fail:
+	xdl_diff3_free(&xms2);
+	xdl_diff3_free(&xms1);
+	return -1;
+}
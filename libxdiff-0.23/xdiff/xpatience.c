@@ -0,0 +1,207 @@
+/*
+ *  LibXDiff by Davide Libenzi ( File Differential Library )
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "xinclude.h"
+
+
+
+typedef struct s_xdpentry {
+	unsigned long ha;
+	long line1, line2;
+	long cnt1, cnt2;
+	long next;
+} xdpentry_t;
+
+typedef struct s_xdpanchor {
+	long i1, i2;
+} xdpanchor_t;
+
+
+
+/*
+ * Collects the records that appear exactly once in both the boxes, in the
+ * order they appear in the first one. Since the class indexes stored in "ha"
+ * are already unique per record content, the hash table does not need to
+ * look at the record data. Returns the number of records found, or -1 on
+ * allocation failure.
+ */
+static long xdl_patience_uniq(unsigned long const *ha1, long off1, long lim1,
+			      unsigned long const *ha2, long off2, long lim2,
+			      xdpanchor_t *uniq) {
+	long i, e, n, hsize, nent = 0;
+	unsigned int hbits;
+	long *hbuck;
+	xdpentry_t *ent;
+
+	hbits = xdl_hashbits((unsigned int) (lim1 - off1));
+	hsize = 1L << hbits;
+	if (!(hbuck = (long *) xdl_malloc(hsize * sizeof(long)))) {
+
+		return -1;
+	}
+	if (!(ent = (xdpentry_t *) xdl_malloc((lim1 - off1) * sizeof(xdpentry_t)))) {
+
+		xdl_free(hbuck);
+		return -1;
+	}
+	for (i = 0; i < hsize; i++)
+		hbuck[i] = -1;
+
+	for (i = off1; i < lim1; i++) {
+		long hi = (long) XDL_HASHLONG(ha1[i], hbits);
+
+		for (e = hbuck[hi]; e >= 0 && ent[e].ha != ha1[i]; e = ent[e].next);
+		if (e < 0) {
+			e = nent++;
+			ent[e].ha = ha1[i];
+			ent[e].line1 = i;
+			ent[e].line2 = -1;
+			ent[e].cnt1 = 0;
+			ent[e].cnt2 = 0;
+			ent[e].next = hbuck[hi];
+			hbuck[hi] = e;
+		}
+		ent[e].cnt1++;
+	}
+	for (i = off2; i < lim2; i++) {
+		long hi = (long) XDL_HASHLONG(ha2[i], hbits);
+
+		for (e = hbuck[hi]; e >= 0 && ent[e].ha != ha2[i]; e = ent[e].next);
+		if (e >= 0) {
+			ent[e].line2 = i;
+			ent[e].cnt2++;
+		}
+	}
+
+	/*
+	 * Entries were created in first-appearance order, which for the records
+	 * that appear once is also their order inside the first box.
+	 */
+	for (e = 0, n = 0; e < nent; e++)
+		if (ent[e].cnt1 == 1 && ent[e].cnt2 == 1) {
+			uniq[n].i1 = ent[e].line1;
+			uniq[n].i2 = ent[e].line2;
+			n++;
+		}
+
+	xdl_free(ent);
+	xdl_free(hbuck);
+
+	return n;
+}
+
+
+/*
+ * Reduces the unique records to the longest subsequence that is increasing
+ * in both files (patience sorting), compacting it in place at the start of
+ * the array. Returns the length of the subsequence.
+ */
+static long xdl_patience_lis(xdpanchor_t *uniq, long n) {
+	long i, lo, hi, mid, len = 0, *tails, *prev;
+
+	if (!(tails = (long *) xdl_malloc(2 * n * sizeof(long)))) {
+
+		return -1;
+	}
+	prev = tails + n;
+	for (i = 0; i < n; i++) {
+		for (lo = 0, hi = len; lo < hi;) {
+			mid = (lo + hi) / 2;
+			if (uniq[tails[mid]].i2 < uniq[i].i2)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		prev[i] = lo > 0 ? tails[lo - 1]: -1;
+		tails[lo] = i;
+		if (lo == len)
+			len++;
+	}
+
+	/*
+	 * Walk the chain backward from the last pile, then copy it forward. Chain
+	 * indexes are increasing and never smaller than their slot, so the copy
+	 * never reads an element it already overwrote.
+	 */
+	if (len > 0)
+		for (i = tails[len - 1], hi = len - 1; i >= 0; i = prev[i], hi--)
+			tails[hi] = i;
+	for (i = 0; i < len; i++)
+		uniq[i] = uniq[tails[i]];
+
+	xdl_free(tails);
+
+	return len;
+}
+
+
+/*
+ * Anchors the box on the records that are unique in both sides and keep
+ * their relative order, then recurses into the gaps between anchors. Boxes
+ * that do not have any such record are left to the Myers algorithm.
+ */
+int xdl_patience_cmp(diffdata_t *dd1, long off1, long lim1,
+		     diffdata_t *dd2, long off2, long lim2,
+		     long *kvdf, long *kvdb, int need_min, xdalgoenv_t *xenv) {
+	unsigned long const *ha1 = dd1->ha, *ha2 = dd2->ha;
+	long i, n, p1, p2;
+	xdpanchor_t *uniq;
+
+	for (; off1 < lim1 && off2 < lim2 && ha1[off1] == ha2[off2]; off1++, off2++);
+	for (; off1 < lim1 && off2 < lim2 && ha1[lim1 - 1] == ha2[lim2 - 1]; lim1--, lim2--);
+
+	if (off1 == lim1 || off2 == lim2)
+		return xdl_recs_cmp(dd1, off1, lim1, dd2, off2, lim2,
+				    kvdf, kvdb, need_min, xenv);
+
+	if (!(uniq = (xdpanchor_t *) xdl_malloc((lim1 - off1) * sizeof(xdpanchor_t)))) {
+
+		return -1;
+	}
+	if ((n = xdl_patience_uniq(ha1, off1, lim1, ha2, off2, lim2, uniq)) < 0 ||
+	    (n > 0 && (n = xdl_patience_lis(uniq, n)) < 0)) {
+
+		xdl_free(uniq);
+		return -1;
+	}
+	if (n == 0) {
+		xdl_free(uniq);
+		return xdl_recs_cmp(dd1, off1, lim1, dd2, off2, lim2,
+				    kvdf, kvdb, need_min, xenv);
+	}
+
+	for (i = 0, p1 = off1, p2 = off2; i <= n; i++) {
+		long e1 = i < n ? uniq[i].i1: lim1;
+		long e2 = i < n ? uniq[i].i2: lim2;
+
+		if (xdl_patience_cmp(dd1, p1, e1, dd2, p2, e2,
+				     kvdf, kvdb, need_min, xenv) < 0) {
+
+			xdl_free(uniq);
+			return -1;
+		}
+		p1 = e1 + 1;
+		p2 = e2 + 1;
+	}
+
+	xdl_free(uniq);
+
+	return 0;
+}
+
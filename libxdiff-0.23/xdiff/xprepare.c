@@ -303,16 +303,30 @@ static int xdl_clean_mmatch(char const *dis, long i, long s, long e) {
  * Try to reduce the problem complexity, discard records that have no
  * matches on the other file. Also, lines that have multiple matches
  * might be potentially discarded if they happear in a run of discardable.
+ * Matches are counted once per class, since walking the hash chains for
+ * every record is quadratic on files made of a few very common lines.
  */
-static int xdl_cleanup_records(xdfile_t *xdf1, xdfile_t *xdf2) {
-	long i, nm, rhi, nreff, mlim;
-	unsigned long hav;
+static int xdl_cleanup_records(xdfile_t *xdf1, xdfile_t *xdf2, long nclass) {
+	long i, nm, nreff, mlim;
+	long *cnt, *cnt1, *cnt2;
 	xrecord_t **recs;
-	xrecord_t *rec;
 	char *dis, *dis1, *dis2;
 
+	if (!(cnt = (long *) xdl_malloc(2 * nclass * sizeof(long)))) {
+
+		return -1;
+	}
+	memset(cnt, 0, 2 * nclass * sizeof(long));
+	cnt1 = cnt;
+	cnt2 = cnt1 + nclass;
+	for (i = 0, recs = xdf1->recs; i < xdf1->nrec; i++, recs++)
+		cnt1[(*recs)->ha]++;
+	for (i = 0, recs = xdf2->recs; i < xdf2->nrec; i++, recs++)
+		cnt2[(*recs)->ha]++;
+
 	if (!(dis = (char *) xdl_malloc(xdf1->nrec + xdf2->nrec + 2))) {
 
+		xdl_free(cnt);
 		return -1;
 	}
 	memset(dis, 0, xdf1->nrec + xdf2->nrec + 2);
@@ -322,22 +336,14 @@ static int xdl_cleanup_records(xdfile_t *xdf1, xdfile_t *xdf2) {
 	if ((mlim = xdl_bogosqrt(xdf1->nrec)) > XDL_MAX_EQLIMIT)
 		mlim = XDL_MAX_EQLIMIT;
 	for (i = xdf1->dstart, recs = &xdf1->recs[xdf1->dstart]; i <= xdf1->dend; i++, recs++) {
-		hav = (*recs)->ha;
-		rhi = (long) XDL_HASHLONG(hav, xdf2->hbits);
-		for (nm = 0, rec = xdf2->rhash[rhi]; rec; rec = rec->next)
-			if (rec->ha == hav && ++nm == mlim)
-				break;
+		nm = cnt2[(*recs)->ha];
 		dis1[i] = (nm == 0) ? 0: (nm >= mlim) ? 2: 1;
 	}
 
 	if ((mlim = xdl_bogosqrt(xdf2->nrec)) > XDL_MAX_EQLIMIT)
 		mlim = XDL_MAX_EQLIMIT;
 	for (i = xdf2->dstart, recs = &xdf2->recs[xdf2->dstart]; i <= xdf2->dend; i++, recs++) {
-		hav = (*recs)->ha;
-		rhi = (long) XDL_HASHLONG(hav, xdf1->hbits);
-		for (nm = 0, rec = xdf1->rhash[rhi]; rec; rec = rec->next)
-			if (rec->ha == hav && ++nm == mlim)
-				break;
+		nm = cnt1[(*recs)->ha];
 		dis2[i] = (nm == 0) ? 0: (nm >= mlim) ? 2: 1;
 	}
 
@@ -366,6 +372,7 @@ static int xdl_cleanup_records(xdfile_t *xdf1, xdfile_t *xdf2) {
 	xdf2->nreff = nreff;
 
 	xdl_free(dis);
+	xdl_free(cnt);
 
 	return 0;
 }
@@ -400,9 +407,9 @@ static int xdl_trim_ends(xdfile_t *xdf1, xdfile_t *xdf2) {
 }
 
 
-static int xdl_optimize_ctxs(xdfile_t *xdf1, xdfile_t *xdf2) {
+static int xdl_optimize_ctxs(xdfile_t *xdf1, xdfile_t *xdf2, long nclass) {
 	if (xdl_trim_ends(xdf1, xdf2) < 0 ||
-	    xdl_cleanup_records(xdf1, xdf2) < 0) {
+	    xdl_cleanup_records(xdf1, xdf2, nclass) < 0) {
 
 		return -1;
 	}
@@ -438,7 +445,7 @@ int xdl_prepare_env(mmfile_t *mf1, mmfile_t *mf2, xpparam_t const *xpp,
 
 	xdl_free_classifier(&cf);
 
-	if (xdl_optimize_ctxs(&xe->xdf1, &xe->xdf2) < 0) {
+	if (xdl_optimize_ctxs(&xe->xdf1, &xe->xdf2, cf.count) < 0) {
 
 		xdl_free_ctx(&xe->xdf2);
 		xdl_free_ctx(&xe->xdf1);
@@ -51,6 +51,7 @@ extern "C" {
    typedef unsigned char   lzham_uint8;
    typedef signed int      lzham_int32;
    typedef unsigned int    lzham_uint32;
+   typedef unsigned long long lzham_uint64;
    typedef unsigned int    lzham_bool;
 
    // Returns DLL version (LZHAM_DLL_VERSION).
@@ -130,6 +131,11 @@ extern "C" {
       LZHAM_COMP_FLAG_TRADEOFF_DECOMPRESSION_RATE_FOR_COMP_RATIO = 16,
       
       LZHAM_COMP_FLAG_WRITE_ZLIB_STREAM = 32,
+
+      // Replaces the match finder and near-optimal parser with a single-probe hash table and greedy parsing (one byte of lazy
+      // evaluation), whatever m_level says. Several times faster than LZHAM_COMP_LEVEL_FASTEST at a somewhat lower ratio, always
+      // single threaded and deterministic. The output is an ordinary LZHAM stream.
+      LZHAM_COMP_FLAG_FAST_HASH_MATCHING = 64,
    } lzham_compress_flags;
 		
 	typedef enum 
@@ -215,6 +221,39 @@ extern "C" {
       size_t src_len,
       lzham_uint32 *pAdler32);
 
+   // Creates (or resizes) a process-wide helper thread pool that all compressors created afterwards share, instead of each one
+   // starting its own m_max_helper_threads threads. A compressor then uses at most min(m_max_helper_threads, num_threads) of the
+   // shared threads. num_threads: -1=max practical, 0=destroy the shared pool (compressors go back to private pools).
+   // Fails (returns false) if the pool would change size while any compressor is still using it.
+   LZHAM_DLL_EXPORT lzham_bool LZHAM_CDECL lzham_set_helper_thread_pool_size(lzham_int32 num_threads);
+
+   // Per-stream compression statistics, filled in by lzham_compress_get_stats(). Counters accumulate from lzham_compress_init() or the last
+   // lzham_compress_reinit(). Times are wall clock microseconds.
+   typedef struct
+   {
+      lzham_uint32 m_struct_size;            // set to sizeof(lzham_compress_stats)
+      lzham_uint32 m_max_helper_threads;     // helper threads this compressor may use (0=single threaded)
+      lzham_uint64 m_bytes_in;               // source bytes consumed
+      lzham_uint64 m_bytes_out;              // compressed bytes returned to the caller
+      lzham_uint64 m_blocks;                 // blocks coded, including m_raw_blocks
+      lzham_uint64 m_raw_blocks;             // blocks stored uncompressed because coding them didn't help
+      lzham_uint64 m_parse_us;               // time spent parsing (choosing literals/matches), including waiting on parse jobs
+      lzham_uint64 m_parse_busy_us;          // sum of the time each parse job ran, over all threads
+      lzham_uint64 m_helper_parse_busy_us;   // portion of m_parse_busy_us spent in jobs handed to the helper threads
+      lzham_uint64 m_coding_us;              // time spent entropy coding the chosen decisions
+      lzham_uint64 m_match_finder_wait_us;   // time spent waiting for the match finder to finish each block
+      lzham_uint64 m_parse_jobs;             // parse jobs run, including m_helper_parse_jobs
+      lzham_uint64 m_helper_parse_jobs;
+      lzham_uint64 m_literals;               // coded decisions, not counting blocks that fell back to raw
+      lzham_uint64 m_matches;                // includes m_rep_matches
+      lzham_uint64 m_rep_matches;
+      lzham_uint64 m_total_match_len;
+   } lzham_compress_stats;
+
+   // Returns the statistics gathered so far by a compressor. Helper thread utilization during parsing is roughly
+   // m_helper_parse_busy_us / (m_parse_us * m_max_helper_threads).
+   LZHAM_DLL_EXPORT lzham_bool LZHAM_CDECL lzham_compress_get_stats(lzham_compress_state_ptr pState, lzham_compress_stats *pStats);
+
    // Decompression
    typedef enum
    {
@@ -637,6 +676,8 @@ extern "C" {
    typedef lzham_compress_status_t (LZHAM_CDECL *lzham_compress_func)(lzham_compress_state_ptr pState, const lzham_uint8 *pIn_buf, size_t *pIn_buf_size, lzham_uint8 *pOut_buf, size_t *pOut_buf_size, lzham_bool no_more_input_bytes_flag);
    typedef lzham_compress_status_t (LZHAM_CDECL *lzham_compress2_func)(lzham_compress_state_ptr pState, const lzham_uint8 *pIn_buf, size_t *pIn_buf_size, lzham_uint8 *pOut_buf, size_t *pOut_buf_size, lzham_flush_t flush_type);
    typedef lzham_compress_status_t (LZHAM_CDECL *lzham_compress_memory_func)(const lzham_compress_params *pParams, lzham_uint8* pDst_buf, size_t *pDst_len, const lzham_uint8* pSrc_buf, size_t src_len, lzham_uint32 *pAdler32);
+   typedef lzham_bool (LZHAM_CDECL *lzham_set_helper_thread_pool_size_func)(lzham_int32 num_threads);
+   typedef lzham_bool (LZHAM_CDECL *lzham_compress_get_stats_func)(lzham_compress_state_ptr pState, lzham_compress_stats *pStats);
 
    typedef lzham_decompress_state_ptr (LZHAM_CDECL *lzham_decompress_init_func)(const lzham_decompress_params *pParams);
    typedef lzham_decompress_state_ptr (LZHAM_CDECL *lzham_decompress_reinit_func)(lzham_compress_state_ptr pState, const lzham_decompress_params *pParams);
@@ -693,6 +734,8 @@ public:
       this->lzham_compress = NULL;
       this->lzham_compress2 = NULL;
       this->lzham_compress_memory = NULL;
+      this->lzham_set_helper_thread_pool_size = NULL;
+      this->lzham_compress_get_stats = NULL;
       
       this->lzham_decompress_init = NULL;
       this->lzham_decompress_reinit = NULL;
@@ -728,6 +771,8 @@ public:
    lzham_compress_func              lzham_compress;
    lzham_compress2_func             lzham_compress2;
    lzham_compress_memory_func       lzham_compress_memory;
+   lzham_set_helper_thread_pool_size_func lzham_set_helper_thread_pool_size;
+   lzham_compress_get_stats_func    lzham_compress_get_stats;
 
    lzham_decompress_init_func       lzham_decompress_init;
    lzham_decompress_reinit_func     lzham_decompress_reinit;
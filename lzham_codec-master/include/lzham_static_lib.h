@@ -25,6 +25,8 @@ public:
       this->lzham_compress2 = ::lzham_compress2;
       this->lzham_compress_reinit = ::lzham_compress_reinit;
       this->lzham_compress_memory = ::lzham_compress_memory;
+      this->lzham_set_helper_thread_pool_size = ::lzham_set_helper_thread_pool_size;
+      this->lzham_compress_get_stats = ::lzham_compress_get_stats;
       this->lzham_decompress_init = ::lzham_decompress_init;
       this->lzham_decompress_reinit = ::lzham_decompress_reinit;
       this->lzham_decompress_deinit = ::lzham_decompress_deinit;
@@ -25,6 +25,9 @@ namespace lzham
    
    lzham_compress_status_t LZHAM_CDECL lzham_lib_compress_memory(const lzham_compress_params *pParams, lzham_uint8* pDst_buf, size_t *pDst_len, const lzham_uint8* pSrc_buf, size_t src_len, lzham_uint32 *pAdler32);
 
+   lzham_bool LZHAM_CDECL lzham_lib_set_helper_thread_pool_size(lzham_int32 num_threads);
+   lzham_bool LZHAM_CDECL lzham_lib_compress_get_stats(lzham_compress_state_ptr p, lzham_compress_stats *pStats);
+
    int lzham_lib_z_deflateInit(lzham_z_streamp pStream, int level);
    int lzham_lib_z_deflateInit2(lzham_z_streamp pStream, int level, int method, int window_bits, int mem_level, int strategy);
    int lzham_lib_z_deflateReset(lzham_z_streamp pStream);
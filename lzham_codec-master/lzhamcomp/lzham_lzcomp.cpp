@@ -4,6 +4,7 @@
 #include "lzham.h"
 #include "lzham_comp.h"
 #include "lzham_lzcomp_internal.h"
+#include "lzham_timer.h"
 
 using namespace lzham;
 
@@ -15,6 +16,9 @@ namespace lzham
       task_pool m_tp;
       lzcompressor m_compressor;
 
+      // Non-NULL if this compressor borrowed the process-wide pool instead of starting m_tp's threads.
+      task_pool *m_pShared_tp;
+
       uint m_dict_size_log2;
 
       const uint8 *m_pIn_buf;
@@ -24,6 +28,9 @@ namespace lzham
 
       size_t m_comp_data_ofs;
 
+      // Compressed bytes handed back to the caller, for lzham_compress_get_stats().
+      uint64 m_total_bytes_out;
+
       bool m_finished_compression;
 
       lzham_compress_params m_params;
@@ -31,6 +38,84 @@ namespace lzham
       lzham_compress_status_t m_status;
    };
 
+   // Process-wide helper pool, optionally shared by every compressor so concurrent streams don't each start nprocs-1 threads.
+   static task_pool *g_pShared_task_pool;
+   static uint g_shared_task_pool_users;
+   static volatile atomic32_t g_shared_task_pool_lock;
+
+   static void lock_shared_task_pool()
+   {
+      while (atomic_compare_exchange32(&g_shared_task_pool_lock, 1, 0) != 0)
+         lzham_yield_processor();
+   }
+
+   static void unlock_shared_task_pool()
+   {
+      atomic_exchange32(&g_shared_task_pool_lock, 0);
+   }
+
+   static task_pool *acquire_shared_task_pool()
+   {
+      lock_shared_task_pool();
+      task_pool *pPool = g_pShared_task_pool;
+      if (pPool)
+         g_shared_task_pool_users++;
+      unlock_shared_task_pool();
+      return pPool;
+   }
+
+   static void release_shared_task_pool(task_pool *pPool)
+   {
+      if (!pPool)
+         return;
+      lock_shared_task_pool();
+      LZHAM_ASSERT((pPool == g_pShared_task_pool) && (g_shared_task_pool_users > 0));
+      g_shared_task_pool_users--;
+      unlock_shared_task_pool();
+   }
+
+   lzham_bool LZHAM_CDECL lzham_lib_set_helper_thread_pool_size(lzham_int32 num_threads)
+   {
+      if (num_threads < 0)
+         num_threads = lzham_get_max_helper_threads();
+      num_threads = LZHAM_MIN(LZHAM_MAX_HELPER_THREADS, num_threads);
+
+      lock_shared_task_pool();
+
+      uint cur_threads = g_pShared_task_pool ? g_pShared_task_pool->get_num_threads() : 0;
+      if (cur_threads == (uint)num_threads)
+      {
+         unlock_shared_task_pool();
+         return true;
+      }
+
+      // Can't pull the threads out from under active compressors.
+      if (g_shared_task_pool_users)
+      {
+         unlock_shared_task_pool();
+         return false;
+      }
+
+      lzham_delete(g_pShared_task_pool);
+      g_pShared_task_pool = NULL;
+
+      bool succeeded = true;
+      if (num_threads)
+      {
+         task_pool *pPool = lzham_new<task_pool>();
+         if ((pPool) && (pPool->init(num_threads)) && (pPool->get_num_threads()))
+            g_pShared_task_pool = pPool;
+         else
+         {
+            lzham_delete(pPool);
+            succeeded = false;
+         }
+      }
+
+      unlock_shared_task_pool();
+      return succeeded;
+   }
+
    static lzham_compress_status_t create_internal_init_params(lzcompressor::init_params &internal_params, const lzham_compress_params *pParams)
    {
       if ((pParams->m_dict_size_log2 < CLZBase::cMinDictSizeLog2) || (pParams->m_dict_size_log2 > CLZBase::cMaxDictSizeLog2))
@@ -109,9 +194,16 @@ namespace lzham
       pState->m_pOut_buf_size = NULL;
       pState->m_status = LZHAM_COMP_STATUS_NOT_FINISHED;
       pState->m_comp_data_ofs = 0;
+      pState->m_total_bytes_out = 0;
       pState->m_finished_compression = false;
+      pState->m_pShared_tp = NULL;
 
-      if (internal_params.m_max_helper_threads)
+      if ((internal_params.m_max_helper_threads) && ((pState->m_pShared_tp = acquire_shared_task_pool()) != NULL))
+      {
+         internal_params.m_max_helper_threads = LZHAM_MIN(internal_params.m_max_helper_threads, pState->m_pShared_tp->get_num_threads());
+         internal_params.m_pTask_pool = pState->m_pShared_tp;
+      }
+      else if (internal_params.m_max_helper_threads)
       {
          if (!pState->m_tp.init(internal_params.m_max_helper_threads))
          {
@@ -130,6 +222,7 @@ namespace lzham
 
       if (!pState->m_compressor.init(internal_params))
       {
+         release_shared_task_pool(pState->m_pShared_tp);
          lzham_delete(pState);
          return NULL;
       }
@@ -151,6 +244,7 @@ namespace lzham
          pState->m_pOut_buf_size = NULL;
          pState->m_status = LZHAM_COMP_STATUS_NOT_FINISHED;
          pState->m_comp_data_ofs = 0;
+         pState->m_total_bytes_out = 0;
          pState->m_finished_compression = false;
       }
 
@@ -165,11 +259,46 @@ namespace lzham
 
       uint32 adler32 = pState->m_compressor.get_src_adler32();
 
+      task_pool *pShared_tp = pState->m_pShared_tp;
       lzham_delete(pState);
+      release_shared_task_pool(pShared_tp);
 
       return adler32;
    }
 
+   static inline lzham_uint64 ticks_to_us(uint64 ticks)
+   {
+      return static_cast<lzham_uint64>(lzham_timer::ticks_to_secs(ticks) * 1000000.0 + .5);
+   }
+
+   lzham_bool LZHAM_CDECL lzham_lib_compress_get_stats(lzham_compress_state_ptr p, lzham_compress_stats *pStats)
+   {
+      lzham_compress_state *pState = static_cast<lzham_compress_state*>(p);
+      if ((!pState) || (!pStats) || (pStats->m_struct_size != sizeof(lzham_compress_stats)))
+         return false;
+
+      const lzcompressor::stream_stats &stats = pState->m_compressor.get_stream_stats();
+
+      pStats->m_max_helper_threads = pState->m_compressor.get_max_helper_threads();
+      pStats->m_bytes_in = static_cast<lzham_uint64>(LZHAM_MAX(pState->m_compressor.get_src_size(), 0));
+      pStats->m_bytes_out = pState->m_total_bytes_out;
+      pStats->m_blocks = stats.m_blocks;
+      pStats->m_raw_blocks = stats.m_raw_blocks;
+      pStats->m_parse_us = ticks_to_us(stats.m_parse_ticks);
+      pStats->m_parse_busy_us = ticks_to_us(stats.m_parse_busy_ticks);
+      pStats->m_helper_parse_busy_us = ticks_to_us(stats.m_helper_parse_busy_ticks);
+      pStats->m_coding_us = ticks_to_us(stats.m_coding_ticks);
+      pStats->m_match_finder_wait_us = ticks_to_us(stats.m_match_finder_wait_ticks);
+      pStats->m_parse_jobs = stats.m_parse_jobs;
+      pStats->m_helper_parse_jobs = stats.m_helper_parse_jobs;
+      pStats->m_literals = stats.m_literals;
+      pStats->m_matches = stats.m_matches;
+      pStats->m_rep_matches = stats.m_rep_matches;
+      pStats->m_total_match_len = stats.m_total_match_len;
+
+      return true;
+   }
+
    lzham_compress_status_t LZHAM_CDECL lzham_lib_compress(
       lzham_compress_state_ptr p,
       const lzham_uint8 *pIn_buf, size_t *pIn_buf_size,
@@ -205,6 +334,7 @@ namespace lzham
          memcpy(pOut_buf, comp_data.get_ptr() + pState->m_comp_data_ofs, n);
 
          pState->m_comp_data_ofs += n;
+         pState->m_total_bytes_out += n;
 
          const bool has_no_more_output = (pState->m_comp_data_ofs >= comp_data.size());
          if (has_no_more_output)
@@ -286,6 +416,7 @@ namespace lzham
          memcpy(pOut_buf, comp_data.get_ptr() + pState->m_comp_data_ofs, num_comp_bytes_to_output);
 
          pState->m_comp_data_ofs += num_comp_bytes_to_output;
+         pState->m_total_bytes_out += num_comp_bytes_to_output;
       }
 
       *pIn_buf_size = bytes_to_put;
@@ -325,7 +456,13 @@ namespace lzham
          return status;
 
       task_pool *pTP = NULL;
-      if (internal_params.m_max_helper_threads)
+      task_pool *pShared_tp = NULL;
+      if ((internal_params.m_max_helper_threads) && ((pShared_tp = acquire_shared_task_pool()) != NULL))
+      {
+         internal_params.m_max_helper_threads = LZHAM_MIN(internal_params.m_max_helper_threads, pShared_tp->get_num_threads());
+         internal_params.m_pTask_pool = pShared_tp;
+      }
+      else if (internal_params.m_max_helper_threads)
       {
          pTP = lzham_new<task_pool>();
          if (!pTP->init(internal_params.m_max_helper_threads))
@@ -338,12 +475,14 @@ namespace lzham
       if (!pCompressor)
       {
          lzham_delete(pTP);
+         release_shared_task_pool(pShared_tp);
          return LZHAM_COMP_STATUS_FAILED;
       }
 
       if (!pCompressor->init(internal_params))
       {
          lzham_delete(pTP);
+         release_shared_task_pool(pShared_tp);
          lzham_delete(pCompressor);
          return LZHAM_COMP_STATUS_INVALID_PARAMETER;
       }
@@ -354,6 +493,7 @@ namespace lzham
          {
             *pDst_len = 0;
             lzham_delete(pTP);
+            release_shared_task_pool(pShared_tp);
             lzham_delete(pCompressor);
             return LZHAM_COMP_STATUS_FAILED;
          }
@@ -363,6 +503,7 @@ namespace lzham
       {
          *pDst_len = 0;
          lzham_delete(pTP);
+         release_shared_task_pool(pShared_tp);
          lzham_delete(pCompressor);
          return LZHAM_COMP_STATUS_FAILED;
       }
@@ -378,6 +519,7 @@ namespace lzham
       if (comp_data.size() > dst_buf_size)
       {
          lzham_delete(pTP);
+         release_shared_task_pool(pShared_tp);
          lzham_delete(pCompressor);
          return LZHAM_COMP_STATUS_OUTPUT_BUF_TOO_SMALL;
       }
@@ -385,6 +527,8 @@ namespace lzham
       memcpy(pDst_buf, comp_data.get_ptr(), comp_data.size());
 
       lzham_delete(pTP);
+
+      release_shared_task_pool(pShared_tp);
       lzham_delete(pCompressor);
       return LZHAM_COMP_STATUS_SUCCESS;
    }
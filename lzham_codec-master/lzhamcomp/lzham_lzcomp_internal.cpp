@@ -90,6 +90,9 @@ namespace lzham
             return false;
          m_accel.add_bytes_end();
 
+         if (m_accel.is_hash_matching())
+            m_accel.insert_hash_positions(0, num_bytes_to_add);
+
          m_accel.advance_bytes(num_bytes_to_add);
 
          cur_seed_ofs += num_bytes_to_add;
@@ -109,6 +112,10 @@ namespace lzham
 
       m_params = params;
       m_use_task_pool = (m_params.m_pTask_pool) && (m_params.m_pTask_pool->get_num_threads() != 0) && (m_params.m_max_helper_threads > 0);
+
+      // The hash matcher codes each decision as soon as it's made, leaving nothing for helper threads to do.
+      if (m_params.m_lzham_compress_flags & LZHAM_COMP_FLAG_FAST_HASH_MATCHING)
+         m_use_task_pool = false;
       
       if (!m_use_task_pool)
          m_params.m_max_helper_threads = 0;
@@ -183,7 +190,7 @@ namespace lzham
          LZHAM_ASSERT((match_accel_helper_threads + (m_num_parse_threads - 1)) <= m_params.m_max_helper_threads);
       }
 
-      if (!m_accel.init(this, params.m_pTask_pool, match_accel_helper_threads, dict_size, m_settings.m_match_accel_max_matches_per_probe, false, m_settings.m_match_accel_max_probes))
+      if (!m_accel.init(this, params.m_pTask_pool, match_accel_helper_threads, dict_size, m_settings.m_match_accel_max_matches_per_probe, false, m_settings.m_match_accel_max_probes, (m_params.m_lzham_compress_flags & LZHAM_COMP_FLAG_FAST_HASH_MATCHING) != 0))
          return false;
 
       init_position_slots(params.m_dict_size_log2);
@@ -324,6 +331,8 @@ namespace lzham
 
       m_block_history_size = 0;
       m_block_history_next = 0;
+
+      m_stream_stats.clear();
    }
 
    bool lzcompressor::reset()
@@ -334,6 +343,7 @@ namespace lzham
       m_accel.reset();
       m_codec.reset();
       m_stats.clear();
+      m_stream_stats.clear();
       m_src_size = 0;
       m_src_adler32 = cInitAdler32;
       m_block_buf.try_resize(0);
@@ -380,6 +390,15 @@ namespace lzham
       if (!m_state.encode(m_codec, *this, m_accel, lzdec))
          return false;
 
+      if (lzdec.is_lit())
+         m_stream_stats.m_literals++;
+      else
+      {
+         m_stream_stats.m_matches++;
+         m_stream_stats.m_rep_matches += lzdec.is_rep();
+         m_stream_stats.m_total_match_len += len;
+      }
+
       cur_ofs += len;
       LZHAM_ASSERT(bytes_to_match >= len);
       bytes_to_match -= len;
@@ -1269,11 +1288,15 @@ namespace lzham
 
       parse_thread_state &parse_state = m_parse_thread_state[parse_job_index];
 
+      const timer_ticks start_ticks = lzham_timer::get_ticks();
+
       if ((m_params.m_lzham_compress_flags & LZHAM_COMP_FLAG_EXTREME_PARSING) && (m_params.m_compression_level == cCompressionLevelUber))
          extreme_parse(parse_state);
       else
          optimal_parse(parse_state);
 
+      parse_state.m_busy_ticks = lzham_timer::get_ticks() - start_ticks;
+
       LZHAM_MEMORY_EXPORT_BARRIER
 
       if (atomic_decrement32(&m_parse_jobs_remaining) == 0)
@@ -1449,6 +1472,73 @@ namespace lzham
       return true;
    }
 
+   // LZHAM_COMP_FLAG_FAST_HASH_MATCHING: greedy parsing over the accelerator's single-probe hash table, looking one byte ahead
+   // before taking a short match, with every decision coded as soon as it's made. Rep matches win whenever they're within a
+   // byte of the hashed match, since they're much cheaper to code.
+   bool lzcompressor::hash_parse(uint& cur_dict_ofs, uint& bytes_to_match)
+   {
+      // Matches at least this long are taken without looking ahead.
+      const uint cLazyMatchLen = 32;
+
+      uint next_len = 0;
+      uint next_dist = 0;
+      bool have_next = false;
+
+      while (bytes_to_match)
+      {
+         const uint max_match_len = LZHAM_MIN(static_cast<uint>(CLZBase::cMaxHugeMatchLen), bytes_to_match);
+
+         uint match_dist = 0;
+         uint match_len;
+         if (have_next)
+         {
+            match_len = next_len;
+            match_dist = next_dist;
+            have_next = false;
+         }
+         else
+            match_len = m_accel.find_hash_match(0, max_match_len, match_dist);
+
+         int dist = static_cast<int>(match_dist);
+
+         for (uint i = 0; i < CLZBase::cMatchHistSize; i++)
+         {
+            const uint rep_len = m_accel.get_match_len(0, m_state.m_match_hist[i], max_match_len);
+            if ((rep_len >= CLZBase::cMinMatchLen) && ((rep_len + 1) >= match_len) && ((dist > 0) || (rep_len > match_len)))
+            {
+               match_len = rep_len;
+               dist = -static_cast<int>(i + 1);
+            }
+         }
+
+         if ((match_len) && (match_len < cLazyMatchLen) && (match_len < bytes_to_match))
+         {
+            next_len = m_accel.find_hash_match(1, LZHAM_MIN(static_cast<uint>(CLZBase::cMaxHugeMatchLen), bytes_to_match - 1), next_dist);
+            if (next_len > (match_len + 1))
+            {
+               have_next = true;
+               match_len = 0;
+            }
+         }
+
+         if (!match_len)
+         {
+            if (!code_decision(lzdecision(cur_dict_ofs, 0, 0), cur_dict_ofs, bytes_to_match))
+               return false;
+            continue;
+         }
+
+         // Hash every position the match covers: rep history is reset at each block, so the table is the only way back into
+         // data that was itself coded as long matches.
+         m_accel.insert_hash_positions(1, match_len - 1);
+
+         if (!code_decision(lzdecision(cur_dict_ofs, match_len, dist), cur_dict_ofs, bytes_to_match))
+            return false;
+      }
+
+      return true;
+   }
+
    bool lzcompressor::compress_block(const void* pBuf, uint buf_len)
    {
       uint cur_ofs = 0;
@@ -1603,9 +1693,18 @@ namespace lzham
       m_codec.encode_bits(emit_reset_update_rate_command ? 1 : 0, cBlockFlushTypeBits);
 
       //coding_stats initial_stats(m_stats);
+      const stream_stats initial_stream_stats(m_stream_stats);
 
       uint initial_step = m_step;
 
+      if (m_accel.is_hash_matching())
+      {
+         const timer_ticks coding_start_ticks = lzham_timer::get_ticks();
+         if (!hash_parse(cur_dict_ofs, bytes_to_match))
+            return false;
+         m_stream_stats.m_coding_ticks += lzham_timer::get_ticks() - coding_start_ticks;
+      }
+
       while (bytes_to_match)
       {
          const uint cAvgAcceptableGreedyMatchLen = 384;
@@ -1624,7 +1723,13 @@ namespace lzham
             greedy_parse_state.m_greedy_parse_gave_up = false;
             greedy_parse_state.m_greedy_parse_total_bytes_coded = 0;
 
-            if (!greedy_parse(greedy_parse_state))
+            const timer_ticks greedy_start_ticks = lzham_timer::get_ticks();
+            const bool greedy_parse_succeeded = greedy_parse(greedy_parse_state);
+            const timer_ticks greedy_ticks = lzham_timer::get_ticks() - greedy_start_ticks;
+            m_stream_stats.m_parse_ticks += greedy_ticks;
+            m_stream_stats.m_parse_busy_ticks += greedy_ticks;
+
+            if (!greedy_parse_succeeded)
             {
                if (!greedy_parse_state.m_greedy_parse_gave_up)
                   return false;
@@ -1750,10 +1855,13 @@ namespace lzham
             parse_thread_remaining -= parse_thread.m_bytes_to_match;
          }
 
+         const bool used_helper_parse_jobs = (m_use_task_pool) && (num_parse_jobs > 1);
+         const timer_ticks parse_start_ticks = lzham_timer::get_ticks();
+
          {
             scoped_perf_section parse_timer("parsing");
 
-            if ((m_use_task_pool) && (num_parse_jobs > 1))
+            if (used_helper_parse_jobs)
             {
                m_parse_jobs_remaining = num_parse_jobs;
 
@@ -1769,7 +1877,15 @@ namespace lzham
                {
                   scoped_perf_section wait_timer("waiting for jobs");
 
-                  m_parse_jobs_complete.wait();
+                  // Help out while our parse jobs are still queued. Once the queue is empty every job has been picked up, so blocking is safe.
+                  while (!m_parse_jobs_complete.wait(0))
+                  {
+                     if (!m_params.m_pTask_pool->try_process_task())
+                     {
+                        m_parse_jobs_complete.wait();
+                        break;
+                     }
+                  }
                }
             }
             else
@@ -1782,6 +1898,20 @@ namespace lzham
             }
          }
 
+         const timer_ticks coding_start_ticks = lzham_timer::get_ticks();
+         m_stream_stats.m_parse_ticks += coding_start_ticks - parse_start_ticks;
+         m_stream_stats.m_parse_jobs += num_parse_jobs;
+         if (used_helper_parse_jobs)
+            m_stream_stats.m_helper_parse_jobs += num_parse_jobs - 1;
+
+         for (uint parse_thread_index = 0; parse_thread_index < num_parse_jobs; parse_thread_index++)
+         {
+            const uint64 busy_ticks = m_parse_thread_state[parse_thread_index].m_busy_ticks;
+            m_stream_stats.m_parse_busy_ticks += busy_ticks;
+            if ((used_helper_parse_jobs) && (parse_thread_index > 0))
+               m_stream_stats.m_helper_parse_busy_ticks += busy_ticks;
+         }
+
          {
             scoped_perf_section coding_timer("coding");
 
@@ -1845,11 +1975,15 @@ namespace lzham
             } // parse_thread_index
 
          }
+
+         m_stream_stats.m_coding_ticks += lzham_timer::get_ticks() - coding_start_ticks;
       }
 
       {
          scoped_perf_section add_bytes_timer("add_bytes_end");
+         const timer_ticks wait_start_ticks = lzham_timer::get_ticks();
          m_accel.add_bytes_end();
+         m_stream_stats.m_match_finder_wait_ticks += lzham_timer::get_ticks() - wait_start_ticks;
       }
 
       if (!m_state.encode_eob(m_codec, m_accel, cur_dict_ofs))
@@ -1884,6 +2018,11 @@ namespace lzham
          m_state = m_start_of_block_state;
          m_step = initial_step;
          //m_stats = initial_stats;
+         m_stream_stats.m_literals = initial_stream_stats.m_literals;
+         m_stream_stats.m_matches = initial_stream_stats.m_matches;
+         m_stream_stats.m_rep_matches = initial_stream_stats.m_rep_matches;
+         m_stream_stats.m_total_match_len = initial_stream_stats.m_total_match_len;
+         m_stream_stats.m_raw_blocks++;
 
          m_codec.reset();
 
@@ -1936,6 +2075,7 @@ namespace lzham
       uint comp_size = m_codec.get_encoding_buf().size();
       uint scaled_ratio =  (comp_size * cBlockHistoryCompRatioScale) / buf_len;
       update_block_history(comp_size, buf_len, scaled_ratio, used_raw_block, emit_reset_update_rate_command);
+      m_stream_stats.m_blocks++;
 
       //printf("\n%u, %u, %u, %u\n", m_block_index, 500*emit_reset_update_rate_command, scaled_ratio, get_recent_block_ratio());
 
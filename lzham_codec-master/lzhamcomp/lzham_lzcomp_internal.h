@@ -91,6 +91,30 @@ namespace lzham
 
       uint32 get_src_adler32() const { return m_src_adler32; }
 
+      // Cheap per-stream counters, gathered even when LZHAM_UPDATE_STATS is off. Times are in lzham_timer ticks.
+      struct stream_stats
+      {
+         void clear() { utils::zero_object(*this); }
+
+         uint64 m_blocks;
+         uint64 m_raw_blocks;
+         uint64 m_parse_ticks;
+         uint64 m_parse_busy_ticks;
+         uint64 m_helper_parse_busy_ticks;
+         uint64 m_coding_ticks;
+         uint64 m_match_finder_wait_ticks;
+         uint64 m_parse_jobs;
+         uint64 m_helper_parse_jobs;
+         uint64 m_literals;
+         uint64 m_matches;
+         uint64 m_rep_matches;
+         uint64 m_total_match_len;
+      };
+
+      const stream_stats& get_stream_stats() const { return m_stream_stats; }
+      int64 get_src_size() const { return m_src_size; }
+      uint get_max_helper_threads() const { return m_use_task_pool ? m_params.m_max_helper_threads : 0; }
+
    private:
       class state;
       
@@ -344,6 +368,7 @@ namespace lzham
       symbol_codec m_codec;
 
       coding_stats m_stats;
+      stream_stats m_stream_stats;
 
       byte_vec m_block_buf;
       byte_vec m_comp_buf;
@@ -420,6 +445,8 @@ namespace lzham
          
          bool m_issue_reset_state_partial;
          bool m_failed;
+
+         uint64 m_busy_ticks;
       };
 
       struct parse_thread_state : raw_parse_thread_state
@@ -459,6 +486,7 @@ namespace lzham
       bool optimal_parse(parse_thread_state &parse_state);
       int enumerate_lz_decisions(uint ofs, const state& cur_state, lzham::vector<lzpriced_decision>& decisions, uint min_match_len, uint max_match_len);
       bool greedy_parse(parse_thread_state &parse_state);
+      bool hash_parse(uint& cur_dict_ofs, uint& bytes_to_match);
       void parse_job_callback(uint64 data, void* pData_ptr);
       bool compress_block(const void* pBuf, uint buf_len);
       bool compress_block_internal(const void* pBuf, uint buf_len);
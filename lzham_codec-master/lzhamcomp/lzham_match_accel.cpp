@@ -16,6 +16,12 @@ namespace lzham
       return (c0 | (c1 << 8)) ^ (c2 << 4);
    }
 
+   static inline uint hash4_to_slot(const uint8* p)
+   {
+      const uint32 v = p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32>(p[3]) << 24);
+      return (v * 2654435761U) >> (32 - search_accelerator::cHashMatchBits);
+   }
+
    search_accelerator::search_accelerator() :
       m_pLZBase(NULL),
       m_pTask_pool(NULL),
@@ -31,12 +37,13 @@ namespace lzham
       m_max_probes(0),
       m_max_matches(0),
       m_all_matches(false),
+      m_hash_matching(false),
       m_next_match_ref(0),
       m_num_completed_helper_threads(0)
    {
    }
 
-   bool search_accelerator::init(CLZBase* pLZBase, task_pool* pPool, uint max_helper_threads, uint max_dict_size, uint max_matches, bool all_matches, uint max_probes)
+   bool search_accelerator::init(CLZBase* pLZBase, task_pool* pPool, uint max_helper_threads, uint max_dict_size, uint max_matches, bool all_matches, uint max_probes, bool hash_matching)
    {
       LZHAM_ASSERT(pLZBase);
       LZHAM_ASSERT(max_dict_size && math::is_power_of_2(max_dict_size));
@@ -45,7 +52,8 @@ namespace lzham
       m_max_probes = LZHAM_MIN(cMatchAccelMaxSupportedProbes, max_probes);
 
       m_pLZBase = pLZBase;
-      m_pTask_pool = max_helper_threads ? pPool : NULL;
+      m_hash_matching = hash_matching;
+      m_pTask_pool = (max_helper_threads && !hash_matching) ? pPool : NULL;
       m_max_helper_threads = m_pTask_pool ? max_helper_threads : 0;
       m_max_matches = LZHAM_MIN(m_max_probes, max_matches);
       m_all_matches = all_matches;
@@ -63,10 +71,12 @@ namespace lzham
       if (!m_dict.try_resize_no_construct(max_dict_size + LZHAM_MIN(m_max_dict_size, static_cast<uint>(CLZBase::cMaxHugeMatchLen))))
          return false;
 
-      if (!m_hash.try_resize_no_construct(cHashSize))
+      if (!m_hash.try_resize_no_construct(m_hash_matching ? static_cast<uint>(cHashMatchSize) : static_cast<uint>(cHashSize)))
          return false;
 
-      if (!m_nodes.try_resize_no_construct(max_dict_size))
+      if (m_hash_matching)
+         m_nodes.clear();
+      else if (!m_nodes.try_resize_no_construct(max_dict_size))
          return false;
 
       memset(m_hash.get_ptr(), 0, m_hash.size_in_bytes());
@@ -490,6 +500,14 @@ namespace lzham
 
       m_next_match_ref = 0;
 
+      if (m_hash_matching)
+      {
+         m_fill_lookahead_pos = m_lookahead_pos;
+         m_fill_lookahead_size = num_bytes;
+         m_fill_dict_size = m_cur_dict_size;
+         return true;
+      }
+
       return find_all_matches(num_bytes);
    }
 
@@ -497,7 +515,13 @@ namespace lzham
    {
       if (m_pTask_pool)
       {
-         m_pTask_pool->join();
+         // Wait for this accelerator's own finder jobs only - the pool may be shared with other compressors, so join() could
+         // end up waiting on their work too. Help drain the queue while waiting.
+         while (atomic_add32(&m_num_completed_helper_threads, 0) < (atomic32_t)m_max_helper_threads)
+         {
+            if (!m_pTask_pool->try_process_task())
+               lzham_sleep(1);
+         }
       }
 
       LZHAM_ASSERT((uint)m_next_match_ref <= m_matches.size());
@@ -540,7 +564,9 @@ namespace lzham
          {
             spin_count = cMaxSpinCount;
 
-            lzham_sleep(1);
+            // Our finder jobs may still be queued behind other work in a shared pool, so run queued tasks rather than sleeping.
+            if ((!m_pTask_pool) || (!m_pTask_pool->try_process_task()))
+               lzham_sleep(1);
          }
       }
 
@@ -549,6 +575,61 @@ namespace lzham
       return &m_matches[match_ref];
    }
 
+   uint search_accelerator::find_hash_match(uint lookahead_ofs, uint max_match_len, uint& match_dist)
+   {
+      LZHAM_ASSERT(m_hash_matching);
+      LZHAM_ASSERT(max_match_len <= (m_lookahead_size - lookahead_ofs));
+
+      if (max_match_len < cHashMatchMinLen)
+         return 0;
+
+      const uint pos = m_lookahead_pos + lookahead_ofs;
+      const uint8* pLookahead = &m_dict[pos & m_max_dict_size_mask];
+
+      uint& slot = m_hash[hash4_to_slot(pLookahead)];
+      const uint dist = pos - slot;
+      slot = pos;
+
+      // Stale or never written slots are caught here or by the comparison below, so the table never needs clearing mid-stream.
+      if ((!dist) || (dist > (m_cur_dict_size + lookahead_ofs)))
+         return 0;
+
+      const uint8* pComp = &m_dict[(pos - dist) & m_max_dict_size_mask];
+
+      uint match_len = 0;
+      while ((match_len + sizeof(uint64)) <= max_match_len)
+      {
+         uint64 a, b;
+         memcpy(&a, pComp + match_len, sizeof(a));
+         memcpy(&b, pLookahead + match_len, sizeof(b));
+         if (a != b)
+            break;
+         match_len += sizeof(uint64);
+      }
+      while ((match_len < max_match_len) && (pComp[match_len] == pLookahead[match_len]))
+         match_len++;
+
+      if (match_len < cHashMatchMinLen)
+         return 0;
+
+      match_dist = dist;
+      return match_len;
+   }
+
+   void search_accelerator::insert_hash_positions(uint lookahead_ofs, uint num_bytes)
+   {
+      LZHAM_ASSERT(m_hash_matching);
+
+      if ((lookahead_ofs + cHashMatchMinLen) > m_lookahead_size)
+         return;
+
+      num_bytes = LZHAM_MIN(num_bytes, m_lookahead_size - lookahead_ofs - (cHashMatchMinLen - 1));
+
+      uint pos = m_lookahead_pos + lookahead_ofs;
+      for (uint i = 0; i < num_bytes; i++, pos++)
+         m_hash[hash4_to_slot(&m_dict[pos & m_max_dict_size_mask])] = pos;
+   }
+
    void search_accelerator::advance_bytes(uint num_bytes)
    {
       LZHAM_ASSERT(num_bytes <= m_lookahead_size);
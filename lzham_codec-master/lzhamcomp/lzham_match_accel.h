@@ -38,7 +38,9 @@ namespace lzham
       // If all_matches is true, the match finder returns all found matches with no filtering.
       // Otherwise, the finder will tend to return lists of matches with mostly unique lengths.
       // For each length, it will discard matches with worse distances (in the coding sense).
-      bool init(CLZBase* pLZBase, task_pool* pPool, uint max_helper_threads, uint max_dict_size, uint max_matches, bool all_matches, uint max_probes);
+      // With hash_matching set, no match finding happens in add_bytes_begin() and find_matches() must not be called; the caller
+      // uses find_hash_match() and insert_hash_positions() instead, and no binary tree nodes are allocated.
+      bool init(CLZBase* pLZBase, task_pool* pPool, uint max_helper_threads, uint max_dict_size, uint max_matches, bool all_matches, uint max_probes, bool hash_matching = false);
       
       void reset();
       void flush();
@@ -70,6 +72,12 @@ namespace lzham
       
       uint get_len2_match(uint lookahead_ofs);
       dict_match* find_matches(uint lookahead_ofs, bool spin = true);
+
+      // Single probe of the hash matcher: returns the length of the match (0, or at least cHashMatchMinLen) against the last position
+      // that hashed like lookahead_ofs, then makes lookahead_ofs that position.
+      uint find_hash_match(uint lookahead_ofs, uint max_match_len, uint& match_dist);
+      void insert_hash_positions(uint lookahead_ofs, uint num_bytes);
+      inline bool is_hash_matching() const { return m_hash_matching; }
             
       void advance_bytes(uint num_bytes);
       
@@ -113,6 +121,7 @@ namespace lzham
       lzham::vector<uint8> m_dict;
       
       enum { cHashSize = 65536 };
+      enum { cHashMatchBits = 17, cHashMatchSize = 1U << cHashMatchBits, cHashMatchMinLen = 4 };
       lzham::vector<uint> m_hash;
       lzham::vector<node> m_nodes;
 
@@ -133,6 +142,7 @@ namespace lzham
       uint m_max_matches;
       
       bool m_all_matches;
+      bool m_hash_matching;
                   
       volatile atomic32_t m_next_match_ref;
       
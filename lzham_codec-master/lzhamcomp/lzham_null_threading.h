@@ -82,6 +82,8 @@ namespace lzham
       }
 
       void join() { }
+
+      inline bool try_process_task() { return false; }
    };
    
    inline void lzham_sleep(unsigned int milliseconds)
@@ -187,6 +187,16 @@ namespace lzham
       }
    }
 
+   bool task_pool::try_process_task()
+   {
+      task tsk;
+      if (!m_task_stack.pop(tsk))
+         return false;
+
+      process_task(tsk);
+      return true;
+   }
+
    void * task_pool::thread_func(void *pContext)
    {
       task_pool* pPool = static_cast<task_pool*>(pContext);
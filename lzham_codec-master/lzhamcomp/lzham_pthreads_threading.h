@@ -93,13 +93,14 @@ namespace lzham
          }
       }
 
-      inline bool wait()
+      inline bool wait(uint32 milliseconds = UINT32_MAX)
       {
-         int status = sem_wait(m_pSem);
+         // Named semaphores have no timed wait here, so anything other than a poll (0) blocks.
+         int status = milliseconds ? sem_wait(m_pSem) : sem_trywait(m_pSem);
 
          if (status)
          {
-            if (errno != ETIMEDOUT)
+            if ((errno != ETIMEDOUT) && (errno != EAGAIN))
             {
                LZHAM_FAIL("semaphore: sem_wait() or sem_timedwait() failed");
             }
@@ -167,6 +168,10 @@ namespace lzham
          {
             status = sem_wait(&m_sem);
          }
+         else if (!milliseconds)
+         {
+            status = sem_trywait(&m_sem);
+         }
          else
          {
             struct timespec interval;
@@ -177,7 +182,7 @@ namespace lzham
 
          if (status)
          {
-            if (errno != ETIMEDOUT)
+            if ((errno != ETIMEDOUT) && (errno != EAGAIN))
             {
                LZHAM_FAIL("semaphore: sem_wait() or sem_timedwait() failed");
             }
@@ -321,6 +326,8 @@ namespace lzham
       ~task_pool();
 
       enum { cMaxThreads = LZHAM_MAX_HELPER_THREADS };
+      // A pool may be shared by many compressors (see lzham_set_helper_thread_pool_size()), so the queue is sized well beyond the thread count.
+      enum { cMaxQueuedTasks = 1024 };
       bool init(uint num_threads);
       void deinit();
 
@@ -348,6 +355,11 @@ namespace lzham
 
       void join();
 
+      // Pops and executes a single queued task on the calling thread. Returns false if the queue was empty.
+      // Threads waiting on work queued to a shared pool should call this instead of blocking, so that a pool whose
+      // threads are all busy waiting can't stall on tasks sitting in the queue.
+      bool try_process_task();
+
    private:
       struct task
       {
@@ -365,7 +377,7 @@ namespace lzham
          uint m_flags;
       };
 
-      tsstack<task, cMaxThreads> m_task_stack;
+      tsstack<task, cMaxQueuedTasks> m_task_stack;
 
       uint m_num_threads;
       pthread_t m_threads[cMaxThreads];
@@ -460,8 +472,8 @@ namespace lzham
 
       bool status = true;
 
-      uint i;
-      for (i = 0; i < num_tasks; i++)
+      uint num_queued = 0;
+      for (uint i = 0; i < num_tasks; i++)
       {
          task tsk;
 
@@ -476,18 +488,20 @@ namespace lzham
          tsk.m_pData_ptr = pData_ptr;
          tsk.m_flags = cTaskFlagObject;
 
-         if (!m_task_stack.try_push(tsk))
+         if (m_task_stack.try_push(tsk))
+            num_queued++;
+         else
          {
-            status = false;
-            break;
+            // Queue is full (other compressors are sharing this pool) - run the task on the caller's thread instead of failing.
+            tsk.m_pObj->execute_task(tsk.m_data, tsk.m_pData_ptr);
          }
       }
 
-      if (i)
+      if (num_queued)
       {
-         atomic_add32(&m_num_outstanding_tasks, i);
+         atomic_add32(&m_num_outstanding_tasks, num_queued);
 
-         m_tasks_available.release(i);
+         m_tasks_available.release(num_queued);
       }
 
       return status;
@@ -211,6 +211,11 @@ namespace lzham
 
       void join();
 
+      // Pops and executes a single queued task on the calling thread. Returns false if the queue was empty.
+      // Threads waiting on work queued to a shared pool should call this instead of blocking, so that a pool whose
+      // threads are all busy waiting can't stall on tasks sitting in the queue.
+      bool try_process_task();
+
    private:
       struct task
       {
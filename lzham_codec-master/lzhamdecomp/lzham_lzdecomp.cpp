@@ -1187,7 +1187,8 @@ namespace lzham
       if (!check_params(pParams))
          return NULL;
       
-      if (pState->m_params.m_decompress_flags & LZHAM_DECOMP_FLAG_OUTPUT_UNBUFFERED)
+      // Size the buffer for the new parameters - the caller may be switching dictionary size or buffering mode.
+      if (pParams->m_decompress_flags & LZHAM_DECOMP_FLAG_OUTPUT_UNBUFFERED)
       {
          lzham_free(pState->m_pRaw_decomp_buf);
          pState->m_pRaw_decomp_buf = NULL;
@@ -1196,7 +1197,7 @@ namespace lzham
       }
       else
       {
-         uint32 new_dict_size = 1U << pState->m_params.m_dict_size_log2;
+         uint32 new_dict_size = 1U << pParams->m_dict_size_log2;
          if ((!pState->m_pRaw_decomp_buf) || (pState->m_raw_decomp_buf_size < new_dict_size))
          {
             uint8 *pNew_dict = static_cast<uint8*>(lzham_realloc(pState->m_pRaw_decomp_buf, new_dict_size + 15));
@@ -23,13 +23,16 @@ namespace lzham
          QueryPerformanceFrequency(reinterpret_cast<LARGE_INTEGER*>(pTicks));
       }
    #else
+      // clock() is process CPU time, which runs N times too fast while helper threads are busy. Use a monotonic wall clock instead.
       inline void query_counter(timer_ticks *pTicks)
       {
-         *pTicks = clock();
+         struct timespec ts;
+         clock_gettime(CLOCK_MONOTONIC, &ts);
+         *pTicks = static_cast<timer_ticks>(ts.tv_sec) * 1000000ULL + static_cast<timer_ticks>(ts.tv_nsec / 1000);
       }
       inline void query_counter_frequency(timer_ticks *pTicks)
       {
-         *pTicks = CLOCKS_PER_SEC;
+         *pTicks = 1000000ULL;
       }
    #endif
    
@@ -81,6 +81,16 @@ extern "C" LZHAM_DLL_EXPORT lzham_compress_status_t lzham_compress_memory(const
    return lzham::lzham_lib_compress_memory(pParams, pDst_buf, pDst_len, pSrc_buf, src_len, pAdler32);
 }
 
+extern "C" LZHAM_DLL_EXPORT lzham_bool lzham_set_helper_thread_pool_size(lzham_int32 num_threads)
+{
+   return lzham::lzham_lib_set_helper_thread_pool_size(num_threads);
+}
+
+extern "C" LZHAM_DLL_EXPORT lzham_bool lzham_compress_get_stats(lzham_compress_state_ptr p, lzham_compress_stats *pStats)
+{
+   return lzham::lzham_lib_compress_get_stats(p, pStats);
+}
+
 // ----------------- zlib-style API's
 
 extern "C" LZHAM_DLL_EXPORT const char *lzham_z_version(void)
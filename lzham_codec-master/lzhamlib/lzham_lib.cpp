@@ -81,6 +81,16 @@ extern "C" lzham_compress_status_t LZHAM_CDECL lzham_compress_memory(const lzham
    return lzham::lzham_lib_compress_memory(pParams, pDst_buf, pDst_len, pSrc_buf, src_len, pAdler32);
 }
 
+extern "C" lzham_bool LZHAM_CDECL lzham_set_helper_thread_pool_size(lzham_int32 num_threads)
+{
+   return lzham::lzham_lib_set_helper_thread_pool_size(num_threads);
+}
+
+extern "C" lzham_bool LZHAM_CDECL lzham_compress_get_stats(lzham_compress_state_ptr p, lzham_compress_stats *pStats)
+{
+   return lzham::lzham_lib_compress_get_stats(p, pStats);
+}
+
 // ----------------- zlib-style API's
 
 extern "C" const char * LZHAM_CDECL lzham_z_version(void)
@@ -0,0 +1,559 @@
+// Codec benchmark: loads every file under the given paths and runs each codec configuration over all of them,
+// checking the round trip and printing ratio, throughput, peak RSS and a per-extension breakdown as JSON on stdout.
+//
+//   make bench
+//   ./bench [-codecs lzham,lzham-fast,lzhl] [-levels 0,2,4] [-dict 20,23,26] [-threads 1,4] [-windows 14,18,22]
+//           [-chunk 16777216] [-packet 65536] [-hugepages 1] [-limit 1073741824] path...
+//
+// LZHAM runs through CompressChunks/DecompressChunks with the adaptive chunk flag, as StandardObjectStore does.
+// LZHL runs the way the push protocol uses it: fixed packets, reset per packet, compressed on a pipeline when threads > 1.
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "lzham.h"
+#include "../lzhl-master/LZHL.h"
+
+// Mirrors of the structs marshalled by wrapper.cpp.
+struct CompressionParams
+{
+	int Level;
+	int DictionaryBits;
+	int MaxHelperThreads;
+	unsigned int TableUpdateRate;
+	unsigned int CompressFlags;
+	unsigned int TableMaxUpdateInterval;
+	unsigned int TableUpdateIntervalSlowRate;
+	unsigned int SeedSize;
+	const unsigned char* SeedBytes;
+};
+
+struct DecompressionParams
+{
+	int DictionaryBits;
+	unsigned int TableUpdateRate;
+	unsigned int DecompressFlags;
+	unsigned int TableMaxUpdateInterval;
+	unsigned int TableUpdateIntervalSlowRate;
+	unsigned int SeedSize;
+	const unsigned char* SeedBytes;
+};
+
+extern "C"
+{
+	bool SetCompressionHelperThreads(int threads);
+	int CompressChunkBound(int chunkSize);
+	bool CompressChunks(const CompressionParams* params, const unsigned char* input, int inputLength, int chunkSize, unsigned char* output, int outputStride, unsigned int* compressedSizes, int threads, lzham_compress_stats* stats);
+	bool DecompressChunks(const DecompressionParams* params, const unsigned char* input, const unsigned int* compressedSizes, int chunkCount, int chunkSize, unsigned char* output, int outputLength, int threads);
+	void GetCodecMemoryStats(long long* liveBytes, long long* peakBytes, long long* pooledBytes);
+	void ResetCodecPeakMemory();
+	void SetCodecPoolLimit(long long limit);
+	void SetCodecHugePages(bool enable);
+}
+
+static const unsigned int AdaptiveChunksCompressFlag = 0x10000;
+static const unsigned int ChunkLengthMask = (1u << 30) - 1;
+static const long long DefaultPoolLimit = 256LL * 1024 * 1024;
+
+struct Sample
+{
+	std::string Type;
+	std::vector<unsigned char> Data;
+};
+
+struct Totals
+{
+	long long InputBytes;
+	long long OutputBytes;
+	double CompressSeconds;
+	double DecompressSeconds;
+	int Files;
+
+	Totals() : InputBytes(0), OutputBytes(0), CompressSeconds(0), DecompressSeconds(0), Files(0) {}
+
+	void Add(const Totals& other)
+	{
+		InputBytes += other.InputBytes;
+		OutputBytes += other.OutputBytes;
+		CompressSeconds += other.CompressSeconds;
+		DecompressSeconds += other.DecompressSeconds;
+		Files += other.Files;
+	}
+};
+
+struct Config
+{
+	std::string Codec;
+	int Level;
+	int DictionaryBits;
+	int Threads;
+};
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static std::vector<int> ParseList(const char* text)
+{
+	std::vector<int> result;
+	for (const char* p = text; *p; )
+	{
+		char* end;
+		result.push_back((int)strtol(p, &end, 10));
+		p = *end == ',' ? end + 1 : end + strlen(end);
+	}
+	return result;
+}
+
+static std::vector<std::string> ParseNames(const char* text)
+{
+	std::vector<std::string> result;
+	std::string current;
+	for (const char* p = text; ; p++)
+	{
+		if (*p == ',' || !*p)
+		{
+			if (!current.empty())
+				result.push_back(current);
+			current.clear();
+			if (!*p)
+				break;
+		}
+		else
+			current += *p;
+	}
+	return result;
+}
+
+// Lower-cased extension of the file name, or "(none)".
+static std::string FileType(const std::string& path)
+{
+	size_t slash = path.find_last_of('/');
+	size_t dot = path.find_last_of('.');
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash) || dot + 1 == path.size() || dot == slash + 1)
+		return "(none)";
+	std::string type = path.substr(dot);
+	for (size_t i = 0; i < type.size(); i++)
+		type[i] = (char)tolower((unsigned char)type[i]);
+	return type;
+}
+
+static bool LoadFile(const std::string& path, long long& budget, std::vector<Sample>& samples)
+{
+	FILE* f = fopen(path.c_str(), "rb");
+	if (!f)
+		return false;
+	fseek(f, 0, SEEK_END);
+	long long size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	if (size <= 0 || size > budget || size > 0x7FFFFFFF)
+	{
+		fclose(f);
+		return size <= 0;
+	}
+	Sample sample;
+	sample.Type = FileType(path);
+	sample.Data.resize((size_t)size);
+	bool ok = fread(&sample.Data[0], 1, (size_t)size, f) == (size_t)size;
+	fclose(f);
+	if (ok)
+	{
+		budget -= size;
+		samples.push_back(std::move(sample));
+	}
+	return ok;
+}
+
+// Walks directories depth first, skipping symlinks and the .vr/.git metadata directories.
+static void LoadPath(const std::string& path, long long& budget, std::vector<Sample>& samples)
+{
+	struct stat info;
+	if (lstat(path.c_str(), &info) != 0 || S_ISLNK(info.st_mode))
+		return;
+	if (S_ISREG(info.st_mode))
+	{
+		if (!LoadFile(path, budget, samples))
+			fprintf(stderr, "Skipping %s\n", path.c_str());
+		return;
+	}
+	if (!S_ISDIR(info.st_mode))
+		return;
+	DIR* dir = opendir(path.c_str());
+	if (!dir)
+		return;
+	std::vector<std::string> entries;
+	while (dirent* entry = readdir(dir))
+	{
+		std::string name = entry->d_name;
+		if (name != "." && name != ".." && name != ".vr" && name != ".git")
+			entries.push_back(name);
+	}
+	closedir(dir);
+	std::sort(entries.begin(), entries.end());
+	for (size_t i = 0; i < entries.size() && budget > 0; i++)
+		LoadPath(path + "/" + entries[i], budget, samples);
+}
+
+// Process peak RSS since the last call. Linux resets the high-water mark through clear_refs; elsewhere it only grows.
+static long long PeakRss()
+{
+	long long peak = -1;
+	FILE* f = fopen("/proc/self/status", "r");
+	if (f)
+	{
+		char line[256];
+		while (fgets(line, sizeof(line), f))
+			if (!strncmp(line, "VmHWM:", 6))
+				peak = atoll(line + 6) * 1024;
+		fclose(f);
+		f = fopen("/proc/self/clear_refs", "w");
+		if (f)
+		{
+			fputs("5", f);
+			fclose(f);
+		}
+	}
+	if (peak < 0)
+	{
+		rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+		peak = usage.ru_maxrss;
+#else
+		peak = (long long)usage.ru_maxrss * 1024;
+#endif
+	}
+	return peak;
+}
+
+static bool RunLzham(const Config& config, bool fast, int chunkSize, const Sample& sample, Totals& result)
+{
+	const std::vector<unsigned char>& data = sample.Data;
+	int length = (int)data.size();
+	int chunk = length < chunkSize ? length : chunkSize;
+	int chunkCount = (length + chunk - 1) / chunk;
+	int stride = CompressChunkBound(chunk);
+	std::vector<unsigned char> compressed((size_t)chunkCount * stride);
+	std::vector<unsigned int> sizes(chunkCount);
+	std::vector<unsigned char> output(data.size());
+
+	CompressionParams cparams;
+	memset(&cparams, 0, sizeof(cparams));
+	cparams.Level = config.Level;
+	cparams.DictionaryBits = config.DictionaryBits;
+	cparams.MaxHelperThreads = config.Threads > 1 ? -1 : 0;
+	cparams.CompressFlags = AdaptiveChunksCompressFlag | (fast ? LZHAM_COMP_FLAG_FAST_HASH_MATCHING : 0);
+	DecompressionParams dparams;
+	memset(&dparams, 0, sizeof(dparams));
+	dparams.DictionaryBits = config.DictionaryBits;
+
+	auto start = std::chrono::steady_clock::now();
+	if (!CompressChunks(&cparams, &data[0], length, chunk, &compressed[0], stride, &sizes[0], config.Threads, NULL))
+		return false;
+	result.CompressSeconds += Seconds(start);
+
+	// DecompressChunks wants the chunks back to back, as they are stored.
+	size_t packed = 0;
+	for (int i = 0; i < chunkCount; i++)
+	{
+		size_t chunkLength = sizes[i] & ChunkLengthMask;
+		memmove(&compressed[packed], &compressed[(size_t)i * stride], chunkLength);
+		packed += chunkLength;
+	}
+
+	start = std::chrono::steady_clock::now();
+	if (!DecompressChunks(&dparams, &compressed[0], &sizes[0], chunkCount, chunk, &output[0], length, config.Threads))
+		return false;
+	result.DecompressSeconds += Seconds(start);
+
+	result.InputBytes += length;
+	result.OutputBytes += 4 + 4LL * chunkCount + (long long)packed;
+	result.Files++;
+	return output == data;
+}
+
+static bool RunLzhl(int packetSize, void* compressor, void* decompressor, void* pipeline, const Sample& sample, Totals& result)
+{
+	const std::vector<unsigned char>& data = sample.Data;
+	unsigned int length = (unsigned int)data.size();
+	int packets = (int)((length + packetSize - 1) / packetSize);
+	unsigned int bound = CompressBound((unsigned int)packetSize);
+	std::vector<unsigned int> offsets(packets + 1);
+	std::vector<unsigned int> retOffsets(packets);
+	std::vector<unsigned int> retSizes(packets);
+	std::vector<unsigned int> checksums(packets);
+	for (int i = 0; i < packets; i++)
+	{
+		offsets[i] = (unsigned int)i * packetSize;
+		retOffsets[i] = (unsigned int)i * bound;
+	}
+	offsets[packets] = length;
+	std::vector<unsigned char> compressed((size_t)packets * bound);
+	std::vector<unsigned char> output(data.size());
+	unsigned char* input = const_cast<unsigned char*>(&data[0]);
+
+	auto start = std::chrono::steady_clock::now();
+	if (pipeline)
+	{
+		if (CompressBatch(pipeline, packets, input, &offsets[0], &compressed[0], &retOffsets[0], &retSizes[0], &checksums[0]) != 0)
+			return false;
+	}
+	else
+	{
+		for (int i = 0; i < packets; i++)
+		{
+			ResetCompressor(compressor);
+			retSizes[i] = Compress(compressor, input + offsets[i], offsets[i + 1] - offsets[i], &compressed[retOffsets[i]]);
+		}
+	}
+	result.CompressSeconds += Seconds(start);
+
+	start = std::chrono::steady_clock::now();
+	long long packed = 0;
+	for (int i = 0; i < packets; i++)
+	{
+		ResetDecompressor(decompressor);
+		unsigned int expected = offsets[i + 1] - offsets[i];
+		if (Decompress(decompressor, &compressed[retOffsets[i]], retSizes[i], &output[offsets[i]], expected) != expected)
+			return false;
+		packed += retSizes[i];
+	}
+	result.DecompressSeconds += Seconds(start);
+
+	result.InputBytes += length;
+	result.OutputBytes += packed;
+	result.Files++;
+	return output == data;
+}
+
+static void PrintTotals(const Totals& totals)
+{
+	printf("\"files\": %d, \"inputBytes\": %lld, \"outputBytes\": %lld, \"ratio\": %.4f, \"compressMBps\": %.2f, \"decompressMBps\": %.2f",
+		totals.Files, totals.InputBytes, totals.OutputBytes,
+		totals.InputBytes ? (double)totals.OutputBytes / totals.InputBytes : 0.0,
+		totals.CompressSeconds > 0 ? totals.InputBytes / totals.CompressSeconds / (1024 * 1024) : 0.0,
+		totals.DecompressSeconds > 0 ? totals.InputBytes / totals.DecompressSeconds / (1024 * 1024) : 0.0);
+}
+
+static void PrintString(const std::string& text)
+{
+	putchar('"');
+	for (size_t i = 0; i < text.size(); i++)
+	{
+		unsigned char c = (unsigned char)text[i];
+		if (c == '"' || c == '\\')
+			printf("\\%c", c);
+		else if (c < 0x20)
+			printf("\\u%04x", c);
+		else
+			putchar(c);
+	}
+	putchar('"');
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<std::string> codecs = ParseNames("lzham,lzham-fast,lzhl");
+	std::vector<int> levels = ParseList("0,2,4");
+	std::vector<int> dictionaries = ParseList("20,23,26");
+	std::vector<int> windows = ParseList("14,18,22");
+	std::vector<int> threads;
+	threads.push_back(1);
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	if (cores > 1)
+		threads.push_back((int)cores);
+	int chunkSize = 16 * 1024 * 1024;
+	int packetSize = 64 * 1024;
+	bool hugePages = true;
+	long long budget = 1LL << 30;
+	std::vector<std::string> paths;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "-codecs" && hasValue)
+			codecs = ParseNames(argv[++i]);
+		else if (arg == "-levels" && hasValue)
+			levels = ParseList(argv[++i]);
+		else if (arg == "-dict" && hasValue)
+			dictionaries = ParseList(argv[++i]);
+		else if (arg == "-windows" && hasValue)
+			windows = ParseList(argv[++i]);
+		else if (arg == "-threads" && hasValue)
+			threads = ParseList(argv[++i]);
+		else if (arg == "-chunk" && hasValue)
+			chunkSize = atoi(argv[++i]);
+		else if (arg == "-packet" && hasValue)
+			packetSize = atoi(argv[++i]);
+		else if (arg == "-hugepages" && hasValue)
+			hugePages = atoi(argv[++i]) != 0;
+		else if (arg == "-limit" && hasValue)
+			budget = atoll(argv[++i]);
+		else if (arg[0] == '-')
+		{
+			fprintf(stderr, "Unknown option %s\n", arg.c_str());
+			return 2;
+		}
+		else
+			paths.push_back(arg);
+	}
+	if (paths.empty() || chunkSize <= 0 || packetSize <= 0)
+	{
+		fprintf(stderr, "Usage: bench [-codecs lzham,lzham-fast,lzhl] [-levels 0,2,4] [-dict 20,23,26] [-threads 1,4] [-windows 14,18,22] [-chunk bytes] [-packet bytes] [-hugepages 0|1] [-limit bytes] path...\n");
+		return 2;
+	}
+
+	std::vector<Sample> samples;
+	for (size_t i = 0; i < paths.size(); i++)
+		LoadPath(paths[i], budget, samples);
+	if (samples.empty())
+	{
+		fprintf(stderr, "No files to benchmark\n");
+		return 2;
+	}
+	if (budget <= 0)
+		fprintf(stderr, "Stopped loading at the -limit budget\n");
+
+	std::vector<Config> configs;
+	for (size_t c = 0; c < codecs.size(); c++)
+	{
+		for (size_t t = 0; t < threads.size(); t++)
+		{
+			Config config = { codecs[c], 0, 0, threads[t] };
+			if (codecs[c] == "lzham")
+			{
+				for (size_t l = 0; l < levels.size(); l++)
+					for (size_t d = 0; d < dictionaries.size(); d++)
+					{
+						config.Level = levels[l];
+						config.DictionaryBits = dictionaries[d];
+						configs.push_back(config);
+					}
+			}
+			else if (codecs[c] == "lzham-fast")
+			{
+				for (size_t d = 0; d < dictionaries.size(); d++)
+				{
+					config.DictionaryBits = dictionaries[d];
+					configs.push_back(config);
+				}
+			}
+			else if (codecs[c] == "lzhl")
+			{
+				for (size_t w = 0; w < windows.size(); w++)
+				{
+					config.DictionaryBits = windows[w];
+					configs.push_back(config);
+				}
+			}
+			else
+			{
+				fprintf(stderr, "Unknown codec %s\n", codecs[c].c_str());
+				return 2;
+			}
+		}
+	}
+
+	SetCodecHugePages(hugePages);
+	SetCompressionHelperThreads(-1);
+	int failures = 0;
+	long long sampleBytes = 0;
+	for (size_t i = 0; i < samples.size(); i++)
+		sampleBytes += (long long)samples[i].Data.size();
+
+	printf("{\n  \"files\": %d, \"inputBytes\": %lld, \"hugePages\": %s, \"chunkSize\": %d, \"packetSize\": %d,\n  \"runs\": [",
+		(int)samples.size(), sampleBytes, hugePages ? "true" : "false", chunkSize, packetSize);
+	for (size_t r = 0; r < configs.size(); r++)
+	{
+		const Config& config = configs[r];
+		bool lzhl = config.Codec == "lzhl";
+		void* compressor = NULL;
+		void* decompressor = NULL;
+		void* pipeline = NULL;
+		if (lzhl)
+		{
+			compressor = CreateCompressorWindow(config.DictionaryBits);
+			decompressor = CreateDecompressorWindow(config.DictionaryBits);
+			if (config.Threads > 1)
+				pipeline = CreateCompressPipeline(config.DictionaryBits, config.Threads);
+			if (!compressor || !decompressor)
+			{
+				fprintf(stderr, "LZHL has no %d-bit window\n", config.DictionaryBits);
+				failures++;
+				if (compressor)
+					DestroyCompressor(compressor);
+				if (decompressor)
+					DestroyDecompressor(decompressor);
+				if (pipeline)
+					DestroyCompressPipeline(pipeline);
+				continue;
+			}
+		}
+
+		// Blocks pooled by the previous configuration would otherwise count towards this one's RSS.
+		SetCodecPoolLimit(0);
+		SetCodecPoolLimit(DefaultPoolLimit);
+		PeakRss();
+		ResetCodecPeakMemory();
+		std::map<std::string, Totals> types;
+		int errors = 0;
+		for (size_t i = 0; i < samples.size(); i++)
+		{
+			Totals& totals = types[samples[i].Type];
+			bool ok = lzhl ? RunLzhl(packetSize, compressor, decompressor, pipeline, samples[i], totals)
+				: RunLzham(config, config.Codec == "lzham-fast", chunkSize, samples[i], totals);
+			if (!ok)
+				errors++;
+		}
+		long long peakRss = PeakRss();
+		long long codecPeak = 0;
+		GetCodecMemoryStats(NULL, &codecPeak, NULL);
+		if (lzhl)
+		{
+			DestroyCompressor(compressor);
+			DestroyDecompressor(decompressor);
+			if (pipeline)
+				DestroyCompressPipeline(pipeline);
+		}
+		if (errors)
+			fprintf(stderr, "%s level %d dict %d threads %d: %d files failed to round-trip\n", config.Codec.c_str(), config.Level, config.DictionaryBits, config.Threads, errors);
+		failures += errors;
+
+		Totals all;
+		for (std::map<std::string, Totals>::const_iterator it = types.begin(); it != types.end(); ++it)
+			all.Add(it->second);
+		printf("%s\n    { \"codec\": \"%s\", ", r ? "," : "", config.Codec.c_str());
+		if (lzhl)
+			printf("\"windowBits\": %d, ", config.DictionaryBits);
+		else
+			printf("\"level\": %d, \"dictionaryBits\": %d, ", config.Level, config.DictionaryBits);
+		printf("\"threads\": %d, \"errors\": %d, \"peakRssBytes\": %lld, \"codecPeakBytes\": %lld,\n      ", config.Threads, errors, peakRss, codecPeak);
+		PrintTotals(all);
+		printf(",\n      \"types\": {");
+		for (std::map<std::string, Totals>::const_iterator it = types.begin(); it != types.end(); ++it)
+		{
+			printf("%s\n        ", it == types.begin() ? "" : ",");
+			PrintString(it->first);
+			printf(": { ");
+			PrintTotals(it->second);
+			printf(" }");
+		}
+		printf("\n      } }");
+		fflush(stdout);
+	}
+	printf("\n  ]\n}\n");
+	return failures ? 1 : 0;
+}
@@ -2,9 +2,28 @@
 #include <stdio.h>
 #include <string.h>
 #include <memory.h>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <stdint.h>
+#include <math.h>
+#include <errno.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 #define LZHAM_DEFINE_ZLIB_API
 #include "lzham_static_lib.h"
+#include "../checksum/checksum.h"
 
 #ifdef _MSC_VER
 #define WRAPPER_API __declspec(dllexport)
@@ -12,8 +31,1338 @@
 #define WRAPPER_API __attribute__((visibility("default")))
 #endif
 
+static bool g_HelperPoolConfigured = false;
+
+// Codec memory. Every lzham allocation goes through CodecRealloc, which keeps freed large blocks (dictionaries, parse state)
+// in size-classed free lists so the next stream reuses them instead of going back to the heap. Live and peak byte counts
+// cover everything lzham holds, which lets callers cap codec memory. All state here is trivially destructible, as lzham
+// may still free blocks while statics are torn down.
+static const size_t BlockHeaderSize = LZHAM_MIN_ALLOC_ALIGNMENT;
+static const size_t PooledBlockMin = 64 * 1024;
+static const int SizeClassCount = 64 * 4;
+
+static void* g_FreeBlocks[SizeClassCount];
+static std::atomic_flag g_FreeBlocksLock = ATOMIC_FLAG_INIT;
+static std::atomic<long long> g_LiveBytes(0);
+static std::atomic<long long> g_PeakBytes(0);
+static std::atomic<long long> g_PooledBytes(0);
+static std::atomic<long long> g_PoolLimit(256LL * 1024 * 1024);
+static std::atomic<long long> g_MemoryLimit(0);
+
+// Blocks this large (dictionaries, match finder trees and hashes) are mapped on huge page boundaries and advised for transparent
+// huge pages, or take large pages outright where the system allows, so random accesses across them stop missing the TLB. Blocks
+// small enough to be pooled are touched once when mapped: the page faults are paid when the block is created instead of during
+// matching, and not at all when it is reused. Larger ones are faulted in as they're used, as a short stream may touch little of them.
+static const size_t MappedBlockMin = 2 * 1024 * 1024;
+static const size_t HugePageSize = 2 * 1024 * 1024;
+static std::atomic<bool> g_HugePages(true);
+
+// Mapped blocks have no header: the codec gets the mapping base itself, so the block is huge page aligned and a capacity that
+// is a whole number of huge pages maps no extra page. Their capacity and mapping length are kept here instead, keyed by base
+// address. The table is never freed, so it stays usable while statics are torn down.
+struct MappedBlock
+{
+	size_t Capacity;
+	size_t Length;
+};
+
+// Every mapping base is aligned to at least this (the Windows allocation granularity); heap blocks mostly aren't, which saves
+// the table lookup for them.
+static const uintptr_t MappedBlockAlignment = 64 * 1024;
+
+static std::unordered_map<void*, MappedBlock>* g_MappedBlocks;
+static std::atomic_flag g_MappedBlocksLock = ATOMIC_FLAG_INIT;
+
+struct FreeBlocksLock
+{
+	FreeBlocksLock() { while (g_FreeBlocksLock.test_and_set(std::memory_order_acquire)) std::this_thread::yield(); }
+	~FreeBlocksLock() { g_FreeBlocksLock.clear(std::memory_order_release); }
+};
+
+struct MappedBlocksLock
+{
+	MappedBlocksLock() { while (g_MappedBlocksLock.test_and_set(std::memory_order_acquire)) std::this_thread::yield(); }
+	~MappedBlocksLock() { g_MappedBlocksLock.clear(std::memory_order_release); }
+};
+
+// Four classes per power of two, so a pooled block is at most 25% larger than requested.
+static int SizeClass(size_t size, size_t& capacity)
+{
+	int shift = 0;
+	while (shift < 63 && ((size_t)1 << (shift + 1)) <= size)
+		shift++;
+	size_t step = (size_t)1 << (shift - 2);
+	capacity = (size + step - 1) & ~(step - 1);
+	return shift * 4 + (int)(capacity >> (shift - 2)) - 4;
+}
+
+static bool FindMappedBlock(void* p, MappedBlock& block)
+{
+	if ((uintptr_t)p & (MappedBlockAlignment - 1))
+		return false;
+	MappedBlocksLock lock;
+	if (!g_MappedBlocks)
+		return false;
+	auto found = g_MappedBlocks->find(p);
+	if (found == g_MappedBlocks->end())
+		return false;
+	block = found->second;
+	return true;
+}
+
+static size_t BlockCapacity(void* p)
+{
+	MappedBlock mapped;
+	if (FindMappedBlock(p, mapped))
+		return mapped.Capacity;
+	return *(size_t*)((unsigned char*)p - BlockHeaderSize);
+}
+
+static void TouchPages(unsigned char* p, size_t length)
+{
+	for (size_t i = 0; i < length; i += 4096)
+		((volatile unsigned char*)p)[i] = 0;
+}
+
+// length is a multiple of HugePageSize.
+static void* MapHugeBlock(size_t length, bool prefault)
+{
+#ifdef _WIN32
+	// Large pages need SeLockMemoryPrivilege and fail without it; they are committed and locked on allocation.
+	static const SIZE_T largePage = GetLargePageMinimum();
+	if (largePage && !(length % largePage))
+	{
+		void* p = VirtualAlloc(NULL, length, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+		if (p)
+			return p;
+	}
+	unsigned char* p = (unsigned char*)VirtualAlloc(NULL, length, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	if (p && prefault)
+		TouchPages(p, length);
+	return p;
+#else
+#ifdef MAP_HUGETLB
+	// Only succeeds when huge pages have been reserved (vm.nr_hugepages); the reservation is taken here, so no fault can fail later.
+	void* huge = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if (huge != MAP_FAILED)
+	{
+		if (prefault)
+			TouchPages((unsigned char*)huge, length);
+		return huge;
+	}
+#endif
+	// Map a huge page more than needed and trim both ends so the block starts on a huge page boundary.
+	unsigned char* raw = (unsigned char*)mmap(NULL, length + HugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (raw == (unsigned char*)MAP_FAILED)
+		return NULL;
+	size_t head = (HugePageSize - ((uintptr_t)raw & (HugePageSize - 1))) & (HugePageSize - 1);
+	if (head)
+		munmap(raw, head);
+	if (head != HugePageSize)
+		munmap(raw + head + length, HugePageSize - head);
+	unsigned char* p = raw + head;
+#ifdef MADV_HUGEPAGE
+	madvise(p, length, MADV_HUGEPAGE);
+#endif
+	if (prefault)
+		TouchPages(p, length);
+	return p;
+#endif
+}
+
+static void UnmapHugeBlock(void* p, size_t length)
+{
+#ifdef _WIN32
+	(void)length;
+	VirtualFree(p, 0, MEM_RELEASE);
+#else
+	munmap(p, length);
+#endif
+}
+
+static void* AllocateBlock(size_t capacity)
+{
+	if (capacity >= MappedBlockMin && g_HugePages)
+	{
+		size_t length = (capacity + HugePageSize - 1) & ~(HugePageSize - 1);
+		void* p = MapHugeBlock(length, (long long)capacity <= g_PoolLimit);
+		if (p)
+		{
+			try
+			{
+				MappedBlocksLock lock;
+				if (!g_MappedBlocks)
+					g_MappedBlocks = new std::unordered_map<void*, MappedBlock>();
+				MappedBlock block = { capacity, length };
+				(*g_MappedBlocks)[p] = block;
+				return p;
+			}
+			catch (...)
+			{
+				UnmapHugeBlock(p, length);
+			}
+		}
+	}
+	unsigned char* block = (unsigned char*)malloc(capacity + BlockHeaderSize);
+	if (!block)
+		return NULL;
+	*(size_t*)block = capacity;
+	return block + BlockHeaderSize;
+}
+
+static void ReleaseBlock(void* p)
+{
+	MappedBlock mapped;
+	if (FindMappedBlock(p, mapped))
+	{
+		{
+			MappedBlocksLock lock;
+			g_MappedBlocks->erase(p);
+		}
+		UnmapHugeBlock(p, mapped.Length);
+	}
+	else
+		free((unsigned char*)p - BlockHeaderSize);
+}
+
+static void* PoolAlloc(size_t size)
+{
+	size_t capacity = (size + BlockHeaderSize - 1) & ~(BlockHeaderSize - 1);
+	int sizeClass = -1;
+	if (size >= PooledBlockMin)
+		sizeClass = SizeClass(size, capacity);
+
+	long long live = g_LiveBytes += (long long)capacity;
+	long long limit = g_MemoryLimit;
+	if (limit > 0 && live > limit)
+	{
+		g_LiveBytes -= (long long)capacity;
+		return NULL;
+	}
+	long long peak = g_PeakBytes;
+	while (live > peak && !g_PeakBytes.compare_exchange_weak(peak, live))
+		;
+
+	void* p = NULL;
+	if (sizeClass >= 0)
+	{
+		FreeBlocksLock lock;
+		p = g_FreeBlocks[sizeClass];
+		if (p)
+		{
+			g_FreeBlocks[sizeClass] = *(void**)p;
+			g_PooledBytes -= (long long)capacity;
+		}
+	}
+	if (!p)
+	{
+		p = AllocateBlock(capacity);
+		if (!p)
+		{
+			g_LiveBytes -= (long long)capacity;
+			return NULL;
+		}
+	}
+	return p;
+}
+
+static void PoolFree(void* p)
+{
+	size_t capacity = BlockCapacity(p);
+	g_LiveBytes -= (long long)capacity;
+	if (capacity >= PooledBlockMin && g_PooledBytes + (long long)capacity <= g_PoolLimit)
+	{
+		size_t ignored;
+		int sizeClass = SizeClass(capacity, ignored);
+		FreeBlocksLock lock;
+		*(void**)p = g_FreeBlocks[sizeClass];
+		g_FreeBlocks[sizeClass] = p;
+		g_PooledBytes += (long long)capacity;
+		return;
+	}
+	ReleaseBlock(p);
+}
+
+// Releases pooled blocks until no more than `limit` bytes are kept.
+static void TrimPool(long long limit)
+{
+	for (int i = SizeClassCount - 1; i >= 0 && g_PooledBytes > limit; i--)
+	{
+		while (g_PooledBytes > limit)
+		{
+			void* p;
+			{
+				FreeBlocksLock lock;
+				p = g_FreeBlocks[i];
+				if (!p)
+					break;
+				g_FreeBlocks[i] = *(void**)p;
+				g_PooledBytes -= (long long)BlockCapacity(p);
+			}
+			ReleaseBlock(p);
+		}
+	}
+}
+
+static void* LZHAM_CDECL CodecRealloc(void* p, size_t size, size_t* pActual_size, lzham_bool movable, void* pUser_data)
+{
+	(void)pUser_data;
+	void* result = NULL;
+	if (!p)
+		result = PoolAlloc(size);
+	else if (!size)
+		PoolFree(p);
+	else if (size <= BlockCapacity(p))
+		result = p;
+	else if (movable && (result = PoolAlloc(size)) != NULL)
+	{
+		memcpy(result, p, BlockCapacity(p));
+		PoolFree(p);
+	}
+	if (pActual_size)
+		*pActual_size = result ? BlockCapacity(result) : (p && size ? BlockCapacity(p) : 0);
+	return result;
+}
+
+static size_t LZHAM_CDECL CodecMSize(void* p, void* pUser_data)
+{
+	(void)pUser_data;
+	return p ? BlockCapacity(p) : 0;
+}
+
+// Installed when the library loads, before lzham can allocate anything.
+static struct CodecAllocatorInstaller
+{
+	CodecAllocatorInstaller() { lzham_set_memory_callbacks(CodecRealloc, CodecMSize, NULL); }
+} g_CodecAllocatorInstaller;
+
+// Tunable subset of lzham_compress_params, laid out so it can be marshalled directly from managed code.
+// TableUpdateRate, the table intervals and the seed bytes must be passed unchanged to the matching decompression stream.
+struct CompressionParams
+{
+	int Level;                              // LZHAM_COMP_LEVEL_FASTEST (0) to LZHAM_COMP_LEVEL_UBER (4)
+	int DictionaryBits;
+	int MaxHelperThreads;                   // -1 = as many as the helper pool allows, 0 = single threaded
+	unsigned int TableUpdateRate;           // 0 = default, otherwise [1, LZHAM_FASTEST_TABLE_UPDATE_RATE]
+	unsigned int CompressFlags;             // lzham_compress_flags, LZHAM_COMP_FLAG_WRITE_ZLIB_STREAM is always added, plus AdaptiveChunksCompressFlag
+	unsigned int TableMaxUpdateInterval;
+	unsigned int TableUpdateIntervalSlowRate;
+	unsigned int SeedSize;
+	const unsigned char* SeedBytes;
+};
+
+struct DecompressionParams
+{
+	int DictionaryBits;
+	unsigned int TableUpdateRate;
+	unsigned int DecompressFlags;           // lzham_decompress_flags, LZHAM_DECOMP_FLAG_READ_ZLIB_STREAM is always added
+	unsigned int TableMaxUpdateInterval;
+	unsigned int TableUpdateIntervalSlowRate;
+	unsigned int SeedSize;
+	const unsigned char* SeedBytes;
+};
+
+// Wrapper-only CompressFlags bit: the chunked exports probe each unseeded chunk and store it raw, at the fastest level, or at
+// params->Level, whichever the probe says is worth it. Never passed on to lzham.
+static const unsigned int AdaptiveChunksCompressFlag = 0x10000;
+
+static void TranslateParams(const CompressionParams* params, lzham_compress_params& result)
+{
+	memset(&result, 0, sizeof(result));
+	result.m_struct_size = sizeof(result);
+	result.m_dict_size_log2 = params->DictionaryBits;
+	result.m_level = (lzham_compress_level)params->Level;
+	result.m_table_update_rate = params->TableUpdateRate;
+	result.m_max_helper_threads = params->MaxHelperThreads;
+	result.m_compress_flags = (params->CompressFlags & ~AdaptiveChunksCompressFlag) | LZHAM_COMP_FLAG_WRITE_ZLIB_STREAM;
+	result.m_num_seed_bytes = params->SeedSize;
+	result.m_pSeed_bytes = params->SeedBytes;
+	result.m_table_max_update_interval = params->TableMaxUpdateInterval;
+	result.m_table_update_interval_slow_rate = params->TableUpdateIntervalSlowRate;
+}
+
+static void TranslateParams(const DecompressionParams* params, lzham_decompress_params& result)
+{
+	memset(&result, 0, sizeof(result));
+	result.m_struct_size = sizeof(result);
+	result.m_dict_size_log2 = params->DictionaryBits;
+	result.m_table_update_rate = params->TableUpdateRate;
+	result.m_decompress_flags = params->DecompressFlags | LZHAM_DECOMP_FLAG_READ_ZLIB_STREAM;
+	result.m_num_seed_bytes = params->SeedSize;
+	result.m_pSeed_bytes = params->SeedBytes;
+	result.m_table_max_update_interval = params->TableMaxUpdateInterval;
+	result.m_table_update_interval_slow_rate = params->TableUpdateIntervalSlowRate;
+}
+
+// Puts a natively initialised lzham state behind a z_stream, so the zlib-style exports below work on it unchanged.
+static void ResetStreamFields(z_stream* stream, void* state)
+{
+	memset(stream, 0, sizeof(z_stream));
+	stream->adler = LZHAM_Z_ADLER32_INIT;
+	stream->state = (lzham_z_internal_state*)state;
+}
+
+// Must match ChunkedDecompressionStream.IndependentChunksFlag.
+static const int IndependentChunksFlag = 0x40000000;
+
+// The top bits of each independent chunk's table entry say how it was stored; the rest is its length. Must match ChunkedDecompressionStream.
+static const int ChunkModeShift = 30;
+static const unsigned int ChunkLengthMask = (1u << ChunkModeShift) - 1;
+enum ChunkMode
+{
+	ChunkModeDefault = 0,                   // lzham at the container's level
+	ChunkModeStored = 1,                    // raw bytes
+	ChunkModeFast = 2,                      // lzham at LZHAM_COMP_LEVEL_FASTEST, decoded like ChunkModeDefault
+};
+
+static inline unsigned int ChunkLength(unsigned int entry)
+{
+	return entry & ChunkLengthMask;
+}
+
+static inline ChunkMode GetChunkMode(unsigned int entry)
+{
+	return (ChunkMode)(entry >> ChunkModeShift);
+}
+
+// Upper bound on chunks held in memory at once by the file entry points. Seeded chunks also carry a seed window
+// and a much larger dictionary each, so fewer of them are in flight.
+static const int MaxBatchChunks = 8;
+static const int MaxSeededBatchChunks = 2;
+
+typedef void (*ProgressCallback)(long long processed);
+
+static void TranslateDecompressionParams(const DecompressionParams* params, lzham_decompress_params& result)
+{
+	DecompressionParams defaults;
+	if (!params)
+	{
+		memset(&defaults, 0, sizeof(defaults));
+		defaults.DictionaryBits = 23;
+		params = &defaults;
+	}
+	TranslateParams(params, result);
+}
+
+// A ParallelFor call waiting for pool workers to help with it.
+struct ChunkJob
+{
+	void (*Run)(void* context);
+	void* Context;
+	int Helpers;                            // workers that may still join
+	int Active;                             // workers currently running it
+};
+
+// Persistent workers shared by every ParallelFor in the process, one per core less the caller's. Area compresses several records
+// at once, so per-call threads would multiply; here concurrent calls queue for the same workers, and each caller works on its own
+// job too so it always makes progress. Created on first use and never torn down, like the codec pool above.
+struct ChunkWorkerPool
+{
+	std::mutex Lock;
+	std::condition_variable Wake;
+	std::condition_variable Done;
+	std::vector<ChunkJob*> Jobs;
+
+	ChunkWorkerPool(int threads)
+	{
+		for (int i = 0; i < threads; i++)
+			std::thread([this]() { WorkerLoop(); }).detach();
+	}
+
+	void WorkerLoop()
+	{
+		std::unique_lock<std::mutex> guard(Lock);
+		for (;;)
+		{
+			auto job = std::find_if(Jobs.begin(), Jobs.end(), [](ChunkJob* j) { return j->Helpers > 0; });
+			if (job == Jobs.end())
+			{
+				Wake.wait(guard);
+				continue;
+			}
+			ChunkJob* current = *job;
+			current->Helpers--;
+			current->Active++;
+			guard.unlock();
+			current->Run(current->Context);
+			guard.lock();
+			if (--current->Active == 0)
+				Done.notify_all();
+		}
+	}
+
+	void Run(ChunkJob& job)
+	{
+		{
+			std::lock_guard<std::mutex> guard(Lock);
+			Jobs.push_back(&job);
+		}
+		Wake.notify_all();
+		job.Run(job.Context);
+		std::unique_lock<std::mutex> guard(Lock);
+		Jobs.erase(std::find(Jobs.begin(), Jobs.end(), &job));
+		Done.wait(guard, [&]() { return job.Active == 0; });
+	}
+};
+
+static ChunkWorkerPool& GetChunkWorkerPool()
+{
+	static ChunkWorkerPool* pool = new ChunkWorkerPool(std::max(1, (int)std::thread::hardware_concurrency()) - 1);
+	return *pool;
+}
+
+// Runs work(i) for every i in [0, count) on the caller and up to `threads` - 1 pool workers (<= 0 = one per core). Stops handing out
+// work once a call fails.
+template<typename Work>
+static bool ParallelFor(int count, int threads, const Work& work)
+{
+	std::atomic<int> next(0);
+	std::atomic<bool> failed(false);
+	auto worker = [&]()
+	{
+		int i;
+		while (!failed && (i = next++) < count)
+		{
+			if (!work(i))
+				failed = true;
+		}
+	};
+
+	if (threads <= 0)
+		threads = (int)std::thread::hardware_concurrency();
+	if (threads > count)
+		threads = count;
+	if (threads <= 1)
+	{
+		worker();
+		return !failed;
+	}
+	ChunkJob job = { [](void* context) { (*(decltype(worker)*)context)(); }, &worker, threads - 1, 0 };
+	GetChunkWorkerPool().Run(job);
+	return !failed;
+}
+
+// Chunks compressed side by side already occupy the cores, so they don't also draw lzham helper threads.
+static void ParallelChunkParams(lzham_compress_params& params, int chunkCount, int threads)
+{
+	if (chunkCount > 1 && threads != 1)
+		params.m_max_helper_threads = 0;
+}
+
+static int ChunkBatchSize(int threads, long long chunkCount)
+{
+	if (threads <= 0)
+		threads = (int)std::thread::hardware_concurrency();
+	if (threads > MaxBatchChunks)
+		threads = MaxBatchChunks;
+	if (threads > chunkCount)
+		threads = (int)chunkCount;
+	return threads < 1 ? 1 : threads;
+}
+
+// Running totals for the chunked exports, which compress several chunks at once.
+struct StatsTotal
+{
+	lzham_compress_stats* Stats;
+	std::mutex Lock;
+
+	StatsTotal(lzham_compress_stats* stats) : Stats(stats)
+	{
+		if (Stats)
+		{
+			memset(Stats, 0, sizeof(lzham_compress_stats));
+			Stats->m_struct_size = sizeof(lzham_compress_stats);
+		}
+	}
+
+	void Add(const lzham_compress_stats& chunk)
+	{
+		std::lock_guard<std::mutex> guard(Lock);
+		if (chunk.m_max_helper_threads > Stats->m_max_helper_threads)
+			Stats->m_max_helper_threads = chunk.m_max_helper_threads;
+		Stats->m_bytes_in += chunk.m_bytes_in;
+		Stats->m_bytes_out += chunk.m_bytes_out;
+		Stats->m_blocks += chunk.m_blocks;
+		Stats->m_raw_blocks += chunk.m_raw_blocks;
+		Stats->m_parse_us += chunk.m_parse_us;
+		Stats->m_parse_busy_us += chunk.m_parse_busy_us;
+		Stats->m_helper_parse_busy_us += chunk.m_helper_parse_busy_us;
+		Stats->m_coding_us += chunk.m_coding_us;
+		Stats->m_match_finder_wait_us += chunk.m_match_finder_wait_us;
+		Stats->m_parse_jobs += chunk.m_parse_jobs;
+		Stats->m_helper_parse_jobs += chunk.m_helper_parse_jobs;
+		Stats->m_literals += chunk.m_literals;
+		Stats->m_matches += chunk.m_matches;
+		Stats->m_rep_matches += chunk.m_rep_matches;
+		Stats->m_total_match_len += chunk.m_total_match_len;
+	}
+
+	void AddStored(size_t length)
+	{
+		std::lock_guard<std::mutex> guard(Lock);
+		Stats->m_bytes_in += length;
+		Stats->m_bytes_out += length;
+		Stats->m_raw_blocks++;
+	}
+};
+
+// Probe: order-0 entropy of a few slices spread over the chunk, then, unless the data is plainly compressible, a fastest-level
+// trial on the same sample. Already compressed data (images, archives, video) is stored, and data that barely compresses is
+// not worth the full level's parsing time.
+static const size_t ProbeMinChunk = 16 * 1024;
+static const int ProbeSlices = 4;
+static const size_t ProbeSliceBytes = 16 * 1024;
+static const int ProbeDictionaryBits = 17;
+static const double ProbeCompressibleBits = 6.0;
+static const double ProbeStoreRatio = 0.97;
+static const double ProbeFastRatio = 0.90;
+
+static ChunkMode ProbeChunk(const lzham_compress_params& params, const unsigned char* input, size_t length)
+{
+	if (length < ProbeMinChunk)
+		return ChunkModeDefault;
+	size_t slice = std::min(ProbeSliceBytes, length / ProbeSlices);
+	std::vector<unsigned char> sample;
+	sample.reserve(slice * ProbeSlices);
+	for (int i = 0; i < ProbeSlices; i++)
+	{
+		const unsigned char* start = input + (length - slice) * i / (ProbeSlices - 1);
+		sample.insert(sample.end(), start, start + slice);
+	}
+
+	size_t histogram[256] = { 0 };
+	for (unsigned char c : sample)
+		histogram[c]++;
+	double entropy = 0;
+	for (size_t count : histogram)
+	{
+		if (count)
+		{
+			double p = (double)count / sample.size();
+			entropy -= p * log2(p);
+		}
+	}
+	if (entropy < ProbeCompressibleBits)
+		return ChunkModeDefault;
+
+	lzham_compress_params trial = params;
+	trial.m_level = LZHAM_COMP_LEVEL_FASTEST;
+	trial.m_dict_size_log2 = ProbeDictionaryBits;
+	trial.m_max_helper_threads = 0;
+	std::vector<unsigned char> trialOutput(compressBound((unsigned long)sample.size()));
+	size_t trialLength = trialOutput.size();
+	if (lzham_compress_memory(&trial, &trialOutput[0], &trialLength, &sample[0], sample.size(), NULL) != LZHAM_COMP_STATUS_SUCCESS)
+		return ChunkModeDefault;
+	double ratio = (double)trialLength / sample.size();
+	if (ratio >= ProbeStoreRatio)
+		return ChunkModeStored;
+	if (ratio >= ProbeFastRatio)
+		return ChunkModeFast;
+	return ChunkModeDefault;
+}
+
+// Compresses one independent chunk. lzham_compress_memory leaves nothing to query afterwards, so when statistics are wanted the
+// chunk goes through a compressor state instead. The statistics are returned rather than totalled, since the caller may still
+// discard the result.
+static bool CompressChunk(const lzham_compress_params& params, const unsigned char* input, size_t inputLength, unsigned char* output, size_t& outputLength, lzham_compress_stats* stats)
+{
+	if (!stats)
+		return lzham_compress_memory(&params, output, &outputLength, input, inputLength, NULL) == LZHAM_COMP_STATUS_SUCCESS;
+
+	lzham_compress_state_ptr state = lzham_compress_init(&params);
+	if (!state)
+		return false;
+	size_t inPos = 0;
+	size_t outPos = 0;
+	lzham_compress_status_t status = LZHAM_COMP_STATUS_NOT_FINISHED;
+	while (status < LZHAM_COMP_STATUS_FIRST_SUCCESS_OR_FAILURE_CODE && outPos < outputLength)
+	{
+		size_t inSize = inputLength - inPos;
+		size_t outSize = outputLength - outPos;
+		status = lzham_compress2(state, input + inPos, &inSize, output + outPos, &outSize, LZHAM_FINISH);
+		inPos += inSize;
+		outPos += outSize;
+	}
+	stats->m_struct_size = sizeof(lzham_compress_stats);
+	bool succeeded = status == LZHAM_COMP_STATUS_SUCCESS && lzham_compress_get_stats(state, stats);
+	lzham_compress_deinit(state);
+	if (!succeeded)
+		return false;
+	outputLength = outPos;
+	return true;
+}
+
+// With adaptive set, every chunk is probed first and its ChunkMode goes in the top bits of its compressedSizes entry.
+static bool CompressChunkRange(const lzham_compress_params& params, const unsigned char* input, int inputLength, int chunkSize, unsigned char* output, int outputStride, unsigned int* compressedSizes, int threads, bool adaptive, StatsTotal& total)
+{
+	adaptive = adaptive && !params.m_num_seed_bytes;
+	int chunkCount = (int)(((long long)inputLength + chunkSize - 1) / chunkSize);
+	lzham_compress_params baseParams = params;
+	ParallelChunkParams(baseParams, chunkCount, threads);
+	return ParallelFor(chunkCount, threads, [&](int chunk)
+	{
+		long long offset = (long long)chunk * chunkSize;
+		size_t srcLength = (size_t)((inputLength - offset) < chunkSize ? (inputLength - offset) : chunkSize);
+		size_t dstLength = (size_t)outputStride;
+		unsigned char* chunkOutput = output + (long long)chunk * outputStride;
+		ChunkMode mode = adaptive ? ProbeChunk(params, input + offset, srcLength) : ChunkModeDefault;
+		if (mode != ChunkModeStored)
+		{
+			lzham_compress_params chunkParams = baseParams;
+			if (mode == ChunkModeFast)
+				chunkParams.m_level = LZHAM_COMP_LEVEL_FASTEST;
+			lzham_compress_stats chunkStats;
+			if (!CompressChunk(chunkParams, input + offset, srcLength, chunkOutput, dstLength, total.Stats ? &chunkStats : NULL))
+				return false;
+			if (adaptive && dstLength >= srcLength)
+				mode = ChunkModeStored;
+			else if (total.Stats)
+				total.Add(chunkStats);
+		}
+		if (mode == ChunkModeStored)
+		{
+			memcpy(chunkOutput, input + offset, srcLength);
+			dstLength = srcLength;
+			if (total.Stats)
+				total.AddStored(srcLength);
+		}
+		compressedSizes[chunk] = (unsigned int)dstLength | ((unsigned int)mode << ChunkModeShift);
+		return true;
+	});
+}
+
+// lzham_decompress_memory always decodes unbuffered, which cannot take seed bytes, so seeded chunks go through a buffered state.
+static bool DecompressSeededChunk(const lzham_decompress_params& params, const unsigned char* input, size_t inputLength, unsigned char* output, size_t outputLength)
+{
+	lzham_decompress_state_ptr state = lzham_decompress_init(&params);
+	if (!state)
+		return false;
+	size_t inPos = 0;
+	size_t outPos = 0;
+	lzham_decompress_status_t status;
+	do
+	{
+		size_t inBytes = inputLength - inPos;
+		size_t outBytes = outputLength - outPos;
+		status = lzham_decompress(state, input + inPos, &inBytes, output + outPos, &outBytes, true);
+		inPos += inBytes;
+		outPos += outBytes;
+		// The output can fill up before the stream trailer is consumed, so keep going until the codec stops making progress.
+		if (!inBytes && !outBytes)
+			break;
+	} while (status < LZHAM_DECOMP_STATUS_FIRST_SUCCESS_OR_FAILURE_CODE);
+	lzham_decompress_deinit(state);
+	return status == LZHAM_DECOMP_STATUS_SUCCESS && outPos == outputLength;
+}
+
+static bool DecompressChunkRange(const lzham_decompress_params& params, const unsigned char* input, const unsigned int* compressedSizes, int chunkCount, int chunkSize, unsigned char* output, int outputLength, int threads)
+{
+	std::vector<long long> inputOffsets(chunkCount);
+	long long inputOffset = 0;
+	for (int i = 0; i < chunkCount; i++)
+	{
+		inputOffsets[i] = inputOffset;
+		inputOffset += ChunkLength(compressedSizes[i]);
+	}
+
+	return ParallelFor(chunkCount, threads, [&](int chunk)
+	{
+		long long offset = (long long)chunk * chunkSize;
+		size_t dstLength = (size_t)((outputLength - offset) < chunkSize ? (outputLength - offset) : chunkSize);
+		size_t expected = dstLength;
+		size_t srcLength = ChunkLength(compressedSizes[chunk]);
+		if (GetChunkMode(compressedSizes[chunk]) == ChunkModeStored)
+		{
+			if (srcLength != dstLength)
+				return false;
+			memcpy(output + offset, input + inputOffsets[chunk], srcLength);
+			return true;
+		}
+		if (params.m_num_seed_bytes)
+			return DecompressSeededChunk(params, input + inputOffsets[chunk], srcLength, output + offset, dstLength);
+		return lzham_decompress_memory(&params, output + offset, &dstLength, input + inputOffsets[chunk], srcLength, NULL) == LZHAM_DECOMP_STATUS_SUCCESS && dstLength == expected;
+	});
+}
+
+#ifdef _WIN32
+static bool ReadAt(intptr_t file, void* buffer, size_t length, long long offset)
+{
+	unsigned char* data = (unsigned char*)buffer;
+	while (length > 0)
+	{
+		OVERLAPPED overlapped;
+		memset(&overlapped, 0, sizeof(overlapped));
+		overlapped.Offset = (DWORD)offset;
+		overlapped.OffsetHigh = (DWORD)(offset >> 32);
+		DWORD count = 0;
+		if (!ReadFile((HANDLE)file, data, length > 0x40000000 ? 0x40000000 : (DWORD)length, &count, &overlapped) || count == 0)
+			return false;
+		data += count;
+		length -= count;
+		offset += count;
+	}
+	return true;
+}
+
+static bool WriteAt(intptr_t file, const void* buffer, size_t length, long long offset)
+{
+	const unsigned char* data = (const unsigned char*)buffer;
+	while (length > 0)
+	{
+		OVERLAPPED overlapped;
+		memset(&overlapped, 0, sizeof(overlapped));
+		overlapped.Offset = (DWORD)offset;
+		overlapped.OffsetHigh = (DWORD)(offset >> 32);
+		DWORD count = 0;
+		if (!WriteFile((HANDLE)file, data, length > 0x40000000 ? 0x40000000 : (DWORD)length, &count, &overlapped) || count == 0)
+			return false;
+		data += count;
+		length -= count;
+		offset += count;
+	}
+	return true;
+}
+#else
+static bool ReadAt(intptr_t file, void* buffer, size_t length, long long offset)
+{
+	unsigned char* data = (unsigned char*)buffer;
+	while (length > 0)
+	{
+		ssize_t count = pread((int)file, data, length, (off_t)offset);
+		if (count < 0 && errno == EINTR)
+			continue;
+		if (count <= 0)
+			return false;
+		data += count;
+		length -= count;
+		offset += count;
+	}
+	return true;
+}
+
+static bool WriteAt(intptr_t file, const void* buffer, size_t length, long long offset)
+{
+	const unsigned char* data = (const unsigned char*)buffer;
+	while (length > 0)
+	{
+		ssize_t count = pwrite((int)file, data, length, (off_t)offset);
+		if (count < 0 && errno == EINTR)
+			continue;
+		if (count <= 0)
+			return false;
+		data += count;
+		length -= count;
+		offset += count;
+	}
+	return true;
+}
+#endif
+
+#ifndef _WIN32
+// Allocates the blocks of [from, to) so that page faults in a shared mapping can't hit a full disk, which would raise SIGBUS
+// instead of failing a write. Filesystems without fallocate get one byte written per block instead.
+static bool ReserveRange(int file, long long from, long long to, long long blockSize)
+{
+#if defined(__linux__)
+	if (fallocate(file, 0, (off_t)from, (off_t)(to - from)) == 0)
+		return true;
+	if (errno != EOPNOTSUPP && errno != ENOSYS)
+		return false;
+#elif !defined(__APPLE__)
+	int result = posix_fallocate(file, (off_t)from, (off_t)(to - from));
+	if (result == 0)
+		return true;
+	if (result != EOPNOTSUPP && result != EINVAL)
+		return false;
+#endif
+	if (blockSize <= 0)
+		blockSize = 4096;
+	const unsigned char zero = 0;
+	for (long long pos = from; pos < to; pos += blockSize - pos % blockSize)
+	{
+		if (!WriteAt(file, &zero, 1, pos))
+			return false;
+	}
+	return WriteAt(file, &zero, 1, to - 1);
+}
+#endif
+
+// The destination range of an output file, grown to its final size and mapped writable so chunks decode straight into
+// the page cache instead of a staging buffer. Open fails for pipes, write-only handles and views too large for the
+// address space; callers then fall back to WriteAt. Unless Commit is called, the file is cut back to its original size on
+// destruction, so a failed decode doesn't leave it grown.
+struct MappedOutput
+{
+	unsigned char* Data;
+	unsigned char* View;
+	size_t ViewLength;
+	intptr_t File;
+	long long OriginalSize;
+	bool Grown;
+#ifdef _WIN32
+	HANDLE Mapping;
+
+	MappedOutput() : Data(NULL), View(NULL), ViewLength(0), File(0), OriginalSize(0), Grown(false), Mapping(NULL) {}
+#else
+	MappedOutput() : Data(NULL), View(NULL), ViewLength(0), File(0), OriginalSize(0), Grown(false) {}
+#endif
+	~MappedOutput() { Abandon(); }
+
+	bool Open(intptr_t file, long long offset, long long length)
+	{
+		if (offset < 0 || length <= 0)
+			return false;
+		File = file;
+		long long end = offset + length;
+#ifdef _WIN32
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		long long start = offset - offset % info.dwAllocationGranularity;
+		if ((unsigned long long)(end - start) > (SIZE_T)-1)
+			return false;
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx((HANDLE)file, &size))
+			return false;
+		OriginalSize = size.QuadPart;
+		// A mapping larger than the file extends it without writing the new range first.
+		Mapping = CreateFileMappingW((HANDLE)file, NULL, PAGE_READWRITE, (DWORD)(end >> 32), (DWORD)end, NULL);
+		if (!Mapping)
+			return false;
+		Grown = OriginalSize < end;
+		View = (unsigned char*)MapViewOfFile(Mapping, FILE_MAP_WRITE, (DWORD)(start >> 32), (DWORD)start, (SIZE_T)(end - start));
+		if (!View)
+		{
+			Abandon();
+			return false;
+		}
+#else
+		long long page = sysconf(_SC_PAGESIZE);
+		long long start = offset - offset % page;
+		if ((unsigned long long)(end - start) > (size_t)-1)
+			return false;
+		struct stat info;
+		if (fstat((int)file, &info) != 0 || !S_ISREG(info.st_mode))
+			return false;
+		OriginalSize = info.st_size;
+		if (info.st_size < end)
+		{
+			Grown = true;
+			if (!ReserveRange((int)file, info.st_size, end, info.st_blksize) || ftruncate((int)file, (off_t)end) != 0)
+			{
+				Abandon();
+				return false;
+			}
+		}
+		void* view = mmap(NULL, (size_t)(end - start), PROT_READ | PROT_WRITE, MAP_SHARED, (int)file, (off_t)start);
+		if (view == MAP_FAILED)
+		{
+			Abandon();
+			return false;
+		}
+		View = (unsigned char*)view;
+#endif
+		ViewLength = (size_t)(end - start);
+		Data = View + (offset - start);
+		return true;
+	}
+
+	// Keeps the file at its grown size once the whole range has been written.
+	void Commit()
+	{
+		Grown = false;
+	}
+
+	void Close()
+	{
+#ifdef _WIN32
+		if (View)
+			UnmapViewOfFile(View);
+		if (Mapping)
+			CloseHandle(Mapping);
+		Mapping = NULL;
+#else
+		if (View)
+			munmap(View, ViewLength);
+#endif
+		Data = NULL;
+		View = NULL;
+		ViewLength = 0;
+	}
+
+	void Abandon()
+	{
+		Close();
+		if (Grown)
+			Shrink();
+		Grown = false;
+	}
+
+	void Shrink()
+	{
+#ifdef _WIN32
+		FILE_END_OF_FILE_INFO eof;
+		eof.EndOfFile.QuadPart = OriginalSize;
+		SetFileInformationByHandle((HANDLE)File, FileEndOfFileInfo, &eof, sizeof(eof));
+#else
+		// Best effort: the decode has already failed, and that is what gets reported.
+		if (ftruncate((int)File, (off_t)OriginalSize) != 0)
+			return;
+#endif
+	}
+};
+
+// Fills `length` bytes of a base that is not in a file, starting at `offset`. May be called from several workers at once.
+typedef bool (*SeedReadCallback)(long long offset, unsigned char* buffer, int length);
+
+// A region of an open file, or a base read through a callback, whose contents seed the compressor for each chunk.
+struct SeedSource
+{
+	intptr_t File;
+	long long Offset;
+	long long Length;
+	SeedReadCallback Read;
+};
+
+// Picks as much of the base as fits in the dictionary beside one chunk, centred on the chunk's own offset so that
+// edits which shift data a little still find their matches.
+static void SeedWindow(long long chunkOffset, int chunkSize, long long baseLength, int dictionaryBits, long long& seedOffset, long long& seedLength)
+{
+	long long window = (1LL << dictionaryBits) - chunkSize;
+	if (window > baseLength)
+		window = baseLength;
+	if (window <= 0)
+	{
+		seedOffset = 0;
+		seedLength = 0;
+		return;
+	}
+	long long start = chunkOffset - (window - chunkSize) / 2;
+	if (start > baseLength - window)
+		start = baseLength - window;
+	if (start < 0)
+		start = 0;
+	seedOffset = start;
+	seedLength = window;
+}
+
+static bool ReadSeed(const SeedSource& seed, long long chunkOffset, int chunkSize, int dictionaryBits, std::vector<unsigned char>& buffer)
+{
+	long long seedOffset, seedLength;
+	SeedWindow(chunkOffset, chunkSize, seed.Length, dictionaryBits, seedOffset, seedLength);
+	buffer.resize((size_t)seedLength);
+	if (seedLength == 0)
+		return true;
+	if (seed.Read)
+		return seed.Read(seed.Offset + seedOffset, &buffer[0], (int)seedLength);
+	return ReadAt(seed.File, &buffer[0], (size_t)seedLength, seed.Offset + seedOffset);
+}
+
+static long long CompressFileInternal(const lzham_compress_params& lzparams, intptr_t inFile, long long inOffset, long long length, const SeedSource* seed, intptr_t outFile, long long outOffset, int chunkSize, int threads, bool adaptive, ProgressCallback progress, lzham_compress_stats* stats)
+{
+	StatsTotal total(stats);
+	if (chunkSize <= 0 || length < 0)
+		return -1;
+	long long chunkCount = (length + chunkSize - 1) / chunkSize;
+	if (chunkCount > 0x7FFFFFFF)
+		return -1;
+	int batchChunks = ChunkBatchSize(threads, chunkCount);
+	if (seed && batchChunks > MaxSeededBatchChunks)
+		batchChunks = MaxSeededBatchChunks;
+	int stride = (int)compressBound(chunkSize);
+	std::vector<unsigned char> input((size_t)batchChunks * chunkSize);
+	std::vector<unsigned char> output((size_t)batchChunks * stride);
+	std::vector<unsigned int> sizes((size_t)chunkCount + 1);
+
+	long long tableSize = chunkCount * 4 + 4;
+	long long outPos = outOffset + tableSize;
+	for (long long chunk = 0; chunk < chunkCount; chunk += batchChunks)
+	{
+		long long offset = chunk * chunkSize;
+		int available = (int)((length - offset) < (long long)batchChunks * chunkSize ? (length - offset) : (long long)batchChunks * chunkSize);
+		int count = (available + chunkSize - 1) / chunkSize;
+		if (!ReadAt(inFile, &input[0], available, inOffset + offset))
+			return -1;
+		bool compressed;
+		if (!seed)
+			compressed = CompressChunkRange(lzparams, &input[0], available, chunkSize, &output[0], stride, &sizes[1 + chunk], threads, adaptive, total);
+		else
+		{
+			compressed = ParallelFor(count, threads, [&](int i)
+			{
+				long long chunkOffset = offset + (long long)i * chunkSize;
+				std::vector<unsigned char> seedBytes;
+				if (!ReadSeed(*seed, chunkOffset, chunkSize, lzparams.m_dict_size_log2, seedBytes))
+					return false;
+				lzham_compress_params chunkParams = lzparams;
+				ParallelChunkParams(chunkParams, count, threads);
+				chunkParams.m_num_seed_bytes = (lzham_uint32)seedBytes.size();
+				chunkParams.m_pSeed_bytes = seedBytes.empty() ? NULL : &seedBytes[0];
+				size_t srcLength = (size_t)((length - chunkOffset) < chunkSize ? (length - chunkOffset) : chunkSize);
+				size_t dstLength = (size_t)stride;
+				lzham_compress_stats chunkStats;
+				if (!CompressChunk(chunkParams, &input[(size_t)i * chunkSize], srcLength, &output[(size_t)i * stride], dstLength, total.Stats ? &chunkStats : NULL))
+					return false;
+				if (total.Stats)
+					total.Add(chunkStats);
+				sizes[1 + chunk + i] = (unsigned int)dstLength;
+				return true;
+			});
+		}
+		if (!compressed)
+			return -1;
+		for (int i = 0; i < count; i++)
+		{
+			unsigned int chunkLength = ChunkLength(sizes[1 + chunk + i]);
+			if (!WriteAt(outFile, &output[(size_t)i * stride], chunkLength, outPos))
+				return -1;
+			outPos += chunkLength;
+		}
+		if (progress)
+			progress(offset + available);
+	}
+	sizes[0] = (unsigned int)(chunkSize | IndependentChunksFlag);
+	if (!WriteAt(outFile, &sizes[0], (size_t)tableSize, outOffset))
+		return -1;
+	return outPos - outOffset;
+}
+
+static bool DecompressFileInternal(const lzham_decompress_params& lzparams, intptr_t inFile, long long inOffset, long long length, const SeedSource* seed, intptr_t outFile, long long outOffset, int threads)
+{
+	if (length <= 0)
+		return false;
+	int chunkSize;
+	if (!ReadAt(inFile, &chunkSize, 4, inOffset) || (chunkSize & IndependentChunksFlag) == 0)
+		return false;
+	chunkSize &= ~IndependentChunksFlag;
+	if (chunkSize <= 0)
+		return false;
+
+	long long chunkCount = (length + chunkSize - 1) / chunkSize;
+	if (chunkCount > 0x7FFFFFFF)
+		return false;
+	std::vector<unsigned int> sizes((size_t)chunkCount);
+	if (!ReadAt(inFile, &sizes[0], (size_t)chunkCount * 4, inOffset + 4))
+		return false;
+
+	int batchChunks = ChunkBatchSize(threads, chunkCount);
+	if (seed && batchChunks > MaxSeededBatchChunks)
+		batchChunks = MaxSeededBatchChunks;
+	std::vector<unsigned char> input;
+	MappedOutput mapped;
+	bool direct = mapped.Open(outFile, outOffset, length);
+	std::vector<unsigned char> output(direct ? 0 : (size_t)batchChunks * chunkSize);
+	long long inPos = inOffset + chunkCount * 4 + 4;
+	for (long long chunk = 0; chunk < chunkCount; chunk += batchChunks)
+	{
+		int count = (int)((chunkCount - chunk) < batchChunks ? (chunkCount - chunk) : batchChunks);
+		size_t compressedLength = 0;
+		for (int i = 0; i < count; i++)
+			compressedLength += ChunkLength(sizes[chunk + i]);
+		if (input.size() < compressedLength)
+			input.resize(compressedLength);
+		if (!ReadAt(inFile, &input[0], compressedLength, inPos))
+			return false;
+		inPos += compressedLength;
+
+		long long offset = chunk * chunkSize;
+		int outputLength = (int)((length - offset) < (long long)count * chunkSize ? (length - offset) : (long long)count * chunkSize);
+		unsigned char* dst = direct ? mapped.Data + offset : &output[0];
+		bool decompressed;
+		if (!seed)
+			decompressed = DecompressChunkRange(lzparams, &input[0], &sizes[chunk], count, chunkSize, dst, outputLength, threads);
+		else
+		{
+			std::vector<size_t> inputOffsets(count);
+			for (int i = 1; i < count; i++)
+				inputOffsets[i] = inputOffsets[i - 1] + ChunkLength(sizes[chunk + i - 1]);
+			decompressed = ParallelFor(count, threads, [&](int i)
+			{
+				long long chunkOffset = offset + (long long)i * chunkSize;
+				std::vector<unsigned char> seedBytes;
+				if (!ReadSeed(*seed, chunkOffset, chunkSize, lzparams.m_dict_size_log2, seedBytes))
+					return false;
+				lzham_decompress_params chunkParams = lzparams;
+				chunkParams.m_num_seed_bytes = (lzham_uint32)seedBytes.size();
+				chunkParams.m_pSeed_bytes = seedBytes.empty() ? NULL : &seedBytes[0];
+				size_t dstLength = (size_t)((length - chunkOffset) < chunkSize ? (length - chunkOffset) : chunkSize);
+				if (GetChunkMode(sizes[chunk + i]) == ChunkModeStored)
+				{
+					if (ChunkLength(sizes[chunk + i]) != dstLength)
+						return false;
+					memcpy(dst + (size_t)i * chunkSize, &input[inputOffsets[i]], dstLength);
+					return true;
+				}
+				return DecompressSeededChunk(chunkParams, &input[inputOffsets[i]], ChunkLength(sizes[chunk + i]), dst + (size_t)i * chunkSize, dstLength);
+			});
+		}
+		if (!decompressed)
+			return false;
+		if (!direct && !WriteAt(outFile, &output[0], outputLength, outOffset + offset))
+			return false;
+	}
+	mapped.Commit();
+	return true;
+}
+
+// Dictionary training: the dictionary is built from the k-byte segments of the samples that cover the most d-grams shared by
+// several samples. Each d-gram only counts once, so later segments add new material rather than repeating earlier ones.
+static const int TrainGramBytes = 8;
+static const int TrainSegmentBytes = 256;
+static const int TrainHashBits = 20;
+
+static inline unsigned int GramHash(const unsigned char* data)
+{
+	uint64_t value;
+	memcpy(&value, data, sizeof(value));
+	return (unsigned int)((value * 0x9E3779B97F4A7C15ULL) >> (64 - TrainHashBits));
+}
+
+struct TrainedSegment
+{
+	long long Offset;
+	unsigned long long Score;
+};
+
+static int TrainDictionaryInternal(const unsigned char* samples, const unsigned int* sampleSizes, int sampleCount, unsigned char* dictionary, int capacity)
+{
+	long long total = 0;
+	for (int i = 0; i < sampleCount; i++)
+		total += sampleSizes[i];
+	if (capacity < TrainSegmentBytes || total < TrainSegmentBytes)
+		return 0;
+
+	// Number of samples each d-gram appears in. A d-gram crossing into the next sample is never counted.
+	std::vector<unsigned int> frequency((size_t)1 << TrainHashBits);
+	std::vector<int> lastSample((size_t)1 << TrainHashBits, -1);
+	std::vector<unsigned char> valid((size_t)total);
+	long long offset = 0;
+	for (int i = 0; i < sampleCount; i++)
+	{
+		for (long long pos = 0; pos + TrainGramBytes <= sampleSizes[i]; pos++)
+		{
+			unsigned int hash = GramHash(samples + offset + pos);
+			valid[(size_t)(offset + pos)] = 1;
+			if (lastSample[hash] != i)
+			{
+				lastSample[hash] = i;
+				frequency[hash]++;
+			}
+		}
+		offset += sampleSizes[i];
+	}
+	// A d-gram seen in a single sample is not worth dictionary space.
+	for (size_t i = 0; i < frequency.size(); i++)
+	{
+		if (frequency[i] < 2)
+			frequency[i] = 0;
+	}
+
+	// Split the samples into one epoch per segment and take the best segment from each.
+	int segmentCount = capacity / TrainSegmentBytes;
+	long long epochSize = total / segmentCount;
+	if (epochSize < TrainSegmentBytes)
+	{
+		epochSize = TrainSegmentBytes;
+		segmentCount = (int)(total / epochSize);
+	}
+	std::vector<TrainedSegment> segments;
+	for (int epoch = 0; epoch < segmentCount; epoch++)
+	{
+		long long begin = epoch * epochSize;
+		long long end = begin + epochSize - TrainSegmentBytes;
+		TrainedSegment best = { begin, 0 };
+		unsigned long long score = 0;
+		for (long long pos = begin; pos < begin + TrainSegmentBytes - TrainGramBytes; pos++)
+		{
+			if (valid[(size_t)pos])
+				score += frequency[GramHash(samples + pos)];
+		}
+		for (long long pos = begin; pos <= end; pos++)
+		{
+			long long tail = pos + TrainSegmentBytes - TrainGramBytes;
+			if (valid[(size_t)tail])
+				score += frequency[GramHash(samples + tail)];
+			if (score > best.Score)
+			{
+				best.Offset = pos;
+				best.Score = score;
+			}
+			if (valid[(size_t)pos])
+				score -= frequency[GramHash(samples + pos)];
+		}
+		if (best.Score == 0)
+			continue;
+		// Rescore against what is left, as segments picked earlier may already hold some of this one's d-grams.
+		best.Score = 0;
+		for (long long pos = best.Offset; pos <= best.Offset + TrainSegmentBytes - TrainGramBytes; pos++)
+		{
+			if (valid[(size_t)pos])
+			{
+				unsigned int hash = GramHash(samples + pos);
+				best.Score += frequency[hash];
+				frequency[hash] = 0;
+			}
+		}
+		if (best.Score > 0)
+			segments.push_back(best);
+	}
+
+	// LZHAM matches closer to the data are cheaper, so the most valuable segments go last.
+	std::sort(segments.begin(), segments.end(), [](const TrainedSegment& a, const TrainedSegment& b) { return a.Score < b.Score; });
+	int length = 0;
+	for (const TrainedSegment& segment : segments)
+	{
+		memcpy(dictionary + length, samples + segment.Offset, TrainSegmentBytes);
+		length += TrainSegmentBytes;
+	}
+	return length;
+}
+
 extern "C"
 {
+	// Sizes the helper thread pool shared by every compression stream. -1 uses all cores, 0 gives each stream its own threads.
+	bool WRAPPER_API SetCompressionHelperThreads(int threads)
+	{
+		g_HelperPoolConfigured = true;
+		return lzham_set_helper_thread_pool_size(threads) != 0;
+	}
+
+	// Bytes currently held by lzham, the most it has held since the last ResetCodecPeakMemory, and freed blocks kept for reuse.
+	void WRAPPER_API GetCodecMemoryStats(long long* liveBytes, long long* peakBytes, long long* pooledBytes)
+	{
+		if (liveBytes)
+			*liveBytes = g_LiveBytes;
+		if (peakBytes)
+			*peakBytes = g_PeakBytes;
+		if (pooledBytes)
+			*pooledBytes = g_PooledBytes;
+	}
+
+	void WRAPPER_API ResetCodecPeakMemory()
+	{
+		g_PeakBytes = (long long)g_LiveBytes;
+	}
+
+	// Caps the bytes lzham may hold at once (0 = no cap). Past the cap allocations fail, so creating or running a stream
+	// fails cleanly instead of the process running out of memory.
+	void WRAPPER_API SetCodecMemoryLimit(long long limit)
+	{
+		g_MemoryLimit = limit < 0 ? 0 : limit;
+	}
+
+	// Caps the freed blocks kept for reuse, releasing any beyond the new cap. 0 returns everything to the heap.
+	void WRAPPER_API SetCodecPoolLimit(long long limit)
+	{
+		g_PoolLimit = limit < 0 ? 0 : limit;
+		TrimPool(g_PoolLimit);
+	}
+
+	// Whether new blocks of 2 MB and up are mapped as huge pages and pre-faulted (the default). Blocks already pooled keep their backing.
+	void WRAPPER_API SetCodecHugePages(bool enable)
+	{
+		g_HugePages = enable;
+	}
+
 	bool WRAPPER_API DestroyCompressionStream(z_stream* str)
 	{
 		if (deflateEnd(str) != Z_OK)
@@ -43,8 +1392,20 @@ extern "C"
 		return str->adler;
 	}
 
+	// Codec statistics for a compression stream since it was created or last reset.
+	bool WRAPPER_API GetCompressionStats(z_stream* stream, lzham_compress_stats* stats)
+	{
+		if (!stream || !stats)
+			return false;
+		stats->m_struct_size = sizeof(lzham_compress_stats);
+		return lzham_compress_get_stats((lzham_compress_state_ptr)stream->state, stats) != 0;
+	}
+
 	WRAPPER_API lzham_z_stream* CreateCompressionStream(int level, int dictionaryBits)
 	{
+		if (!g_HelperPoolConfigured)
+			SetCompressionHelperThreads(-1);
+
 		z_stream* stream = new z_stream();
 		memset(stream, 0, sizeof(z_stream));
 		stream->next_in = NULL;
@@ -57,6 +1418,35 @@ extern "C"
 		return stream;
 	}
 
+	WRAPPER_API lzham_z_stream* CreateCompressionStreamEx(const CompressionParams* params)
+	{
+		if (!g_HelperPoolConfigured)
+			SetCompressionHelperThreads(-1);
+
+		lzham_compress_params lzparams;
+		TranslateParams(params, lzparams);
+		lzham_compress_state_ptr state = lzham_compress_init(&lzparams);
+		if (!state)
+			return NULL;
+
+		z_stream* stream = new z_stream();
+		ResetStreamFields(stream, state);
+		return stream;
+	}
+
+	// Replaces the stream's compressor with one built from new parameters. The old state is released even on failure.
+	bool WRAPPER_API ReinitCompressionStreamEx(z_stream* stream, const CompressionParams* params)
+	{
+		if (deflateEnd(stream) != Z_OK)
+			return false;
+
+		lzham_compress_params lzparams;
+		TranslateParams(params, lzparams);
+		lzham_compress_state_ptr state = lzham_compress_init(&lzparams);
+		ResetStreamFields(stream, state);
+		return state != NULL;
+	}
+
 	int WRAPPER_API CompressData(z_stream* stream, unsigned char* dataIn, int inLength, unsigned char* dataOut, int outLength, bool flush, bool end)
 	{
 		stream->next_in = dataIn;
@@ -70,6 +1460,122 @@ extern "C"
 		return -1;
 	}
 
+	// Worst case size of one independently compressed chunk.
+	int WRAPPER_API CompressChunkBound(int chunkSize)
+	{
+		return (int)compressBound(chunkSize);
+	}
+
+	// Compresses consecutive chunkSize pieces of the input as independent zlib-framed streams on up to `threads` workers (<= 0 = one per core).
+	// Chunk i is written at output + i * outputStride with its length in compressedSizes[i]. Returns false if any chunk failed.
+	// With AdaptiveChunksCompressFlag, each entry also carries the chunk's ChunkMode in its top bits, as stored in the chunk table.
+	// stats, if given, receives the codec statistics summed over every chunk.
+	bool WRAPPER_API CompressChunks(const CompressionParams* params, const unsigned char* input, int inputLength, int chunkSize, unsigned char* output, int outputStride, unsigned int* compressedSizes, int threads, lzham_compress_stats* stats)
+	{
+		if (!params || chunkSize <= 0 || inputLength < 0)
+			return false;
+		if (!g_HelperPoolConfigured)
+			SetCompressionHelperThreads(-1);
+
+		lzham_compress_params lzparams;
+		TranslateParams(params, lzparams);
+		StatsTotal total(stats);
+		return CompressChunkRange(lzparams, input, inputLength, chunkSize, output, outputStride, compressedSizes, threads, (params->CompressFlags & AdaptiveChunksCompressFlag) != 0, total);
+	}
+
+	// Decodes chunkCount independent chunks stored back to back in input (see CompressChunks) on up to `threads` workers.
+	// Chunk i is written at output + i * chunkSize; the last chunk takes whatever remains of outputLength. Pass NULL params for the defaults.
+	bool WRAPPER_API DecompressChunks(const DecompressionParams* params, const unsigned char* input, const unsigned int* compressedSizes, int chunkCount, int chunkSize, unsigned char* output, int outputLength, int threads)
+	{
+		if (chunkCount <= 0 || chunkSize <= 0 || outputLength < 0 || (long long)(chunkCount - 1) * chunkSize >= outputLength)
+			return false;
+
+		lzham_decompress_params lzparams;
+		TranslateDecompressionParams(params, lzparams);
+		return DecompressChunkRange(lzparams, input, compressedSizes, chunkCount, chunkSize, output, outputLength, threads);
+	}
+
+	// Compresses `length` bytes of inFile starting at inOffset into a chunked container (independent chunks) written at outOffset of outFile.
+	// Files are OS handles (HANDLE on Windows, file descriptors elsewhere) and are accessed positionally, so their file pointers are not relied upon.
+	// progress, if given, is called with the number of input bytes consumed after each batch. Returns the container size or -1 on failure.
+	// stats, if given, receives the codec statistics summed over every chunk.
+	long long WRAPPER_API CompressFile(const CompressionParams* params, intptr_t inFile, long long inOffset, long long length, intptr_t outFile, long long outOffset, int chunkSize, int threads, ProgressCallback progress, lzham_compress_stats* stats)
+	{
+		if (!params)
+			return -1;
+		if (!g_HelperPoolConfigured)
+			SetCompressionHelperThreads(-1);
+
+		lzham_compress_params lzparams;
+		TranslateParams(params, lzparams);
+		return CompressFileInternal(lzparams, inFile, inOffset, length, NULL, outFile, outOffset, chunkSize, threads, (params->CompressFlags & AdaptiveChunksCompressFlag) != 0, progress, stats);
+	}
+
+	// As CompressFile, but every chunk is compressed with the matching window of baseFile (see GetSeedWindow) as its seed dictionary,
+	// so data shared with the base costs next to nothing. params->DictionaryBits should leave room for a seed window beside each chunk.
+	long long WRAPPER_API CompressFileSeeded(const CompressionParams* params, intptr_t inFile, long long inOffset, long long length, intptr_t baseFile, long long baseOffset, long long baseLength, intptr_t outFile, long long outOffset, int chunkSize, int threads, ProgressCallback progress, lzham_compress_stats* stats)
+	{
+		if (!params || baseLength < 0)
+			return -1;
+		if (!g_HelperPoolConfigured)
+			SetCompressionHelperThreads(-1);
+
+		lzham_compress_params lzparams;
+		TranslateParams(params, lzparams);
+		SeedSource seed = { baseFile, baseOffset, baseLength, NULL };
+		return CompressFileInternal(lzparams, inFile, inOffset, length, &seed, outFile, outOffset, chunkSize, threads, false, progress, stats);
+	}
+
+	// As CompressFileSeeded, but the base is read through readSeed, so it can be decoded on demand instead of extracted to a file
+	// first. The container is the same, and decodes with DecompressFileSeeded or any other reader given the same base.
+	long long WRAPPER_API CompressFileSeededCallback(const CompressionParams* params, intptr_t inFile, long long inOffset, long long length, SeedReadCallback readSeed, long long baseLength, intptr_t outFile, long long outOffset, int chunkSize, int threads, ProgressCallback progress, lzham_compress_stats* stats)
+	{
+		if (!params || !readSeed || baseLength < 0)
+			return -1;
+		if (!g_HelperPoolConfigured)
+			SetCompressionHelperThreads(-1);
+
+		lzham_compress_params lzparams;
+		TranslateParams(params, lzparams);
+		SeedSource seed = { 0, 0, baseLength, readSeed };
+		return CompressFileInternal(lzparams, inFile, inOffset, length, &seed, outFile, outOffset, chunkSize, threads, false, progress, stats);
+	}
+
+	// Decodes the chunked container at inOffset of inFile into `length` bytes at outOffset of outFile. Only containers written with
+	// independent chunks can be decoded this way; for anything else false is returned before outFile is touched. Pass NULL params for the defaults.
+	bool WRAPPER_API DecompressFile(const DecompressionParams* params, intptr_t inFile, long long inOffset, long long length, intptr_t outFile, long long outOffset, int threads)
+	{
+		lzham_decompress_params lzparams;
+		TranslateDecompressionParams(params, lzparams);
+		return DecompressFileInternal(lzparams, inFile, inOffset, length, NULL, outFile, outOffset, threads);
+	}
+
+	// Decodes a container written by CompressFileSeeded. baseFile must hold exactly the data it was compressed against.
+	bool WRAPPER_API DecompressFileSeeded(const DecompressionParams* params, intptr_t inFile, long long inOffset, long long length, intptr_t baseFile, long long baseOffset, long long baseLength, intptr_t outFile, long long outOffset, int threads)
+	{
+		if (!params || baseLength < 0)
+			return false;
+		lzham_decompress_params lzparams;
+		TranslateDecompressionParams(params, lzparams);
+		SeedSource seed = { baseFile, baseOffset, baseLength, NULL };
+		return DecompressFileInternal(lzparams, inFile, inOffset, length, &seed, outFile, outOffset, threads);
+	}
+
+	// Builds a seed dictionary of at most `capacity` bytes from sampleCount samples stored back to back in `samples`.
+	// Returns the dictionary length, which is 0 if the samples have too little in common to be worth one.
+	int WRAPPER_API TrainDictionary(const unsigned char* samples, const unsigned int* sampleSizes, int sampleCount, unsigned char* dictionary, int capacity)
+	{
+		if (!samples || !sampleSizes || sampleCount <= 0 || !dictionary || capacity <= 0)
+			return 0;
+		return TrainDictionaryInternal(samples, sampleSizes, sampleCount, dictionary, capacity);
+	}
+
+	// The range of the base data that seeds the chunk starting at chunkOffset of a seeded container.
+	void WRAPPER_API GetSeedWindow(long long chunkOffset, int chunkSize, long long baseLength, int dictionaryBits, long long* seedOffset, long long* seedLength)
+	{
+		SeedWindow(chunkOffset, chunkSize, baseLength, dictionaryBits, *seedOffset, *seedLength);
+	}
+
 	bool WRAPPER_API DestroyDecompressionStream(z_stream* str)
 	{
 		if (inflateEnd(str) != Z_OK)
@@ -92,12 +1598,37 @@ extern "C"
 		return stream;
 	}
 
+	WRAPPER_API lzham_z_stream* CreateDecompressionStreamEx(const DecompressionParams* params)
+	{
+		lzham_decompress_params lzparams;
+		TranslateParams(params, lzparams);
+		lzham_decompress_state_ptr state = lzham_decompress_init(&lzparams);
+		if (!state)
+			return NULL;
+
+		z_stream* stream = new z_stream();
+		ResetStreamFields(stream, state);
+		return stream;
+	}
+
+	// Reinitialises a decompression stream for new parameters, reusing its buffers where the dictionary size allows.
+	bool WRAPPER_API ReinitDecompressionStreamEx(z_stream* stream, const DecompressionParams* params)
+	{
+		lzham_decompress_params lzparams;
+		TranslateParams(params, lzparams);
+		lzham_decompress_state_ptr state = lzham_decompress_reinit((lzham_decompress_state_ptr)stream->state, &lzparams);
+		if (!state)
+			return false;
+		ResetStreamFields(stream, state);
+		return true;
+	}
+
 	WRAPPER_API lzham_z_stream* ResetDecompressionStream(lzham_z_stream* stream)
 	{
 		if (inflateReset(stream) != Z_OK)
 		{
 			if (inflateEnd(stream) != Z_OK)
-				return false;
+				return NULL;
 			delete stream;
 			return NULL;
 		}
@@ -130,4 +1661,35 @@ extern "C"
 			return length;
 		return -1;
 	}
+
+	// Checksums from the shared native module (checksum/checksum.h) for callers passing pinned buffers.
+	unsigned int WRAPPER_API ChecksumAdler32(unsigned int adler, const unsigned char* data, int length)
+	{
+		return checksum_adler32(adler, data, (size_t)length);
+	}
+
+	unsigned int WRAPPER_API ChecksumFastHash(const unsigned char* data, int length)
+	{
+		return checksum_fast_hash(1, data, (size_t)length);
+	}
+
+	unsigned int WRAPPER_API ChecksumCRC32C(unsigned int crc, const unsigned char* data, int length)
+	{
+		return checksum_crc32c(crc, data, (size_t)length);
+	}
+
+	unsigned int WRAPPER_API ChecksumXXHash32(const unsigned char* data, int length, unsigned int seed)
+	{
+		return checksum_xxhash32(data, (size_t)length, seed);
+	}
+
+	unsigned long long WRAPPER_API ChecksumXXHash64(const unsigned char* data, int length, unsigned long long seed)
+	{
+		return checksum_xxhash64(data, (size_t)length, seed);
+	}
+
+	unsigned int WRAPPER_API ChecksumFNVWeak(const unsigned char* data, int length)
+	{
+		return checksum_fnv_weak(data, (size_t)length);
+	}
 }
@@ -2,41 +2,47 @@
 #include <cassert>
 #include <cstring>
 
-LZBuffer::LZBuffer()
+template< int BufBits >
+LZBuffer< BufBits >::LZBuffer()
 {
-  buf = new uint8_t[ LZBUFSIZE ];
+  buf = new uint8_t[ bufSize ];
   bufPos = 0;
 }
 
-LZBuffer::~LZBuffer()
+template< int BufBits >
+LZBuffer< BufBits >::~LZBuffer()
 {
   delete [] buf;
 }
 
-LZPOS LZBuffer::_wrap( LZPOS pos )
+template< int BufBits >
+LZPOS LZBuffer< BufBits >::_wrap( LZPOS pos )
 {
-  return ( pos & LZBUFMASK );
+  return ( pos & bufMask );
 }
 
-int LZBuffer::_distance( int diff )
+template< int BufBits >
+int LZBuffer< BufBits >::_distance( int diff )
 {
-  return ( diff & LZBUFMASK );
+  return ( diff & bufMask );
 }
 
-void LZBuffer::_toBuf( uint8_t c )
+template< int BufBits >
+void LZBuffer< BufBits >::_toBuf( uint8_t c )
 {
   buf[ _wrap( bufPos++ ) ] = c;
 }
 
-void LZBuffer::_toBuf( const uint8_t* src, size_t sz )
+template< int BufBits >
+void LZBuffer< BufBits >::_toBuf( const uint8_t* src, size_t sz )
 {
-  assert( sz < LZBUFSIZE );
+  assert( sz < bufSize );
   LZPOS begin = _wrap( bufPos );
   LZPOS end = begin + (LZPOS)sz;
 
-  if ( end > LZBUFSIZE )
+  if ( end > bufSize )
   {
-    size_t left = LZBUFSIZE - begin;
+    size_t left = bufSize - begin;
     memcpy( buf + begin, src, left );
     memcpy( buf, src + left, sz - left );
   }
@@ -48,15 +54,16 @@ void LZBuffer::_toBuf( const uint8_t* src, size_t sz )
   bufPos += sz;
 }
 
-void LZBuffer::_bufCpy( uint8_t* dst, LZPOS pos, size_t sz )
+template< int BufBits >
+void LZBuffer< BufBits >::_bufCpy( uint8_t* dst, LZPOS pos, size_t sz )
 {
-  assert( sz < LZBUFSIZE );
+  assert( sz < bufSize );
   LZPOS begin = _wrap( pos );
   LZPOS end = begin + (LZPOS)sz;
 
-  if ( end > LZBUFSIZE )
+  if ( end > bufSize )
   {
-    size_t left = LZBUFSIZE - begin;
+    size_t left = bufSize - begin;
     memcpy( dst, buf + begin, left );
     memcpy( dst + left, buf, sz - left );
   }
@@ -66,32 +73,45 @@ void LZBuffer::_bufCpy( uint8_t* dst, LZPOS pos, size_t sz )
   }
 }
 
-LZPOS LZBuffer::_nMatch( LZPOS pos, const uint8_t* p, LZPOS nLimit )
+//Compares 8 bytes at a time; the tail is done bytewise so neither side is overread
+static inline LZPOS _matchLen( const uint8_t* a, const uint8_t* b, LZPOS n )
 {
-  assert( nLimit < LZBUFSIZE );
-  LZPOS begin = pos;
-  if ( LZBUFSIZE - begin >= nLimit )
+  LZPOS i = 0;
+  for ( ; i + 8 <= n ; i += 8 )
   {
-    for ( LZPOS i = 0; i < nLimit ; i++ )
-      if ( buf[ begin + i ] != p[ i ] )
-        return i;
+    uint64_t x, y;
+    memcpy( &x, a + i, 8 );
+    memcpy( &y, b + i, 8 );
+    if ( x != y )
+      return i + LZ_FIRST_DIFF( x ^ y );
+  }
 
-    return nLimit;
+  for ( ; i < n ; i++ )
+    if ( a[ i ] != b[ i ] )
+      return i;
 
+  return n;
+}
+
+template< int BufBits >
+LZPOS LZBuffer< BufBits >::_nMatch( LZPOS pos, const uint8_t* p, LZPOS nLimit )
+{
+  assert( nLimit < bufSize );
+  LZPOS begin = pos;
+  if ( bufSize - begin >= nLimit )
+  {
+    return _matchLen( buf + begin, p, nLimit );
   }
   else
   {
-    for ( LZPOS i = begin; i < LZBUFSIZE ; i++ )
-      if ( buf[ i ] != p[ i - begin ] )
-        return i - begin;
-
-    LZPOS shift = LZBUFSIZE - begin;
-    LZPOS n = nLimit - shift;
+    LZPOS shift = bufSize - begin;
+    LZPOS n = _matchLen( buf + begin, p, shift );
+    if ( n < shift )
+      return n;
 
-    for( LZPOS i = 0; i < n ; i++ )
-      if( buf[ i ] != p[ shift + i ] )
-        return shift + i;
-
-    return nLimit;
+    return shift + _matchLen( buf, p + shift, nLimit - shift );
   }
 }
+
+#define LZHL_INSTANTIATE_BUFFER( bufBits, tableBits ) template class LZBuffer< bufBits >;
+LZHL_FOR_EACH_WINDOW( LZHL_INSTANTIATE_BUFFER )
@@ -4,8 +4,11 @@
 #include "LZHMacro.hpp"
 #include <cstddef>
 
+template< int BufBits >
 class LZBuffer {
 public:
+  enum { bufBits = BufBits, bufSize = 1 << BufBits, bufMask = bufSize - 1 };
+
   LZBuffer();
   ~LZBuffer();
 
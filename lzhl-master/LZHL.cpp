@@ -1,6 +1,9 @@
+#include "LZHL.h"
 #include "LZHLDecoderStat.hpp"
 #include "LZHLCompressor.hpp"
 #include "LZHLDecompressor.hpp"
+#include "LZHLPipeline.hpp"
+#include <thread>
 
 #ifdef _MSC_VER
 #define DLLAPI __declspec(dllexport)
@@ -8,42 +11,183 @@
 #define DLLAPI __attribute__((visibility("default")))
 #endif
 
+// Handles are always the codec base pointer so the exports below can work on any window size.
+static LZHLCompressorBase* CreateCompressorForWindow(int windowBits) {
+  switch (windowBits) {
+#define LZHL_CREATE_COMPRESSOR( bufBits, tableBits ) case bufBits: return new LZHLCompressor< bufBits, tableBits >();
+    LZHL_FOR_EACH_WINDOW( LZHL_CREATE_COMPRESSOR )
+#undef LZHL_CREATE_COMPRESSOR
+  }
+  return NULL;
+}
+
+static LZHLDecompressorBase* CreateDecompressorForWindow(int windowBits) {
+  switch (windowBits) {
+#define LZHL_CREATE_DECOMPRESSOR( bufBits, tableBits ) case bufBits: return new LZHLDecompressor< bufBits >();
+    LZHL_FOR_EACH_WINDOW( LZHL_CREATE_DECOMPRESSOR )
+#undef LZHL_CREATE_DECOMPRESSOR
+  }
+  return NULL;
+}
+
+// Stream packets start with one of these; a resync resets both sides before the packet is coded.
+enum StreamMarker {
+  StreamContinue = 0,
+  StreamResync = 1,
+};
+
 extern "C" {
 
   DLLAPI void* CreateCompressor(void) {
-    return new LZHLCompressor();
+    return CreateCompressorForWindow(LZBUFBITS);
+  }
+
+  // Returns NULL if windowBits isn't one of the instantiated window sizes.
+  DLLAPI void* CreateCompressorWindow(int windowBits) {
+    return CreateCompressorForWindow(windowBits);
   }
 
   DLLAPI void DestroyCompressor(void *comp) {
-    delete (LZHLCompressor *)comp;
+    delete (LZHLCompressorBase *)comp;
   }
 
   DLLAPI void ResetCompressor(void *comp) {
-	  ((LZHLCompressor *)comp)->reset();
+	  ((LZHLCompressorBase *)comp)->reset();
   }
 
   DLLAPI void ResetDecompressor(void *decomp) {
-	  ((LZHLDecompressor *)decomp)->reset();
+	  ((LZHLDecompressorBase *)decomp)->reset();
   }
 
   DLLAPI unsigned int Compress(void *comp, unsigned char *buf, unsigned int size, unsigned char *ret) {
-    return ((LZHLCompressor *)comp)->compress(ret, buf, size);
+    return ((LZHLCompressorBase *)comp)->compress(ret, buf, size);
+  }
+
+  DLLAPI unsigned int CompressBound(unsigned int size) {
+    return (unsigned int)LZHLCompressorBase::calcMaxBuf(size);
+  }
+
+  // One compressor per worker; threads <= 0 means one per core. The workers start here and run until
+  // DestroyCompressPipeline. NULL if the window isn't supported or the workers can't be started.
+  DLLAPI void* CreateCompressPipeline(int windowBits, int threads) {
+    if (threads <= 0)
+      threads = (int)std::thread::hardware_concurrency();
+    if (threads <= 0)
+      threads = 1;
+    std::vector<LZHLCompressorBase *> compressors;
+    try {
+      compressors.reserve(threads);
+      for (int i = 0; i < threads; i++) {
+        LZHLCompressorBase *compressor = CreateCompressorForWindow(windowBits);
+        if (!compressor)
+          break;
+        compressors.push_back(compressor);
+      }
+      if (compressors.size() == (size_t)threads)
+        return new LZHLCompressPipeline(compressors);
+    }
+    catch (...) {
+    }
+    for (size_t i = 0; i < compressors.size(); i++)
+      delete compressors[i];
+    return NULL;
+  }
+
+  DLLAPI void DestroyCompressPipeline(void *pipeline) {
+    delete (LZHLCompressPipeline *)pipeline;
+  }
+
+  // Codes count standalone packets (as Compress after ResetCompressor) in parallel. Packet i is
+  // buf[offsets[i] .. offsets[i + 1]) and is written to ret + retOffsets[i], which must have room for
+  // CompressBound of its size; its compressed size goes to retSizes[i]. checksums may be NULL.
+  // Returns 0, or -1 if any packet failed.
+  DLLAPI int CompressBatch(void *pipeline, int count, unsigned char *buf, unsigned int *offsets, unsigned char *ret, unsigned int *retOffsets, unsigned int *retSizes, unsigned int *checksums) {
+    if (count <= 0)
+      return 0;
+    try {
+      return ((LZHLCompressPipeline *)pipeline)->compressBatch(count, buf, offsets, ret, retOffsets, retSizes, checksums) ? 0 : -1;
+    }
+    catch (...) {
+      return -1;
+    }
   }
 
   DLLAPI void* CreateDecompressor(void) {
-    return new LZHLDecompressor();
+    return CreateDecompressorForWindow(LZBUFBITS);
   }
 
+  // Both ends of a stream must use the same window size.
+  DLLAPI void* CreateDecompressorWindow(int windowBits) {
+    return CreateDecompressorForWindow(windowBits);
+  }
+
+  // Returns the decompressed size, or -1 if the packet is corrupt or doesn't fit in retsize.
   DLLAPI unsigned int Decompress(void *decomp, unsigned char *buf, unsigned int size, unsigned char *ret, unsigned int retsize) {
 	  size_t stSize = size;
 	  size_t stRetSize = retsize;
-	  if (!((LZHLDecompressor *)decomp)->decompress(ret, &stRetSize, buf, &stSize))
+	  if (!((LZHLDecompressorBase *)decomp)->decompress(ret, &stRetSize, buf, &stSize))
 		  return -1;
-    return (unsigned int)retsize;
+    return (unsigned int)stRetSize;
+  }
+
+  // Decodes as much of a packet as fits in ret. Pass first = 1 on the first call for a packet, then call
+  // again with buf advanced by *consumed while it returns 0 (ret full). Returns 1 once the packet is
+  // complete and -1 if it is corrupt or truncated.
+  DLLAPI int DecompressPartial(void *decomp, unsigned char *buf, unsigned int size, unsigned char *ret, unsigned int retsize, unsigned int *consumed, unsigned int *produced, int first) {
+    LZHLDecompressorBase *decompressor = (LZHLDecompressorBase *)decomp;
+    if (first)
+      decompressor->beginPacket();
+    size_t stSize = size;
+    size_t stRetSize = retsize;
+    int result = decompressor->decompressPartial(ret, &stRetSize, buf, &stSize);
+    *consumed = result < 0 ? 0 : (unsigned int)stSize;
+    *produced = result < 0 ? 0 : (unsigned int)stRetSize;
+    return result;
+  }
+
+  // Codes a packet against the window and statistics left by the previous packets.
+  // ret must hold CompressBound(size) + 1 bytes.
+  DLLAPI unsigned int CompressStream(void *comp, unsigned char *buf, unsigned int size, unsigned char *ret, int resync) {
+    LZHLCompressorBase *compressor = (LZHLCompressorBase *)comp;
+    if (resync)
+      compressor->reset();
+    ret[0] = (unsigned char)(resync ? StreamResync : StreamContinue);
+    return 1 + (unsigned int)compressor->compress(ret + 1, buf, size);
+  }
+
+  // Returns the decompressed size, or -1 if the packet is corrupt. After a failure the
+  // stream is out of sync until the next resync packet.
+  DLLAPI unsigned int DecompressStream(void *decomp, unsigned char *buf, unsigned int size, unsigned char *ret, unsigned int retsize) {
+    LZHLDecompressorBase *decompressor = (LZHLDecompressorBase *)decomp;
+    if (size < 1 || buf[0] > StreamResync)
+      return -1;
+    if (buf[0] == StreamResync)
+      decompressor->reset();
+    size_t stSize = size - 1;
+    size_t stRetSize = retsize;
+    if (!decompressor->decompress(ret, &stRetSize, buf + 1, &stSize))
+      return -1;
+    return (unsigned int)stRetSize;
+  }
+
+  // As DecompressPartial for stream packets; the first call also consumes the marker byte.
+  DLLAPI int DecompressStreamPartial(void *decomp, unsigned char *buf, unsigned int size, unsigned char *ret, unsigned int retsize, unsigned int *consumed, unsigned int *produced, int first) {
+    unsigned int marker = 0;
+    if (first) {
+      if (size < 1 || buf[0] > StreamResync)
+        return -1;
+      if (buf[0] == StreamResync)
+        ((LZHLDecompressorBase *)decomp)->reset();
+      marker = 1;
+    }
+    int result = DecompressPartial(decomp, buf + marker, size - marker, ret, retsize, consumed, produced, first);
+    if (result >= 0)
+      *consumed += marker;
+    return result;
   }
 
   DLLAPI void DestroyDecompressor(void *decomp) {
-    delete (LZHLDecompressor *)decomp;
+    delete (LZHLDecompressorBase *)decomp;
   }
 
 }
@@ -0,0 +1,35 @@
+#ifndef  LZHL_LZHL_H
+#define  LZHL_LZHL_H
+
+/* C API exported by liblzhl (see LZHL.cpp) */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void* CreateCompressor(void);
+void* CreateCompressorWindow(int windowBits);
+void DestroyCompressor(void *comp);
+void ResetCompressor(void *comp);
+unsigned int Compress(void *comp, unsigned char *buf, unsigned int size, unsigned char *ret);
+unsigned int CompressBound(unsigned int size);
+unsigned int CompressStream(void *comp, unsigned char *buf, unsigned int size, unsigned char *ret, int resync);
+
+void* CreateCompressPipeline(int windowBits, int threads);
+void DestroyCompressPipeline(void *pipeline);
+int CompressBatch(void *pipeline, int count, unsigned char *buf, unsigned int *offsets, unsigned char *ret, unsigned int *retOffsets, unsigned int *retSizes, unsigned int *checksums);
+
+void* CreateDecompressor(void);
+void* CreateDecompressorWindow(int windowBits);
+void DestroyDecompressor(void *decomp);
+void ResetDecompressor(void *decomp);
+unsigned int Decompress(void *decomp, unsigned char *buf, unsigned int size, unsigned char *ret, unsigned int retsize);
+unsigned int DecompressStream(void *decomp, unsigned char *buf, unsigned int size, unsigned char *ret, unsigned int retsize);
+int DecompressPartial(void *decomp, unsigned char *buf, unsigned int size, unsigned char *ret, unsigned int retsize, unsigned int *consumed, unsigned int *produced, int first);
+int DecompressStreamPartial(void *decomp, unsigned char *buf, unsigned int size, unsigned char *ret, unsigned int retsize, unsigned int *consumed, unsigned int *produced, int first);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
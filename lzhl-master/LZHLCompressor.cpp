@@ -13,26 +13,30 @@ inline LZHASH _calcHash( const uint8_t* src )
   return hash;
 }
 
-LZHLCompressor::LZHLCompressor() {
-  table = new LZTableItem[ LZTABLESIZE ];
-  for ( int i=0; i < LZTABLESIZE ; ++i ) {
-    table[ i ] = (LZTABLEINT)(-1);
+template< int BufBits, int TableBits >
+LZHLCompressor< BufBits, TableBits >::LZHLCompressor() {
+  table = new LZTableItem[ tableSize ];
+  for ( int i=0; i < tableSize ; ++i ) {
+    table[ i ] = (LZTableItem)(-1);
   }
+  historyStart = 0;
 }
 
-void LZHLCompressor::reset()
+//Stale table entries are left in place; matches are limited to data written since the reset
+template< int BufBits, int TableBits >
+void LZHLCompressor< BufBits, TableBits >::reset()
 {
-	for (int i = 0; i < LZTABLESIZE; ++i) {
-		table[i] = (LZTABLEINT)(-1);
-	}
+	historyStart = bufPos;
 	stat.reset();
 }
 
-LZHLCompressor::~LZHLCompressor() {
+template< int BufBits, int TableBits >
+LZHLCompressor< BufBits, TableBits >::~LZHLCompressor() {
   delete [] table;
 }
 
-inline LZHASH LZHLCompressor::_updateTable( LZHASH hash, const uint8_t* src, LZPOS pos, ptrdiff_t len )
+template< int BufBits, int TableBits >
+inline LZHASH LZHLCompressor< BufBits, TableBits >::_updateTable( LZHASH hash, const uint8_t* src, LZPOS pos, ptrdiff_t len )
 {
   if ( len <= 0 )
     return 0;
@@ -53,20 +57,25 @@ inline LZHASH LZHLCompressor::_updateTable( LZHASH hash, const uint8_t* src, LZP
   ++src;
 
   for ( int i=0; i < len ; ++i ) {
-    table[ HASH_POS( hash ) ] = (LZTableItem)_wrap( pos + i );
+    table[ HASH_POS( hash, TableBits ) ] = (LZTableItem)_wrap( pos + i );
     UPDATE_HASH_EX( hash, src + i );
   }
 
   return hash;
 }
 
-size_t LZHLCompressor::compress( uint8_t* dst, const uint8_t* src, size_t sz ) {
+template< int BufBits, int TableBits >
+size_t LZHLCompressor< BufBits, TableBits >::compress( uint8_t* dst, const uint8_t* src, size_t sz ) {
   LZHLEncoder coder( &stat, dst );
   // (unused) const uint8_t* srcBegin = src;
   const uint8_t* srcEnd = src + sz;
 
   LZHASH hash = 0;
 
+  if ( bufPos - historyStart > (LZPOS)Buffer::bufSize ) {
+    historyStart = bufPos - Buffer::bufSize;
+  }
+
   if ( sz >= LZMATCH ) {
     const uint8_t* pEnd = src + LZMATCH;
 
@@ -98,14 +107,14 @@ size_t LZHLCompressor::compress( uint8_t* dst, const uint8_t* src, size_t sz ) {
     bool   lazyForceMatch = false;
 #endif
     for (;;) {
-      LZHASH hash2 = HASH_POS( hash );
+      LZHASH hash2 = HASH_POS( hash, TableBits );
 
       LZPOS hashPos = table[ hash2 ];
       LZPOS wrapBufPos = _wrap( bufPos );
       table[ hash2 ] = (LZTableItem)wrapBufPos;
 
       int matchLen = 0;
-      if ( hashPos != (LZTABLEINT)(-1) && hashPos != wrapBufPos )
+      if ( hashPos != (LZTableItem)(-1) && hashPos != wrapBufPos && (LZPOS)_distance( wrapBufPos - hashPos ) <= bufPos - historyStart )
       {
         int matchLimit = std::min( std::min( _distance( wrapBufPos - hashPos ), (int)(srcLeft - nRaw) ), LZMIN + LZHLEncoder::maxMatchOver );
         matchLen = _nMatch( hashPos, src + nRaw, matchLimit );
@@ -131,7 +140,8 @@ size_t LZHLCompressor::compress( uint8_t* dst, const uint8_t* src, size_t sz ) {
         {
           int xtraMatchLimit = (int)std::min( LZMIN + LZHLEncoder::maxMatchOver - (ptrdiff_t)matchLen, nRaw );
           int d = (int)_distance( bufPos - hashPos );
-          xtraMatchLimit = std::min( std::min( xtraMatchLimit, d - matchLen ), LZBUFSIZE - d );
+          xtraMatchLimit = std::min( std::min( xtraMatchLimit, d - matchLen ), Buffer::bufSize - d );
+          xtraMatchLimit = std::min( xtraMatchLimit, (int)( bufPos - historyStart ) - d );
           int xtraMatch;
           for ( xtraMatch = 0; xtraMatch < xtraMatchLimit ; ++xtraMatch )
           {
@@ -161,7 +171,7 @@ size_t LZHLCompressor::compress( uint8_t* dst, const uint8_t* src, size_t sz ) {
 #ifdef LZLAZYMATCH
       if ( lazyMatchLen >= LZMIN ) {
         if ( matchLen > lazyMatchLen ) {
-          coder.putMatch( src, nRaw, matchLen - LZMIN, _distance( wrapBufPos - hashPos ) );
+          coder.putMatch< BufBits >( src, nRaw, matchLen - LZMIN, _distance( wrapBufPos - hashPos ) );
           hash = _updateTable( hash, src + nRaw, bufPos + 1, std::min( (ptrdiff_t)matchLen - 1, srcEnd - (src + nRaw + 1) - LZMATCH ) );
           _toBuf( src + nRaw, matchLen );
           src += nRaw + matchLen;
@@ -173,7 +183,7 @@ size_t LZHLCompressor::compress( uint8_t* dst, const uint8_t* src, size_t sz ) {
 
           hash = lazyMatchHash;
           UPDATE_HASH_EX( hash, src + nRaw );
-          coder.putMatch( src, nRaw, lazyMatchLen - LZMIN, _distance( bufPos - lazyMatchHashPos ) );
+          coder.putMatch< BufBits >( src, nRaw, lazyMatchLen - LZMIN, _distance( bufPos - lazyMatchHashPos ) );
           hash = _updateTable( hash, src + nRaw + 1, bufPos + 2, std::min( (ptrdiff_t)lazyMatchLen - 2, srcEnd - (src + nRaw + 2) - LZMATCH ) );
           _toBuf( src + nRaw, lazyMatchLen );
           src += nRaw + lazyMatchLen;
@@ -195,7 +205,7 @@ size_t LZHLCompressor::compress( uint8_t* dst, const uint8_t* src, size_t sz ) {
         } else
 #endif
         {
-          coder.putMatch( src, nRaw, matchLen - LZMIN, _distance( wrapBufPos - hashPos ) );
+          coder.putMatch< BufBits >( src, nRaw, matchLen - LZMIN, _distance( wrapBufPos - hashPos ) );
           hash = _updateTable( hash, src + nRaw, bufPos + 1, std::min( (ptrdiff_t)matchLen - 1, srcEnd - (src + nRaw + 1) - LZMATCH ) );
           _toBuf( src + nRaw, matchLen );
           src += nRaw + matchLen;
@@ -213,7 +223,7 @@ size_t LZHLCompressor::compress( uint8_t* dst, const uint8_t* src, size_t sz ) {
 #ifdef LZLAZYMATCH
         if ( lazyMatchLen >= LZMIN )
         {
-          coder.putMatch( src, nRaw, lazyMatchLen - LZMIN, _distance( bufPos - lazyMatchHashPos ) );
+          coder.putMatch< BufBits >( src, nRaw, lazyMatchLen - LZMIN, _distance( bufPos - lazyMatchHashPos ) );
           hash = _updateTable( hash, src + nRaw, bufPos + 1, std::min( (ptrdiff_t)lazyMatchLen - 1, srcEnd - (src + nRaw + 1) - LZMATCH ) );
           _toBuf( src + nRaw, lazyMatchLen );
           src += nRaw + lazyMatchLen;
@@ -239,3 +249,6 @@ size_t LZHLCompressor::compress( uint8_t* dst, const uint8_t* src, size_t sz ) {
 
   return coder.flush();
 }
+
+#define LZHL_INSTANTIATE_COMPRESSOR( bufBits, tableBits ) template class LZHLCompressor< bufBits, tableBits >;
+LZHL_FOR_EACH_WINDOW( LZHL_INSTANTIATE_COMPRESSOR )
@@ -6,26 +6,48 @@
 #include "LZHLEncoderStat.hpp"
 #include "LZHMacro.hpp"
 
-class LZHLCompressor : private LZBuffer {
+class LZHLCompressorBase {
 public:
-  LZHLCompressor();
-  virtual ~LZHLCompressor();
+  virtual ~LZHLCompressorBase() { }
 
 public:
   static size_t calcMaxBuf( size_t rawSz ) {
     return LZHLEncoder::calcMaxBuf( rawSz );
   }
 
+  virtual size_t compress( uint8_t* dst, const uint8_t* src, size_t sz ) = 0;
+  virtual void reset() = 0;
+};
+
+template< int BufBits, int TableBits >
+class LZHLCompressor : public LZHLCompressorBase, private LZBuffer< BufBits > {
+public:
+  LZHLCompressor();
+  virtual ~LZHLCompressor();
+
+public:
   size_t compress( uint8_t* dst, const uint8_t* src, size_t sz );
   void reset();
 
 private:
+  typedef LZBuffer< BufBits > Buffer;
+  typedef typename LZTableInt< BufBits >::Type LZTableItem;
+  enum { tableSize = 1 << TableBits };
+
+  using Buffer::buf;
+  using Buffer::bufPos;
+  using Buffer::_wrap;
+  using Buffer::_distance;
+  using Buffer::_toBuf;
+  using Buffer::_nMatch;
+
   void _wrapTable();
   LZHASH _updateTable( LZHASH hash, const uint8_t* src, LZPOS pos, ptrdiff_t len );
 
 private:
   LZHLEncoderStat stat;
   LZTableItem* table;
+  LZPOS historyStart;
 };
 
 #endif
@@ -1,90 +1,174 @@
 #include "LZHLDecompressor.hpp"
 #include <cassert>
 #include <memory.h>
+#include <algorithm>
 
-LZHLDecompressor::LZHLDecompressor() {
+template< int BufBits >
+LZHLDecompressor< BufBits >::LZHLDecompressor() {
   nBits = 0;
   bits = 0;
+  matchLeft = 0;
+  matchDisp = 0;
+  _buildDecodeTable();
 }
 
-LZHLDecompressor::~LZHLDecompressor() { }
+template< int BufBits >
+LZHLDecompressor< BufBits >::~LZHLDecompressor() { }
 
-void LZHLDecompressor::reset()
+template< int BufBits >
+void LZHLDecompressor< BufBits >::reset()
 {
 	nBits = 0;
 	bits = 0;
+	matchLeft = 0;
 	memcpy(symbolTable, symbolTable0, sizeof(HUFFINT)*NHUFFSYMBOLS);
 	memcpy(groupTable, groupTable0, sizeof(Group) * 16);
 	memset(stat, 0, sizeof(HUFFINT) * NHUFFSYMBOLS);
+	_buildDecodeTable();
 }
 
-inline int LZHLDecompressor::_get( const uint8_t*& src, const uint8_t* srcEnd, int n )
+//Expands the 4 bit group + up to 8 bit index code into one entry per 12 bit prefix
+template< int BufBits >
+void LZHLDecompressor< BufBits >::_buildDecodeTable()
 {
-  assert( n <= 8 );
+  for ( int grp=0; grp < 16 ; ++grp ) {
+    const Group& group = groupTable[ grp ];
+    assert( group.nBits <= 8 );
+    int fill = 1 << ( 8 - group.nBits );
+
+    for ( int code=0; code < ( 1 << group.nBits ) ; ++code ) {
+      int pos = group.pos + code;
+      DecodeEntry entry;
+      entry.symbol = pos < NHUFFSYMBOLS ? symbolTable[ pos ] : -1;
+      entry.nBits = (uint8_t)( 4 + group.nBits );
+
+      DecodeEntry* dst = &decodeTable[ ( grp << 8 ) | ( code << ( 8 - group.nBits ) ) ];
+      for ( int i=0; i < fill ; ++i )
+        dst[ i ] = entry;
+    }
+  }
+}
+
+//Tops the bit buffer up to at least 56 bits, a word at a time while 8 bytes remain
+template< int BufBits >
+inline void LZHLDecompressor< BufBits >::_refill( const uint8_t*& src, const uint8_t* srcEnd )
+{
+  if ( srcEnd - src >= 8 ) {
+    uint64_t word = 0;
+    for ( int i=0; i < 8 ; ++i )
+      word = ( word << 8 ) | src[ i ];
+
+    // bits below the buffered ones always hold the following stream bits, so re-ORing them is harmless
+    bits |= word >> nBits;
+    int n = ( 63 - nBits ) >> 3;
+    src += n;
+    nBits += n << 3;
+    return;
+  }
+
+  while ( nBits <= 56 && src < srcEnd ) {
+    bits |= (uint64_t)*src++ << ( 56 - nBits );
+    nBits += 8;
+  }
+}
+
+template< int BufBits >
+inline int LZHLDecompressor< BufBits >::_get( const uint8_t*& src, const uint8_t* srcEnd, int n )
+{
+  assert( n <= 32 );
   if ( nBits < n ) {
-    if ( src >= srcEnd ) {
+    _refill( src, srcEnd );
+
+    if ( nBits < n ) {
       nBits = 0;
       return -1;
     }
-
-    bits |= ( *src++ << ( 24 - nBits ) );
-    nBits += 8;
   }
 
-  int ret = bits >> ( 32 - n );
+  if ( n == 0 )
+    return 0;
+
+  int ret = (int)( bits >> ( 64 - n ) );
   bits <<= n;
   nBits -= n;
   return ret;
 }
 
-bool LZHLDecompressor::decompress( uint8_t* dst, size_t* dstSz, const uint8_t* src, size_t* srcSz )
+template< int BufBits >
+bool LZHLDecompressor< BufBits >::decompress( uint8_t* dst, size_t* dstSz, const uint8_t* src, size_t* srcSz )
+{
+  beginPacket();
+  return decompressPartial( dst, dstSz, src, srcSz ) == 1;
+}
+
+template< int BufBits >
+void LZHLDecompressor< BufBits >::beginPacket()
+{
+  nBits = 0;
+  bits = 0;
+  matchLeft = 0;
+}
+
+//Copies as much of the pending match as fits; the first disp bytes come from the window, the rest overlap dst
+template< int BufBits >
+inline void LZHLDecompressor< BufBits >::_copyMatch( uint8_t*& dst, const uint8_t* endDst )
+{
+  int n = (int)std::min( (ptrdiff_t)matchLeft, endDst - dst );
+  int first = std::min( n, matchDisp );
+  _bufCpy( dst, bufPos - matchDisp, first );
+
+  for ( int i=first; i < n ; ++i ) {
+    dst[ i ] = dst[ i - matchDisp ];
+  }
+
+  _toBuf( dst, n );
+  dst += n;
+  matchLeft -= n;
+}
+
+template< int BufBits >
+int LZHLDecompressor< BufBits >::decompressPartial( uint8_t* dst, size_t* dstSz, const uint8_t* src, size_t* srcSz )
 {
   uint8_t* startDst = dst;
   const uint8_t* startSrc = src;
   const uint8_t* endSrc = src + *srcSz;
   const uint8_t* endDst = dst + *dstSz;
-  nBits = 0;
+  int done = 1;
 
   for (;;) {
-    int grp = _get( src, endSrc, 4 );
-    if ( grp < 0 ) {
-      return false;
+    if ( matchLeft > 0 ) {
+      _copyMatch( dst, endDst );
+      if ( matchLeft > 0 ) {
+        done = 0;
+        break;  //forever
+      }
     }
 
-    Group& group = groupTable[ grp ];
-
-    HUFFINT symbol;
-    int nBits = group.nBits;
-
-    if ( nBits == 0 ) {
-      symbol = symbolTable[ group.pos ];
-    } else {
-      assert( nBits <= 8 );
-      int got = _get( src, endSrc, nBits );
-
-      if ( got < 0 ) {
-        return false;
-      }
+    if ( nBits < 32 )
+      _refill( src, endSrc );
 
-      int pos = group.pos + got;
+    const DecodeEntry& entry = decodeTable[ bits >> 52 ];
+    if ( entry.nBits > nBits || entry.symbol < 0 ) {
+      return -1;
+    }
 
-      if ( pos >= NHUFFSYMBOLS ) {
-        return false;
-      }
+    HUFFINT symbol = entry.symbol;
 
-      symbol = symbolTable[ pos ];
+    //leave the literal in the bit buffer until there is room for it
+    if ( symbol < 256 && dst >= endDst ) {
+      done = 0;
+      break;  //forever
     }
 
+    bits <<= entry.nBits;
+    nBits -= entry.nBits;
+
     assert( symbol < NHUFFSYMBOLS );
     ++stat[ symbol ];
 
     int matchOver;
 
     if ( symbol < 256 ) {
-      if ( dst >= endDst ) {
-        return false;
-      }
-
       *dst++ = (uint8_t)symbol;
       _toBuf( (uint8_t)symbol );
       continue; //forever
@@ -102,18 +186,30 @@ bool LZHLDecompressor::decompress( uint8_t* dst, size_t* dstSz, const uint8_t* s
       for ( int i=0; i < 16 ; ++i ) {
 
         int n;
-        for ( n=0 ;; ++n )
-          if ( _get( src, endSrc, 1 ) )
+        for ( n=0 ;; ++n ) {
+          int bit = _get( src, endSrc, 1 );
+          if ( bit < 0 )
+            return -1;
+          if ( bit )
             break;
+        }
 
         lastNBits += n;
+        if ( lastNBits > 8 ) {
+          return -1;
+        }
+
         groupTable[ i ].nBits = lastNBits;
         groupTable[ i ].pos   = pos;
 
         pos += 1 << lastNBits;
       }
 
-      assert( pos < NHUFFSYMBOLS + 255 );
+      if ( pos >= NHUFFSYMBOLS + 255 ) {
+        return -1;
+      }
+
+      _buildDecodeTable();
       continue;  //forever
 
 
@@ -141,7 +237,7 @@ bool LZHLDecompressor::decompress( uint8_t* dst, size_t* dstSz, const uint8_t* s
       int extra = _get( src, endSrc, item->nExtraBits );
 
       if ( extra < 0 ) {
-        return false;
+        return -1;
       }
 
       matchOver = item->base + extra;
@@ -150,7 +246,7 @@ bool LZHLDecompressor::decompress( uint8_t* dst, size_t* dstSz, const uint8_t* s
     int dispPrefix = _get( src, endSrc, 3 );
 
     if ( dispPrefix < 0 ) {
-      return false;
+      return -1;
     }
 
     static struct DispItem {
@@ -168,54 +264,34 @@ bool LZHLDecompressor::decompress( uint8_t* dst, size_t* dstSz, const uint8_t* s
     };
 
     DispItem* item = &_dispTable[ dispPrefix ];
-    nBits = item->nBits + LZBUFBITS - 7;
-
-    int disp = 0;
-    assert( nBits <= 16 );
-
-    if ( nBits > 8 ) {
-      nBits -= 8;
-      disp |= _get( src, endSrc, 8 ) << nBits;
-    }
-
-    assert( nBits <= 8 );
-    int got = _get( src, endSrc, nBits );
-
-    if ( got < 0 ) {
-      return false;
-    }
+    int disp = _get( src, endSrc, item->nBits + BufBits - 7 );
 
-    disp |= got;
-    disp += item->disp << (LZBUFBITS - 7);
-    assert( disp >=0 && disp < LZBUFSIZE );
-
-    int matchLen = matchOver + LZMIN;
-
-    if ( dst + matchLen > endDst ) {
-      return false;
+    if ( disp < 0 ) {
+      return -1;
     }
 
-    int pos = bufPos - disp;
-    if ( matchLen < disp ) {
-      _bufCpy( dst, pos, matchLen );
-    } else {
-      _bufCpy( dst, pos, disp );
+    disp += item->disp << (BufBits - 7);
+    assert( disp >=0 && disp < Buffer::bufSize );
 
-      for ( int i=0; i < matchLen - disp; ++i ) {
-        dst[ i + disp ] = dst[ i ];
-      }
+    if ( disp == 0 ) {
+      return -1;
     }
 
-    _toBuf( dst, matchLen );
-    dst += matchLen;
+    matchLeft = matchOver + LZMIN;
+    matchDisp = disp;
 
   } // forever
 
   if ( dstSz )
     *dstSz = dst - startDst;
 
+  // whole bytes still in the bit buffer were read ahead, not consumed; the caller passes them again
   if ( srcSz )
-    *srcSz = src - startSrc;
+    *srcSz = ( src - startSrc ) - ( nBits >> 3 );
+  nBits &= 7;
 
-  return true;
+  return done;
 }
+
+#define LZHL_INSTANTIATE_DECOMPRESSOR( bufBits, tableBits ) template class LZHLDecompressor< bufBits >;
+LZHL_FOR_EACH_WINDOW( LZHL_INSTANTIATE_DECOMPRESSOR )
@@ -4,18 +4,49 @@
 #include "LZBuffer.hpp"
 #include "LZHLDecoderStat.hpp"
 
-class LZHLDecompressor : public LZBuffer, public LZHLDecoderStat {
+class LZHLDecompressorBase {
+public:
+  virtual ~LZHLDecompressorBase() { }
+
+public:
+  virtual bool decompress( uint8_t* dst, size_t* dstSz, const uint8_t* src, size_t* srcSz ) = 0;
+  virtual void reset() = 0;
+
+  //Resumable decoding: call beginPacket(), then decompressPartial() until it returns 1 (end of packet).
+  //0 means dst filled up; call again with src advanced by *srcSz. -1 means corrupt or truncated input.
+  virtual void beginPacket() = 0;
+  virtual int decompressPartial( uint8_t* dst, size_t* dstSz, const uint8_t* src, size_t* srcSz ) = 0;
+};
+
+template< int BufBits >
+class LZHLDecompressor : public LZHLDecompressorBase, public LZBuffer< BufBits >, public LZHLDecoderStat {
 private:
-  uint32_t bits;
+  struct DecodeEntry { HUFFINT symbol; uint8_t nBits; };
+
+  uint64_t bits;
   int nBits;
+  int matchLeft;
+  int matchDisp;
+  DecodeEntry decodeTable[ 1 << 12 ];
 
 public:
   LZHLDecompressor();
   virtual ~LZHLDecompressor();
   bool decompress( uint8_t* dst, size_t* dstSz, const uint8_t* src, size_t* srcSz );
   void reset();
+  void beginPacket();
+  int decompressPartial( uint8_t* dst, size_t* dstSz, const uint8_t* src, size_t* srcSz );
 
 private:
+  typedef LZBuffer< BufBits > Buffer;
+
+  using Buffer::bufPos;
+  using Buffer::_toBuf;
+  using Buffer::_bufCpy;
+
+  void _buildDecodeTable();
+  inline void _copyMatch( uint8_t*& dst, const uint8_t* endDst );
+  inline void _refill( const uint8_t*& src, const uint8_t* srcEnd );
   inline int _get( const uint8_t*& src, const uint8_t* srcEnd, int n );
 };
 
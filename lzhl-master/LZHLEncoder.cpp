@@ -41,11 +41,12 @@ void LZHLEncoder::putRaw( const uint8_t* src, size_t sz ) {
   }
 }
 
+template< int BufBits >
 void LZHLEncoder::putMatch( const uint8_t* src, size_t nRaw, size_t matchOver, size_t disp )
 {
   assert( nRaw <= maxRaw );
   assert( matchOver <= maxMatchOver );
-  assert( disp >= 0 && disp < LZBUFSIZE );
+  assert( disp >= 0 && disp < ( (size_t)1 << BufBits ) );
   putRaw( src, nRaw );
   struct MatchOverItem { uint16_t symbol; int nBits; uint16_t bits; };
 
@@ -89,29 +90,27 @@ void LZHLEncoder::putMatch( const uint8_t* src, size_t nRaw, size_t matchOver, s
 #include "Table/Hdisp.tbl"
   };
 
-#if LZBUFBITS < 8
-#error
-#endif
+  static_assert( BufBits >= 8, "window too small for the displacement table" );
 
-  DispItem* item = &_dispTable[ disp >> (LZBUFBITS - 7) ];
-  int nBits = item->nBits + (LZBUFBITS - 7);
-  uint32_t bits = ( ((uint32_t)item->bits) << (LZBUFBITS - 7) ) | ( disp & ( ( 1 << (LZBUFBITS - 7) ) - 1 ) );
+  DispItem* item = &_dispTable[ disp >> (BufBits - 7) ];
+  int nBits = item->nBits + (BufBits - 7);
+  uint32_t bits = ( ((uint32_t)item->bits) << (BufBits - 7) ) | ( disp & ( ( 1 << (BufBits - 7) ) - 1 ) );
 
-#if LZBUFBITS >= 15
-  if ( nBits > 16 ) {
+  if ( BufBits >= 15 && nBits > 16 ) {
     assert( nBits <= 32 );
     _putBits( nBits - 16, bits >> 16 );
     _putBits( 16, bits & 0xFFFF );
 
-  } else
-#endif
-
-  {
+  } else {
     assert( nBits <= 16 );
     _putBits( nBits, bits );
   }
 }
 
+#define LZHL_INSTANTIATE_PUTMATCH( bufBits, tableBits ) \
+  template void LZHLEncoder::putMatch< bufBits >( const uint8_t*, size_t, size_t, size_t );
+LZHL_FOR_EACH_WINDOW( LZHL_INSTANTIATE_PUTMATCH )
+
 size_t LZHLEncoder::flush() {
   _put( NHUFFSYMBOLS - 1 );
 
@@ -31,6 +31,7 @@ public:
   size_t flush();
 
   void putRaw( const uint8_t* src, size_t sz );
+  template< int BufBits >
   void putMatch( const uint8_t* src, size_t nRaw, size_t matchOver, size_t disp );
 
 private:
@@ -0,0 +1,95 @@
+#include "LZHLPipeline.hpp"
+#include "../checksum/checksum.h"
+
+LZHLCompressPipeline::LZHLCompressPipeline( const std::vector< LZHLCompressorBase* >& compressors_ )
+: compressors( compressors_ ), generation( 0 ), busy( 0 ), stopping( false ), count( 0 ),
+  src( NULL ), srcOffsets( NULL ), dst( NULL ), dstOffsets( NULL ), dstSizes( NULL ), checksums( NULL ),
+  next( 0 ), failed( false ) {
+  try {
+    for ( size_t t = 1; t < compressors.size(); ++t ) {
+      workers.push_back( std::thread( &LZHLCompressPipeline::workerLoop, this, compressors[ t ] ) );
+    }
+  }
+  catch ( ... ) {
+    stopWorkers();
+    throw;
+  }
+}
+
+LZHLCompressPipeline::~LZHLCompressPipeline() {
+  stopWorkers();
+  for ( size_t i = 0; i < compressors.size(); ++i ) {
+    delete compressors[ i ];
+  }
+}
+
+void LZHLCompressPipeline::stopWorkers() {
+  {
+    std::lock_guard< std::mutex > guard( lock );
+    stopping = true;
+  }
+  wake.notify_all();
+  for ( size_t t = 0; t < workers.size(); ++t ) {
+    workers[ t ].join();
+  }
+  workers.clear();
+}
+
+void LZHLCompressPipeline::runBatch( LZHLCompressorBase* compressor ) {
+  try {
+    int i;
+    while ( ( i = next++ ) < count ) {
+      const uint8_t* packet = src + srcOffsets[ i ];
+      size_t sz = srcOffsets[ i + 1 ] - srcOffsets[ i ];
+      compressor->reset();
+      dstSizes[ i ] = (uint32_t)compressor->compress( dst + dstOffsets[ i ], packet, sz );
+      if ( checksums )
+        checksums[ i ] = checksum_fnv_weak( packet, sz );
+    }
+  }
+  catch ( ... ) {
+    failed = true;
+  }
+}
+
+void LZHLCompressPipeline::workerLoop( LZHLCompressorBase* compressor ) {
+  unsigned long long seen = 0;
+  for ( ;; ) {
+    {
+      std::unique_lock< std::mutex > guard( lock );
+      wake.wait( guard, [&] { return stopping || generation != seen; } );
+      if ( stopping )
+        return;
+      seen = generation;
+    }
+    runBatch( compressor );
+    {
+      std::lock_guard< std::mutex > guard( lock );
+      if ( --busy == 0 )
+        done.notify_one();
+    }
+  }
+}
+
+bool LZHLCompressPipeline::compressBatch( int count_, const uint8_t* src_, const uint32_t* srcOffsets_,
+                                          uint8_t* dst_, const uint32_t* dstOffsets_, uint32_t* dstSizes_, uint32_t* checksums_ ) {
+  {
+    std::lock_guard< std::mutex > guard( lock );
+    count = count_;
+    src = src_;
+    srcOffsets = srcOffsets_;
+    dst = dst_;
+    dstOffsets = dstOffsets_;
+    dstSizes = dstSizes_;
+    checksums = checksums_;
+    next = 0;
+    failed = false;
+    busy = workers.size();
+    ++generation;
+  }
+  wake.notify_all();
+  runBatch( compressors[ 0 ] );
+  std::unique_lock< std::mutex > guard( lock );
+  done.wait( guard, [&] { return busy == 0; } );
+  return !failed;
+}
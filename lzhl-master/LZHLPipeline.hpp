@@ -0,0 +1,57 @@
+#ifndef  LZHL_LZHLPipeline_HPP
+#define  LZHL_LZHLPipeline_HPP
+
+#include "LZHLCompressor.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Codes batches of independent packets (each from a reset compressor, as for a
+// standalone LZH packet) on one worker per compressor. Results keep batch order.
+// The workers are started once and wait between batches; the calling thread
+// codes with the first compressor. One batch at a time.
+class LZHLCompressPipeline {
+public:
+  // Takes ownership of the compressors, which must all use the same window.
+  // Throws if the workers can't be started, leaving the compressors to the caller.
+  LZHLCompressPipeline( const std::vector< LZHLCompressorBase* >& compressors );
+  ~LZHLCompressPipeline();
+
+public:
+  // Packet i is src[ srcOffsets[ i ] .. srcOffsets[ i + 1 ] ) and is coded to dst + dstOffsets[ i ],
+  // which must hold calcMaxBuf() of its size. If checksums is not NULL it receives each
+  // packet's checksum_fnv_weak (Utilities.ComputeChecksumFNVWeak) of the uncompressed data.
+  // Returns false if any packet failed.
+  bool compressBatch( int count, const uint8_t* src, const uint32_t* srcOffsets,
+                      uint8_t* dst, const uint32_t* dstOffsets, uint32_t* dstSizes, uint32_t* checksums );
+
+private:
+  void runBatch( LZHLCompressorBase* compressor );
+  void workerLoop( LZHLCompressorBase* compressor );
+  void stopWorkers();
+
+  std::vector< LZHLCompressorBase* > compressors;
+  std::vector< std::thread > workers;
+
+  std::mutex lock;
+  std::condition_variable wake;
+  std::condition_variable done;
+  unsigned long long generation;
+  size_t busy;
+  bool stopping;
+
+  // The batch in progress.
+  int count;
+  const uint8_t* src;
+  const uint32_t* srcOffsets;
+  uint8_t* dst;
+  const uint32_t* dstOffsets;
+  uint32_t* dstSizes;
+  uint32_t* checksums;
+  std::atomic< int > next;
+  std::atomic< bool > failed;
+};
+
+#endif
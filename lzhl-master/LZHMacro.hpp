@@ -12,20 +12,32 @@
   #define ROTL( x, y ) ( ( (x) << (y) ) | ( (x) >> (32-(y)) ) )
 #endif
 
+//Index of the first differing byte in two 64 bit words loaded with memcpy (x != 0)
+#if defined( _MSC_VER ) && defined( _M_X64 )
+  #include <intrin.h>
+  inline int LZ_FIRST_DIFF( uint64_t x ) { unsigned long i; _BitScanForward64( &i, x ); return (int)( i >> 3 ); }
+#elif defined( __BYTE_ORDER__ ) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  inline int LZ_FIRST_DIFF( uint64_t x ) { return __builtin_clzll( x ) >> 3; }
+#elif defined( __GNUC__ )
+  inline int LZ_FIRST_DIFF( uint64_t x ) { return __builtin_ctzll( x ) >> 3; }
+#else
+  inline int LZ_FIRST_DIFF( uint64_t x ) { int i = 0; while ( !( x & 0xFF ) ) { x >>= 8; ++i; } return i; }
+#endif
+
 #define LZMIN 4
 
 //{{{{{{{{{{{{{{{{{ USER - TUNABLE ********************************************
 
 //Affect format
 #define LZBUFBITS 14
-//LZBUFBITS is a log2(LZBUFSIZE) and must be in range 10 - 16
+//LZBUFBITS is a log2(LZBUFSIZE) of the default window and must be in range 10 - 22
 
 //NOT affect format
 #define LZMATCH 5
 
 #define LZSLOWHASH
 #define LZTABLEBITS 15
-//LZTABLEBITS is a log2(LZTABLESIZE) and should be in range 9 - 17
+//LZTABLEBITS is a log2(LZTABLESIZE) of the default window and should be in range 9 - 20
 
 #define LZOVERLAP
 #define LZBACKWARDMATCH
@@ -40,12 +52,19 @@
 #define LZTABLESIZE (1<<(LZTABLEBITS))
 #define LZBUFSIZE (1<<(LZBUFBITS))
 
+//Window/table instantiations exported from LZHL.cpp: 16K, 256K and 4M windows
+#define LZHL_FOR_EACH_WINDOW( X ) \
+    X( 14, 15 )                   \
+    X( 18, 17 )                   \
+    X( 22, 20 )
+
 /**************************************************************************/
 #define LZPOS uint32_t
-#define LZBUFMASK ( (LZBUFSIZE) - 1 )
 
-#define LZTABLEINT uint16_t
-typedef LZTABLEINT LZTableItem;
+//Table entries hold window positions (all ones = empty), so 64K+ windows need 32 bit entries
+template< bool Wide > struct LZTableIntSel { typedef uint16_t Type; };
+template<> struct LZTableIntSel< true > { typedef uint32_t Type; };
+template< int BufBits > struct LZTableInt { typedef typename LZTableIntSel< ( BufBits >= 16 ) >::Type Type; };
 
 #define LZHASH uint32_t
 /**************************************************************************/
@@ -72,7 +91,7 @@ typedef LZTABLEINT LZTableItem;
     hash = ROTL( hash, LZHASHSHIFT );                   \
     }
 
-#define HASH_POS(hash) ((( (hash) * 214013 + 2531011) >> (32-LZTABLEBITS)) )
+#define HASH_POS(hash, bits) ((( (hash) * 214013 + 2531011) >> (32-(bits))) )
 
 #else
 
@@ -80,8 +99,7 @@ typedef LZTABLEINT LZTableItem;
 
 #define UPDATE_HASH( hash, c ) { hash = ( hash << LZHASHSHIFT ) ^ (c); }
 #define UPDATE_HASH_EX( hash, src )  { hash = ( hash << LZHASHSHIFT ) ^ (src)[ LZMATCH ]; }
-#define LZHASHMASK ((LZTABLESIZE)-1)
-#define HASH_POS( hash ) ( (hash) & LZHASHMASK )
+#define HASH_POS( hash, bits ) ( (hash) & ( ( 1 << (bits) ) - 1 ) )
 #endif
 
 #define HUFFRECALCSTAT( s ) ( (s) >> 1 )
@@ -1,41 +1,218 @@
-
 #include "LZHL.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
 
 #define MAXBUFSIZE 65536
+#define BENCHSLICE 65536
+#define BENCHSECONDS 0.5
 
 int compare(size_t inbufsize, unsigned char* inbuf, size_t outbufsize, unsigned char* outbuf)
 {
     size_t i;
-    
+
     if(inbufsize != outbufsize) {
         fprintf(stderr, "Buffer sizes differ after compression/decompression\n");
         return 1;
     }
-    
+
     for(i=0; i<inbufsize; i++) {
         if(inbuf[i] != outbuf[i]) {
             fprintf(stderr, "Byte at offset %lu did not match\n", i);
             return 1;
         }
     }
-    
+
     return 0;
 }
 
+/* Splits a capture into packets: Fixed32 length-prefixed frames (as written by
+   SerializeWithLengthPrefix) if the whole file parses that way, else fixed slices. */
+size_t split_packets(unsigned char* data, size_t size, size_t* offsets, size_t* sizes, size_t maxpackets)
+{
+    size_t count = 0, pos = 0;
+
+    while(pos + 4 <= size && count < maxpackets) {
+        size_t len = data[pos] | (data[pos + 1] << 8) | (data[pos + 2] << 16) | ((size_t)data[pos + 3] << 24);
+        if(len == 0 || len > size - pos - 4)
+            break;
+        offsets[count] = pos + 4;
+        sizes[count] = len;
+        count++;
+        pos += 4 + len;
+    }
+    if(pos == size && count > 0)
+        return count;
+
+    count = 0;
+    for(pos = 0; pos < size && count < maxpackets; pos += BENCHSLICE) {
+        offsets[count] = pos;
+        sizes[count] = size - pos < BENCHSLICE ? size - pos : BENCHSLICE;
+        count++;
+    }
+    return count;
+}
+
+/* Compresses and decompresses every packet of a capture, either independently
+   (reset per packet, as ReceiveEncrypted does for LZH) or as one stream. */
+int benchmark(const char* path, int windowBits, int streaming)
+{
+    FILE* f;
+    unsigned char *data, *comp, *out;
+    size_t size, npackets, i, total = 0, compTotal = 0, maxpackets;
+    size_t *offsets, *sizes, *compOffsets, *compSizes;
+    void *compressor, *decompressor;
+    clock_t start;
+    double compSeconds = 0, decompSeconds = 0;
+    int iterations = 0, errors = 0;
+
+    f = fopen(path, "rb");
+    if(!f) {
+        fprintf(stderr, "Can't open %s\n", path);
+        return 1;
+    }
+    fseek(f, 0, SEEK_END);
+    size = (size_t)ftell(f);
+    fseek(f, 0, SEEK_SET);
+    data = (unsigned char*)malloc(size + 1);
+    if(fread(data, 1, size, f) != size) {
+        fclose(f);
+        free(data);
+        fprintf(stderr, "Can't read %s\n", path);
+        return 1;
+    }
+    fclose(f);
+
+    maxpackets = size / 4 + 1;
+    offsets = (size_t*)malloc(sizeof(size_t) * maxpackets);
+    sizes = (size_t*)malloc(sizeof(size_t) * maxpackets);
+    npackets = split_packets(data, size, offsets, sizes, maxpackets);
+    compOffsets = (size_t*)malloc(sizeof(size_t) * npackets);
+    compSizes = (size_t*)malloc(sizeof(size_t) * npackets);
+    for(i=0; i<npackets; i++)
+        compTotal += CompressBound((unsigned int)sizes[i]) + 1;
+    comp = (unsigned char*)malloc(compTotal);
+    out = (unsigned char*)malloc(size + 1);
+
+    compressor = CreateCompressorWindow(windowBits);
+    decompressor = CreateDecompressorWindow(windowBits);
+
+    do {
+        compTotal = 0;
+        total = 0;
+        start = clock();
+        for(i=0; i<npackets; i++) {
+            compOffsets[i] = compTotal;
+            if(streaming)
+                compSizes[i] = CompressStream(compressor, data + offsets[i], (unsigned int)sizes[i], comp + compTotal, i == 0);
+            else {
+                ResetCompressor(compressor);
+                compSizes[i] = Compress(compressor, data + offsets[i], (unsigned int)sizes[i], comp + compTotal);
+            }
+            compTotal += compSizes[i];
+            total += sizes[i];
+        }
+        compSeconds += (double)(clock() - start) / CLOCKS_PER_SEC;
+
+        start = clock();
+        for(i=0; i<npackets; i++) {
+            if(streaming)
+                DecompressStream(decompressor, comp + compOffsets[i], (unsigned int)compSizes[i], out + offsets[i], (unsigned int)sizes[i]);
+            else {
+                ResetDecompressor(decompressor);
+                Decompress(decompressor, comp + compOffsets[i], (unsigned int)compSizes[i], out + offsets[i], (unsigned int)sizes[i]);
+            }
+        }
+        decompSeconds += (double)(clock() - start) / CLOCKS_PER_SEC;
+
+        if(iterations++ == 0) {
+            for(i=0; i<npackets; i++)
+                errors += compare(sizes[i], data + offsets[i], sizes[i], out + offsets[i]);
+        }
+    } while(compSeconds + decompSeconds < BENCHSECONDS);
+
+    fprintf(stderr, "%s: %lu packets, window %d, %s: %lu -> %lu bytes (%.1f%%), compress %.1f MB/s, decompress %.1f MB/s\n",
+        path, npackets, windowBits, streaming ? "stream" : "per-packet", total, compTotal, total ? 100.0 * compTotal / total : 0.0,
+        total * (double)iterations / (1024 * 1024) / (compSeconds > 0 ? compSeconds : 1e-9),
+        total * (double)iterations / (1024 * 1024) / (decompSeconds > 0 ? decompSeconds : 1e-9));
+
+    DestroyCompressor(compressor);
+    DestroyDecompressor(decompressor);
+    free(out);
+    free(comp);
+    free(compSizes);
+    free(compOffsets);
+    free(sizes);
+    free(offsets);
+    free(data);
+    return errors;
+}
+
+/* Batch compression on several workers must match packet-by-packet Compress exactly. */
+int batch_check(void)
+{
+    enum { BATCH = 16 };
+    static unsigned char inbuf[BATCH * 4096], batchbuf[BATCH * 8192], serialbuf[8192];
+    unsigned int offsets[BATCH + 1], retoffsets[BATCH], retsizes[BATCH], checksums[BATCH];
+    unsigned int i, j, fnv, serialsize;
+    void *pipeline, *compressor;
+    int errors = 0;
+
+    offsets[0] = 0;
+    for(i=0; i<BATCH; i++) {
+        offsets[i + 1] = offsets[i] + rand() % 4096;
+        retoffsets[i] = i * 8192;
+        for(j=offsets[i]; j<offsets[i + 1]; j++)
+            inbuf[j] = (j / 7) % 3 ? rand() % 0x10 : 'a' + i;
+    }
+
+    pipeline = CreateCompressPipeline(18, 4);
+    compressor = CreateCompressorWindow(18);
+    /* The workers persist between batches, so code the same batch a few times on one pipeline */
+    for(j=0; j<3; j++) {
+        if(!pipeline || CompressBatch(pipeline, BATCH, inbuf, offsets, batchbuf, retoffsets, retsizes, checksums) != 0) {
+            fprintf(stderr, "Batch compression failed\n");
+            return 1;
+        }
+    }
+    for(i=0; i<BATCH; i++) {
+        ResetCompressor(compressor);
+        serialsize = Compress(compressor, inbuf + offsets[i], offsets[i + 1] - offsets[i], serialbuf);
+        if(serialsize != retsizes[i] || memcmp(serialbuf, batchbuf + retoffsets[i], serialsize)) {
+            fprintf(stderr, "Batch packet %u differs from Compress\n", i);
+            errors++;
+        }
+        /* Utilities.ComputeChecksumFNVWeak: little-endian words while more than 4 bytes remain, then bytes */
+        fnv = 2166136261u;
+        for(j=offsets[i]; j + 4 < offsets[i + 1]; j += 4)
+            fnv = (fnv ^ (inbuf[j] | inbuf[j + 1] << 8 | inbuf[j + 2] << 16 | (unsigned int)inbuf[j + 3] << 24)) * 16777619u;
+        for(; j<offsets[i + 1]; j++)
+            fnv = (fnv ^ inbuf[j]) * 16777619u;
+        if(checksums[i] != fnv) {
+            fprintf(stderr, "Batch packet %u has a bad checksum\n", i);
+            errors++;
+        }
+    }
+    fprintf(stderr, "Batch compression: %u packets, %u bytes\n", BATCH, offsets[BATCH]);
+    DestroyCompressor(compressor);
+    DestroyCompressPipeline(pipeline);
+    return errors;
+}
+
 int main(int argc, char** argv)
 {
     void* compressor;
     void* decompressor;
     unsigned char inbuf[MAXBUFSIZE];
-    unsigned char compbuf[MAXBUFSIZE];
+    unsigned char compbuf[MAXBUFSIZE * 2];
     unsigned char outbuf[MAXBUFSIZE];
     size_t count, inbufsize, compbufsize, outbufsize, i;
-    int errors = 0;
+    int errors = 0, resync = 1, arg, window;
+    static const int windows[] = { 14, 18, 22 };
 
-    compressor = initComp();
-    decompressor = initDecomp();
+    compressor = CreateCompressor();
+    decompressor = CreateDecompressor();
 
     count = 10;
     while(count--) {
@@ -46,8 +223,9 @@ int main(int argc, char** argv)
         }
 
         /* Compress & Decompress */
-        compbufsize = compress(compressor, inbuf, inbufsize, compbuf);
-        outbufsize = decompress(decompressor, compbuf, compbufsize, outbuf, MAXBUFSIZE);
+        compbufsize = CompressStream(compressor, inbuf, inbufsize, compbuf, resync);
+        outbufsize = DecompressStream(decompressor, compbuf, compbufsize, outbuf, MAXBUFSIZE);
+        resync = 0;
         fprintf(stderr, "Uniform data: %lu bytes input to %lu bytes compressed to %lu bytes uncompressed\n", inbufsize, compbufsize, outbufsize);
         errors += compare(inbufsize, inbuf, outbufsize, outbuf);
     }
@@ -61,8 +239,8 @@ int main(int argc, char** argv)
         }
 
         /* Compress & Decompress */
-        compbufsize = compress(compressor, inbuf, inbufsize, compbuf);
-        outbufsize = decompress(decompressor, compbuf, compbufsize, outbuf, MAXBUFSIZE);
+        compbufsize = CompressStream(compressor, inbuf, inbufsize, compbuf, resync);
+        outbufsize = DecompressStream(decompressor, compbuf, compbufsize, outbuf, MAXBUFSIZE);
         fprintf(stderr, "Sequential data: %lu bytes input to %lu bytes compressed to %lu bytes uncompressed\n", inbufsize, compbufsize, outbufsize);
         errors += compare(inbufsize, inbuf, outbufsize, outbuf);
     }
@@ -76,8 +254,8 @@ int main(int argc, char** argv)
         }
 
         /* Compress & Decompress */
-        compbufsize = compress(compressor, inbuf, inbufsize, compbuf);
-        outbufsize = decompress(decompressor, compbuf, compbufsize, outbuf, MAXBUFSIZE);
+        compbufsize = CompressStream(compressor, inbuf, inbufsize, compbuf, resync);
+        outbufsize = DecompressStream(decompressor, compbuf, compbufsize, outbuf, MAXBUFSIZE);
         fprintf(stderr, "Random data: %lu bytes input to %lu bytes compressed to %lu bytes uncompressed\n", inbufsize, compbufsize, outbufsize);
         errors += compare(inbufsize, inbuf, outbufsize, outbuf);
     }
@@ -91,13 +269,53 @@ int main(int argc, char** argv)
         }
 
         /* Compress & Decompress */
-        compbufsize = compress(compressor, inbuf, inbufsize, compbuf);
-        outbufsize = decompress(decompressor, compbuf, compbufsize, outbuf, MAXBUFSIZE);
+        compbufsize = CompressStream(compressor, inbuf, inbufsize, compbuf, resync);
+        outbufsize = DecompressStream(decompressor, compbuf, compbufsize, outbuf, MAXBUFSIZE);
         fprintf(stderr, "Semi-random data: %lu bytes input to %lu bytes compressed to %lu bytes uncompressed\n", inbufsize, compbufsize, outbufsize);
         errors += compare(inbufsize, inbuf, outbufsize, outbuf);
     }
 
-    delComp(compressor);
-    delDecomp(decompressor);
-    return EXIT_SUCCESS;
+    count = 10;
+    while(count--) {
+        /* Decompress semi-random data into small output chunks */
+        unsigned int consumed, produced, srcpos = 0;
+        int result, first = 1;
+        inbufsize = rand() % MAXBUFSIZE;
+        for(i=0; i<inbufsize; i++) {
+            inbuf[i] = rand()%0x08;
+        }
+
+        compbufsize = CompressStream(compressor, inbuf, inbufsize, compbuf, resync);
+        outbufsize = 0;
+        do {
+            size_t chunk = 1 + rand() % 256;
+            if(chunk > MAXBUFSIZE - outbufsize)
+                chunk = MAXBUFSIZE - outbufsize;
+            result = DecompressStreamPartial(decompressor, compbuf + srcpos, (unsigned int)(compbufsize - srcpos), outbuf + outbufsize, (unsigned int)chunk, &consumed, &produced, first);
+            srcpos += consumed;
+            outbufsize += produced;
+            first = 0;
+        } while(result == 0 && outbufsize < MAXBUFSIZE);
+        fprintf(stderr, "Partial decompression: %lu bytes input to %lu bytes compressed to %lu bytes uncompressed\n", inbufsize, compbufsize, outbufsize);
+        if(result != 1 || srcpos != compbufsize) {
+            fprintf(stderr, "Partial decompression did not finish the packet\n");
+            errors++;
+        }
+        errors += compare(inbufsize, inbuf, outbufsize, outbuf);
+    }
+
+    DestroyCompressor(compressor);
+    DestroyDecompressor(decompressor);
+
+    errors += batch_check();
+
+    /* Throughput on packet captures given on the command line */
+    for(arg=1; arg<argc; arg++) {
+        for(window=0; window<3; window++) {
+            errors += benchmark(argv[arg], windows[window], 0);
+            errors += benchmark(argv[arg], windows[window], 1);
+        }
+    }
+
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
 }